@@ -0,0 +1,306 @@
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "calc_error.h"
+#include "system.h"
+#include "threadpool.h"
+#include "calculator.h"
+#include "statistics.h"
+#include "bivariate.h"
+
+using namespace std;
+
+typedef struct {
+    uint64_t        count;
+    double          meanX;
+    double          meanY;
+    double          m2X;
+    double          m2Y;
+    double          cXY;
+}
+moments_t;
+
+/*
+** Welford's update, extended to the cross term...
+*/
+static void _accumulate(moments_t * m, const double * xs, const double * ys, size_t n) {
+    m->count = 0;
+    m->meanX = m->meanY = m->m2X = m->m2Y = m->cXY = 0.0;
+
+    for (size_t i = 0;i < n;i++) {
+        m->count++;
+
+        double dx = xs[i] - m->meanX;
+        double dy = ys[i] - m->meanY;
+
+        m->meanX += dx / (double)m->count;
+        m->meanY += dy / (double)m->count;
+
+        m->m2X += dx * (xs[i] - m->meanX);
+        m->m2Y += dy * (ys[i] - m->meanY);
+        m->cXY += dx * (ys[i] - m->meanY);
+    }
+}
+
+/*
+** Combine the moments of two separate parts of the data (Chan et al.)...
+*/
+static void _merge(moments_t * a, moments_t * b) {
+    if (b->count == 0) {
+        return;
+    }
+
+    double n = (double)(a->count + b->count);
+    double dx = b->meanX - a->meanX;
+    double dy = b->meanY - a->meanY;
+    double f = (double)a->count * (double)b->count / n;
+
+    a->meanX += dx * (double)b->count / n;
+    a->meanY += dy * (double)b->count / n;
+    a->m2X += b->m2X + dx * dx * f;
+    a->m2Y += b->m2Y + dy * dy * f;
+    a->cXY += b->cXY + dx * dy * f;
+
+    a->count += b->count;
+}
+
+static void _accumulatePrecise(comoments_t * m, const __mpfr_struct * xs, const __mpfr_struct * ys, size_t n) {
+    mpfr_t      x;
+    mpfr_t      y;
+    mpfr_t      dx;
+    mpfr_t      dy;
+    mpfr_t      t;
+
+    mpfr_inits2(getBasePrecision(), x, y, dx, dy, t, (mpfr_ptr)0);
+
+    for (size_t i = 0;i < n;i++) {
+        m->count++;
+
+        mpfr_set(x, &xs[i], MPFR_RNDN);
+        mpfr_set(y, &ys[i], MPFR_RNDN);
+
+        mpfr_sub(dx, x, m->meanX, MPFR_RNDN);
+        mpfr_sub(dy, y, m->meanY, MPFR_RNDN);
+
+        mpfr_div_ui(t, dx, m->count, MPFR_RNDN);
+        mpfr_add(m->meanX, m->meanX, t, MPFR_RNDN);
+        mpfr_div_ui(t, dy, m->count, MPFR_RNDN);
+        mpfr_add(m->meanY, m->meanY, t, MPFR_RNDN);
+
+        mpfr_sub(x, x, m->meanX, MPFR_RNDN);
+        mpfr_sub(y, y, m->meanY, MPFR_RNDN);
+
+        mpfr_mul(t, dx, x, MPFR_RNDN);
+        mpfr_add(m->m2X, m->m2X, t, MPFR_RNDN);
+        mpfr_mul(t, dy, y, MPFR_RNDN);
+        mpfr_add(m->m2Y, m->m2Y, t, MPFR_RNDN);
+        mpfr_mul(t, dx, y, MPFR_RNDN);
+        mpfr_add(m->cXY, m->cXY, t, MPFR_RNDN);
+    }
+
+    mpfr_clears(x, y, dx, dy, t, (mpfr_ptr)0);
+}
+
+static void _mergePrecise(comoments_t * a, comoments_t * b) {
+    mpfr_t      dx;
+    mpfr_t      dy;
+    mpfr_t      t;
+    uint64_t    n = a->count + b->count;
+
+    if (b->count == 0) {
+        return;
+    }
+
+    mpfr_inits2(getBasePrecision(), dx, dy, t, (mpfr_ptr)0);
+
+    mpfr_sub(dx, b->meanX, a->meanX, MPFR_RNDN);
+    mpfr_sub(dy, b->meanY, a->meanY, MPFR_RNDN);
+
+    mpfr_mul_ui(t, dx, b->count, MPFR_RNDN);
+    mpfr_div_ui(t, t, n, MPFR_RNDN);
+    mpfr_add(a->meanX, a->meanX, t, MPFR_RNDN);
+
+    mpfr_mul_ui(t, dy, b->count, MPFR_RNDN);
+    mpfr_div_ui(t, t, n, MPFR_RNDN);
+    mpfr_add(a->meanY, a->meanY, t, MPFR_RNDN);
+
+    /*
+    ** Scale the differences by sqrt(na * nb / n) once, by multiplying
+    ** one of each product by na * nb / n...
+    */
+    mpfr_mul_ui(t, dx, a->count, MPFR_RNDN);
+    mpfr_mul_ui(t, t, b->count, MPFR_RNDN);
+    mpfr_div_ui(t, t, n, MPFR_RNDN);
+
+    mpfr_add(a->m2X, a->m2X, b->m2X, MPFR_RNDN);
+    mpfr_add(a->cXY, a->cXY, b->cXY, MPFR_RNDN);
+    mpfr_add(a->m2Y, a->m2Y, b->m2Y, MPFR_RNDN);
+
+    mpfr_fma(a->m2X, t, dx, a->m2X, MPFR_RNDN);
+    mpfr_fma(a->cXY, t, dy, a->cXY, MPFR_RNDN);
+
+    mpfr_mul_ui(t, dy, a->count, MPFR_RNDN);
+    mpfr_mul_ui(t, t, b->count, MPFR_RNDN);
+    mpfr_div_ui(t, t, n, MPFR_RNDN);
+    mpfr_fma(a->m2Y, t, dy, a->m2Y, MPFR_RNDN);
+
+    a->count = n;
+
+    mpfr_clears(dx, dy, t, (mpfr_ptr)0);
+}
+
+static void _clear(comoments_t * m) {
+    m->count = 0;
+
+    mpfr_set_zero(m->meanX, 1);
+    mpfr_set_zero(m->meanY, 1);
+    mpfr_set_zero(m->m2X, 1);
+    mpfr_set_zero(m->m2Y, 1);
+    mpfr_set_zero(m->cXY, 1);
+}
+
+void bivInit(comoments_t * m) {
+    mpfr_inits2(getBasePrecision(), m->meanX, m->meanY, m->m2X, m->m2Y, m->cXY, (mpfr_ptr)0);
+
+    _clear(m);
+}
+
+void bivFree(comoments_t * m) {
+    mpfr_clears(m->meanX, m->meanY, m->m2X, m->m2Y, m->cXY, (mpfr_ptr)0);
+}
+
+/*
+** The pairs are split into a chunk per thread, each chunk is reduced
+** with Welford's method and the partial results are combined pairwise
+** in a fixed order, so the answer does not depend on the timing.
+**
+** The double version is the fast path, the precise version carries
+** every step at the working precision, starting from the pairs as they
+** were entered rather than rounded to doubles...
+*/
+void bivCompute(comoments_t * m, stats_t * s, bool isPrecise) {
+    size_t          n = statPairCount(s);
+    size_t          numChunks;
+    const double *  xs = s->xs.data();
+    const double *  ys = s->ys.data();
+
+    if (n < 2) {
+        throw calc_error("At least 2 (x, y) pairs are needed");
+    }
+
+    numChunks = n / BIV_MIN_CHUNK_SIZE + 1;
+
+    if (numChunks > (size_t)ThreadPool::getDefaultSize()) {
+        numChunks = (size_t)ThreadPool::getDefaultSize();
+    }
+
+    if (isPrecise) {
+        vector<comoments_t> partial(numChunks);
+
+        for (comoments_t & p : partial) {
+            bivInit(&p);
+        }
+
+        try {
+            runParallel(numChunks, [&](size_t c) {
+                size_t start = (n * c) / numChunks;
+                size_t end = (n * (c + 1)) / numChunks;
+
+                _accumulatePrecise(
+                            &partial[c],
+                            s->preciseXs.data() + start,
+                            s->preciseYs.data() + start,
+                            end - start);
+            });
+        }
+        catch (...) {
+            for (comoments_t & p : partial) {
+                bivFree(&p);
+            }
+
+            throw;
+        }
+
+        for (size_t step = 1;step < numChunks;step <<= 1) {
+            for (size_t c = 0;c + step < numChunks;c += step << 1) {
+                _mergePrecise(&partial[c], &partial[c + step]);
+            }
+        }
+
+        m->count = partial[0].count;
+
+        mpfr_set(m->meanX, partial[0].meanX, MPFR_RNDN);
+        mpfr_set(m->meanY, partial[0].meanY, MPFR_RNDN);
+        mpfr_set(m->m2X, partial[0].m2X, MPFR_RNDN);
+        mpfr_set(m->m2Y, partial[0].m2Y, MPFR_RNDN);
+        mpfr_set(m->cXY, partial[0].cXY, MPFR_RNDN);
+
+        for (comoments_t & p : partial) {
+            bivFree(&p);
+        }
+    }
+    else {
+        vector<moments_t> partial(numChunks);
+
+        runParallel(numChunks, [&](size_t c) {
+            size_t start = (n * c) / numChunks;
+            size_t end = (n * (c + 1)) / numChunks;
+
+            _accumulate(&partial[c], xs + start, ys + start, end - start);
+        });
+
+        for (size_t step = 1;step < numChunks;step <<= 1) {
+            for (size_t c = 0;c + step < numChunks;c += step << 1) {
+                _merge(&partial[c], &partial[c + step]);
+            }
+        }
+
+        m->count = partial[0].count;
+
+        mpfr_set_d(m->meanX, partial[0].meanX, MPFR_RNDN);
+        mpfr_set_d(m->meanY, partial[0].meanY, MPFR_RNDN);
+        mpfr_set_d(m->m2X, partial[0].m2X, MPFR_RNDN);
+        mpfr_set_d(m->m2Y, partial[0].m2Y, MPFR_RNDN);
+        mpfr_set_d(m->cXY, partial[0].cXY, MPFR_RNDN);
+    }
+}
+
+/*
+** The sample covariance, i.e. divided by n - 1...
+*/
+void bivCovariance(mpfr_t result, comoments_t * m) {
+    mpfr_div_ui(result, m->cXY, m->count - 1, MPFR_RNDN);
+}
+
+/*
+** Pearson's correlation coefficient...
+*/
+void bivCorrelation(mpfr_t result, comoments_t * m) {
+    if (mpfr_zero_p(m->m2X) || mpfr_zero_p(m->m2Y)) {
+        throw calc_error("The correlation is undefined when x or y is constant");
+    }
+
+    mpfr_mul(result, m->m2X, m->m2Y, MPFR_RNDN);
+    mpfr_rec_sqrt(result, result, MPFR_RNDN);
+    mpfr_mul(result, result, m->cXY, MPFR_RNDN);
+}
+
+/*
+** The least squares line y = intercept + slope * x...
+*/
+void bivRegression(mpfr_t slope, mpfr_t intercept, comoments_t * m) {
+    if (mpfr_zero_p(m->m2X)) {
+        throw calc_error("The regression is undefined when x is constant");
+    }
+
+    mpfr_div(slope, m->cXY, m->m2X, MPFR_RNDN);
+
+    mpfr_mul(intercept, slope, m->meanX, MPFR_RNDN);
+    mpfr_sub(intercept, m->meanY, intercept, MPFR_RNDN);
+}
@@ -0,0 +1,38 @@
+#include <stdint.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "statistics.h"
+
+#ifndef __INCL_BIVARIATE
+#define __INCL_BIVARIATE
+
+/*
+** Below this many pairs per thread it is not worth starting a thread...
+*/
+#define BIV_MIN_CHUNK_SIZE                  65536
+
+/*
+** The means, and the sums of squared and cross differences from the
+** means, of a set of (x, y) pairs. Everything else is derived from these...
+*/
+typedef struct {
+    uint64_t        count;
+
+    mpfr_t          meanX;
+    mpfr_t          meanY;
+    mpfr_t          m2X;
+    mpfr_t          m2Y;
+    mpfr_t          cXY;
+}
+comoments_t;
+
+void        bivInit(comoments_t * m);
+void        bivFree(comoments_t * m);
+void        bivCompute(comoments_t * m, stats_t * s, bool isPrecise);
+void        bivCovariance(mpfr_t result, comoments_t * m);
+void        bivCorrelation(mpfr_t result, comoments_t * m);
+void        bivRegression(mpfr_t slope, mpfr_t intercept, comoments_t * m);
+
+#endif
@@ -94,4 +94,19 @@ class invalid_token_error : public calc_error {
         invalid_token_error(const char * msg, const char * file, int line) : calc_error(msg, file, line) {}
 };
 
+/*
+** A calculation that cannot be differentiated, e.g. one using the bitwise
+** operators, the caller can fall back to differences...
+*/
+class derivative_error : public calc_error {
+    public:
+        const char * getTitle() {
+            return "Derivative error: ";
+        }
+
+        derivative_error() : calc_error() {}
+        derivative_error(const char * msg) : calc_error(msg) {}
+        derivative_error(const char * msg, const char * file, int line) : calc_error(msg, file, line) {}
+};
+
 #endif
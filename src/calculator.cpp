@@ -1,9 +1,14 @@
 #include <string>
 #include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <ctype.h>
+#include <math.h>
 
 #include <gmp.h>
 #include <mpfr.h>
@@ -19,7 +24,9 @@
 #include "timeutils.h"
 #include "version.h"
 #include "test.h"
+#include "threadpool.h"
 #include "calculator.h"
+#include "summation.h"
 
 using namespace std;
 
@@ -28,7 +35,7 @@ using namespace std;
 
 static vector<string>               stats;
 
-static int getPrescedence(string & token) {
+static int getPrescedence(const string & token) {
     if (Utils::isOperator(token[0])) {
         return Operator::getPrescedence(token);
     }
@@ -39,7 +46,7 @@ static int getPrescedence(string & token) {
     return 0;
 }
 
-static associativity getAssociativity(string & token) {
+static associativity getAssociativity(const string & token) {
     if (Utils::isOperator(token[0])) {
         return Operator::getAssociativity(token);
     }
@@ -59,13 +66,25 @@ static void _convertToRPN(tokenizer_t * tokenizer, Queue & tokenQueue) {
         /*
         ** If the token is a number, then push it to the output queue.
         */
-        if (Utils::isOperand(token)) {
+        if (Utils::isOperand(token, tokenizer->base)) {
             tokenQueue.put(token);
         }
         else if (Utils::isConstant(token)) {
             tokenQueue.put(token);
         }
         /*
+        ** Variables are looked up when the program is run...
+        */
+        else if (Utils::isVariable(token)) {
+            tokenQueue.put(token);
+        }
+        /*
+        ** As are sums and products, which were taken out by compile()...
+        */
+        else if (token[0] == SUM_TOKEN_PREFIX) {
+            tokenQueue.put(token);
+        }
+        /*
         ** If the token is a function token, then push it onto the stack.
         */
         else if (Utils::isFunction(token)) {
@@ -105,6 +124,20 @@ static void _convertToRPN(tokenizer_t * tokenizer, Queue & tokenQueue) {
 
             operatorStack.push(token);
         }
+        /*
+        ** If the token is an argument separator, pop operators off the
+        ** stack onto the output queue until the left parenthesis of
+        ** the function call is at the top...
+        */
+        else if (Utils::isSeparator(token[0])) {
+            while (!operatorStack.isEmpty() && !Utils::isLeftBrace(operatorStack.peek()[0])) {
+                tokenQueue.put(operatorStack.pop());
+            }
+
+            if (operatorStack.isEmpty()) {
+                throw invalid_token_error("_convertToRPN(): Argument separator outside a function call", __FILE__, __LINE__);
+            }
+        }
         else if (Utils::isBrace(token[0])) {
             /*
             ** If the token is a left parenthesis (i.e. "("), then push it onto the stack.
@@ -180,48 +213,493 @@ static void _convertToRPN(tokenizer_t * tokenizer, Queue & tokenQueue) {
     }
 }
 
-void evaluate(mpfr_t result, const char * pszExpression, int radix) {
+/*
+** Functions, powers and roots are the only tokens worth a thread of
+** their own, and then only at a high enough precision...
+*/
+static bool _isTask(const string & token) {
+    double  p = (double)getBasePrecision();
+
+    if (Utils::isFunction(token)) {
+        if (Word::isFunction(token)) {
+            return false;
+        }
+    }
+    else if (token.compare("^") != 0 && token.compare(":") != 0) {
+        return false;
+    }
+
+    return (EXEC_FUNCTION_COST_RATIO * p * log2(p) >= EXEC_TASK_MIN_COST);
+}
+
+/*
+** Find the expensive subtrees and what each of them waits on. A token's
+** subtree is the run of tokens from its first operand to itself, so the
+** stack holds the first token of each subtree along with the tasks in it
+** that nothing above has claimed yet...
+*/
+static void _plan(program_t * program) {
+    typedef struct {
+        int             first;
+        vector<int>     tasks;
+    }
+    subtree_t;
+
+    vector<subtree_t>   stack;
+    bool                isParallel = false;
+
+    program->tasks.clear();
+
+    for (int i = 0;i < (int)program->tokens.size();i++) {
+        const string &  t = program->tokens[i];
+        int             arity = 0;
+
+        if (program->values[i] || Utils::isConstant(t) || !(Utils::isFunction(t) || Utils::isOperator(t[0]))) {
+            stack.push_back({ i, vector<int>() });
+            continue;
+        }
+
+        arity = (Utils::isFunction(t) ? Function::getArity(t) : 2);
+
+        if ((int)stack.size() < arity) {
+            program->tasks.clear();
+            return;
+        }
+
+        subtree_t subtree = { stack[stack.size() - arity].first, vector<int>() };
+
+        for (size_t j = stack.size() - arity;j < stack.size();j++) {
+            subtree.tasks.insert(subtree.tasks.end(), stack[j].tasks.begin(), stack[j].tasks.end());
+        }
+
+        stack.resize(stack.size() - arity);
+
+        if (_isTask(t)) {
+            task_t task = { subtree.first, i, -1, subtree.tasks };
+
+            for (int child : task.children) {
+                program->tasks[child].parent = (int)program->tasks.size();
+            }
+
+            isParallel = isParallel || task.children.size() > 1;
+
+            subtree.tasks.assign(1, (int)program->tasks.size());
+            program->tasks.push_back(task);
+        }
+
+        stack.push_back(subtree);
+    }
+
+    if (stack.size() != 1) {
+        program->tasks.clear();
+        return;
+    }
+
+    /*
+    ** The whole program is the last task...
+    */
+    for (int child : stack[0].tasks) {
+        program->tasks[child].parent = (int)program->tasks.size();
+    }
+
+    isParallel = isParallel || stack[0].tasks.size() > 1;
+
+    program->tasks.push_back({ 0, (int)program->tokens.size() - 1, -1, stack[0].tasks });
+
+    if (!isParallel) {
+        program->tasks.clear();
+    }
+}
+
+/*
+** Choose the kernel for each operator. The stack holds, for each operand,
+** the token it is if it is a single token, or -1 if it was worked out...
+*/
+static void _chooseKernels(program_t * program) {
+    vector<int>     stack;
+    kernel_t        generic = { KERNEL_GENERIC, 0, false };
+
+    program->kernels.assign(program->tokens.size(), generic);
+
+    for (int i = 0;i < (int)program->tokens.size();i++) {
+        const string &  t = program->tokens[i];
+        int             arity;
+
+        if (program->values[i] || Utils::isConstant(t) || !(Utils::isFunction(t) || Utils::isOperator(t[0]))) {
+            stack.push_back(i);
+            continue;
+        }
+
+        arity = (Utils::isFunction(t) ? Function::getArity(t) : 2);
+
+        if ((int)stack.size() < arity) {
+            return;
+        }
+
+        if (!Utils::isFunction(t)) {
+            int     o1 = stack[stack.size() - 2];
+            int     o2 = stack[stack.size() - 1];
+            bool    isSame = (o1 >= 0 && o2 >= 0 && program->tokens[o1] == program->tokens[o2]);
+
+            program->kernels[i] = Operator::getKernel(
+                                        t,
+                                        (o1 >= 0 ? program->values[o1] : value_t()),
+                                        (o2 >= 0 ? program->values[o2] : value_t()),
+                                        isSame);
+        }
+
+        stack.resize(stack.size() - arity);
+        stack.push_back(-1);
+    }
+}
+
+/*
+** Find where the subtree ending at each token starts...
+*/
+static void _findStarts(program_t * program) {
+    vector<int>     stack;
+
+    program->starts.assign(program->tokens.size(), 0);
+
+    for (int i = 0;i < (int)program->tokens.size();i++) {
+        const string &  t = program->tokens[i];
+        int             arity;
+
+        program->starts[i] = i;
+
+        if (program->values[i] || Utils::isConstant(t) || !(Utils::isFunction(t) || Utils::isOperator(t[0]))) {
+            stack.push_back(i);
+            continue;
+        }
+
+        arity = (Utils::isFunction(t) ? Function::getArity(t) : 2);
+
+        if ((int)stack.size() < arity) {
+            return;
+        }
+
+        program->starts[i] = stack[stack.size() - arity];
+
+        stack.resize(stack.size() - arity);
+        stack.push_back(program->starts[i]);
+    }
+}
+
+/*
+** Take the sums and products out of a calculation, compiling their
+** limits and terms as programs of their own, and put a token in the
+** place of each. A sum in the terms of another is taken out when they
+** are compiled...
+*/
+static string _extractSums(program_t * program, const char * pszExpression, int radix) {
+    string          expression;
+    const char *    p = pszExpression;
+
+    program->sums.clear();
+
+    while (*p) {
+        const char *        pszName = NULL;
+        const char *        pszEnd;
+        vector<string>      args;
+
+        if (*p == SUM_TOKEN_PREFIX) {
+            throw invalid_token_error(
+                        calc_error::buildMsg(
+                                    "_extractSums(): Invalid character: %c",
+                                    *p),
+                        __FILE__,
+                        __LINE__);
+        }
+
+        if (p == pszExpression || !(isalnum(p[-1]) || p[-1] == '_')) {
+            if (strncmp(p, "sum", 3) == 0) {
+                pszName = "sum";
+            }
+            else if (strncmp(p, "prod", 4) == 0) {
+                pszName = "prod";
+            }
+        }
+
+        if (pszName == NULL || !Utils::splitCall(p, pszName, args, &pszEnd)) {
+            expression.append(1, *p++);
+            continue;
+        }
+
+        if (args.size() != 4 || !Utils::isVariable(args[0])) {
+            throw calc_error("Usage: sum(index, from, to, expression) or prod(index, from, to, expression), to can be inf");
+        }
+
+        summation_t sum;
+
+        sum.index = args[0];
+        sum.isProduct = (pszName[0] == 'p');
+
+        sum.from = make_shared<program_t>();
+        compile(sum.from.get(), args[1].c_str(), radix);
+
+        if (Utils::lowercase(args[2]).compare("inf") != 0) {
+            sum.to = make_shared<program_t>();
+            compile(sum.to.get(), args[2].c_str(), radix);
+        }
+
+        sum.body = make_shared<program_t>();
+        compile(sum.body.get(), args[3].c_str(), radix);
+
+        expression.append(1, SUM_TOKEN_PREFIX);
+        expression.append(to_string(program->sums.size()));
+
+        program->sums.push_back(sum);
+
+        p = pszEnd;
+    }
+
+    return expression;
+}
+
+void compile(program_t * program, const char * pszExpression, int radix) {
     tokenizer_t             tokenizer;
     Queue                   tokenQueue;
+    string                  expression = _extractSums(program, pszExpression, radix);
 
-    tzrInit(&tokenizer, pszExpression, radix);
+    tzrInit(&tokenizer, expression.c_str(), radix);
 
     /*
     ** Convert the calculation in infix notation to the postfix notation
     ** (Reverse Polish Notation) using the 'shunting yard algorithm'...
     */
-    _convertToRPN(&tokenizer, tokenQueue);
+    try {
+        _convertToRPN(&tokenizer, tokenQueue);
+    }
+    catch (calc_error & e) {
+        tzrFinish(&tokenizer);
+        throw;
+    }
+
+    tzrFinish(&tokenizer);
 
     lgLogDebug("num items in queue = %d", tokenQueue.size());
 
-    Stack tokenStack;
+    program->radix = radix;
+    program->tokens.clear();
+    program->tokens.reserve(tokenQueue.size());
+    program->values.clear();
+    program->values.reserve(tokenQueue.size());
 
     while (!tokenQueue.isEmpty()) {
-        string t = tokenQueue.get();
+        string token = tokenQueue.get();
+
+        if (Utils::isOperand(token, radix)) {
+            program->values.push_back(parseValue(token.c_str(), radix));
+        }
+        else {
+            program->values.push_back(value_t());
+        }
+
+        program->tokens.push_back(token);
+    }
+
+    _chooseKernels(program);
+    _findStarts(program);
+    _plan(program);
+}
+
+/*
+** The subtotals of a program being run again, and for each token the
+** last token of the biggest subtree starting there whose subtotal can
+** be used as it is (-1 if none)...
+*/
+typedef struct {
+    subtotals_t *           subtotals;
+    vector<int>             ends;
+}
+keep_t;
+
+static long _runLimit(const program_t * program, const bindings_t * bindings) {
+    value_t n = toInteger(execute(program, bindings));
+
+    if (!mpz_fits_slong_p(n->z)) {
+        throw calc_error("The limits of a sum or product must be whole numbers of up to 64 bits");
+    }
+
+    return mpz_get_si(n->z);
+}
+
+/*
+** A sum or product in a calculation, with the same variables as the
+** calculation. The estimated error of an infinite one is only shown
+** when it is the whole of the calculation...
+*/
+static value_t _runSum(const program_t * program, const string & token, const bindings_t * bindings) {
+    const summation_t & sum = program->sums[strtoul(&token[1], NULL, 10)];
+    long                lo = _runLimit(sum.from.get(), bindings);
+
+    if (sum.to) {
+        return sumFinite(sum.body.get(), sum.index, lo, _runLimit(sum.to.get(), bindings), sum.isProduct, bindings);
+    }
+
+    if (isIntegerMode(program->radix)) {
+        throw calc_error("Infinite series need a mode with fractions, e.g. dec");
+    }
+
+    value_t     result = newValue();
+    mpfr_t      error;
+
+    mpfr_init2(error, getBasePrecision());
+
+    try {
+        sumInfinite(result->v, error, sum.body.get(), sum.index, lo, sum.isProduct, bindings);
+    }
+    catch (calc_error & e) {
+        mpfr_clear(error);
+        throw;
+    }
 
-        if (Utils::isOperand(t)) {
+    mpfr_clear(error);
+
+    return result;
+}
+
+/*
+** Run the tokens first to last, taking the results of the tasks it
+** waits on, if any, rather than working them out again...
+*/
+static value_t _run(
+            const program_t * program,
+            const bindings_t * bindings,
+            const task_t * task,
+            const vector<value_t> * results,
+            keep_t * keep)
+{
+    vector<value_t>     valueStack;
+    int                 radix = program->radix;
+    int                 first = (task != NULL ? task->first : 0);
+    int                 last = (task != NULL ? task->last : (int)program->tokens.size() - 1);
+    size_t              nextChild = 0;
+
+    valueStack.reserve(STACK_SIZE);
+
+    for (int i = first;i <= last;i++) {
+        const string & t = program->tokens[i];
+
+        if (keep != NULL && keep->ends[i] >= 0 && keep->ends[i] <= last) {
+            valueStack.push_back(keep->subtotals->values[keep->ends[i]]);
+
+            i = keep->ends[i];
+
+            while (task != NULL && nextChild < task->children.size() && program->tasks[task->children[nextChild]].first <= i) {
+                nextChild++;
+            }
+
+            continue;
+        }
+
+        if (task != NULL && nextChild < task->children.size()) {
+            const task_t & child = program->tasks[task->children[nextChild]];
+
+            if (i == child.first) {
+                valueStack.push_back((*results)[task->children[nextChild]]);
+
+                i = child.last;
+                nextChild++;
+                continue;
+            }
+        }
+
+        if (program->values[i]) {
             lgLogDebug("Got operand: '%s'", t.c_str());
-            tokenStack.push(t);
+
+            valueStack.push_back(program->values[i]);
+        }
+        /*
+        ** Operators are by far the most common, so are looked for before
+        ** the names of constants and functions...
+        */
+        else if (Utils::isOperator(t[0])) {
+            lgLogDebug("Got operator: '%s'", t.c_str());
+
+            if (valueStack.size() < 2) {
+                throw stack_error("Missing operand for operator", __FILE__, __LINE__);
+            }
+
+            value_t o2 = valueStack.back();
+            valueStack.pop_back();
+
+            value_t o1 = valueStack.back();
+
+            valueStack.back() = Operator::evaluate(t, radix, o1, o2, program->kernels[i]);
+
+            if (keep != NULL) {
+                keep->subtotals->values[i] = valueStack.back();
+            }
         }
         else if (Utils::isConstant(t)) {
             lgLogDebug("Got constant: '%s'", t.c_str());
 
-            tokenStack.push(Constant::evaluate(t));
+            valueStack.push_back(Constant::evaluate(t));
         }
         else if (Utils::isFunction(t)) {
             lgLogDebug("Got function: '%s'", t.c_str());
 
-            string o1 = tokenStack.pop();
+            int arity = Function::getArity(t);
+
+            if (valueStack.size() < (size_t)arity) {
+                throw stack_error("Missing operand for function", __FILE__, __LINE__);
+            }
 
-            tokenStack.push(Function::evaluate(t, radix, o1));
+            if (arity == 2) {
+                value_t o2 = valueStack.back();
+                valueStack.pop_back();
+
+                value_t o1 = valueStack.back();
+
+                valueStack.back() = Function::evaluate(t, radix, o1, o2);
+            }
+            else {
+                value_t o1 = valueStack.back();
+
+                valueStack.back() = Function::evaluate(t, radix, o1);
+            }
+
+            if (keep != NULL) {
+                keep->subtotals->values[i] = valueStack.back();
+            }
         }
-        else if (Utils::isOperator(t[0])) {
-            lgLogDebug("Got operator: '%s'", t.c_str());
+        else if (Utils::isVariable(t)) {
+            lgLogDebug("Got variable: '%s'", t.c_str());
+
+            value_t v;
 
-            string o2 = tokenStack.pop();
-            string o1 = tokenStack.pop();
+            if (bindings != NULL) {
+                auto binding = bindings->find(t);
 
-            tokenStack.push(Operator::evaluate(t, radix, o1, o2));
+                if (binding != bindings->end()) {
+                    v = binding->second;
+                }
+            }
+
+            if (!v) {
+                v = memFind(t);
+            }
+
+            if (!v) {
+                throw invalid_token_error(
+                            calc_error::buildMsg(
+                                        "execute(): Unknown variable: %s", 
+                                        t.c_str()), 
+                            __FILE__, 
+                            __LINE__);
+            }
+
+            valueStack.push_back(v);
+        }
+        else if (t[0] == SUM_TOKEN_PREFIX) {
+            lgLogDebug("Got sum: '%s'", t.c_str());
+
+            valueStack.push_back(_runSum(program, t, bindings));
+
+            if (keep != NULL) {
+                keep->subtotals->values[i] = valueStack.back();
+            }
         }
     }
 
@@ -230,24 +708,280 @@ void evaluate(mpfr_t result, const char * pszExpression, int radix) {
     ** it is the result of the calculation. Otherwise, we
     ** have too many tokens and therefore an error...
     */
-    if (tokenStack.size() == 1) {
-        string answer = tokenStack.pop();
+    if (valueStack.size() != 1) {
+        lgLogError("evaluate(): Got %d invalid items on stack!", (int)valueStack.size());
+
+        throw stack_error("Invalid items on stack", __FILE__, __LINE__);
+    }
 
-        lgLogDebug("Answer = %s", answer.c_str());
+    return valueStack.back();
+}
+
+/*
+** The tasks of a program being run in parallel...
+*/
+typedef struct {
+    mutex                   lock;
+    condition_variable      isFinished;
+
+    vector<value_t>         results;
+    vector<size_t>          numPending;
+    int                     numRunning;
+    exception_ptr           error;
+}
+run_t;
+
+/*
+** Tasks never wait for each other, a task is only queued once all those
+** it needs have finished, so a pool shared by every calculation cannot
+** deadlock. A program run on one of the workers, by runParallel(), is
+** run in turn rather than waiting on the others...
+*/
+static ThreadPool & _getPool(void) {
+    return ThreadPool::getShared();
+}
+
+static bool _canRunParallel(const program_t * program) {
+    return (!program->tasks.empty() && _getPool().size() > 1 && !_getPool().isWorker());
+}
+
+/*
+** Queue a task, the run's lock must be held...
+*/
+static void _submit(
+            const program_t * program,
+            const bindings_t * bindings,
+            keep_t * keep,
+            run_t * run,
+            system_state_t * state,
+            int taskIndex)
+{
+    run->numRunning++;
+
+    _getPool().submit([=] {
+        const task_t &  task = program->tasks[taskIndex];
+        value_t         result;
+        exception_ptr   error;
+
+        sysSetState(state);
+
+        try {
+            result = _run(program, bindings, &task, &run->results, keep);
+        }
+        catch (...) {
+            error = current_exception();
+        }
 
-        mpfr_set_str(result, answer.c_str(), radix, MPFR_RNDA);
+        sysSetState(NULL);
+
+        lock_guard<mutex> lock(run->lock);
+
+        run->numRunning--;
+
+        if (error) {
+            if (!run->error) {
+                run->error = error;
+            }
+        }
+        else {
+            run->results[taskIndex] = result;
+
+            if (--run->numPending[task.parent] == 0 && !run->error && task.parent != (int)program->tasks.size() - 1) {
+                _submit(program, bindings, keep, run, state, task.parent);
+            }
+        }
+
+        run->isFinished.notify_all();
+    });
+}
+
+/*
+** Start the tasks that wait on nothing, the rest are started as the
+** tasks they need finish. The calling thread runs the whole program
+** once everything it needs is ready...
+*/
+static value_t _executeParallel(const program_t * program, const bindings_t * bindings, keep_t * keep) {
+    run_t               run;
+    int                 root = (int)program->tasks.size() - 1;
+
+    run.results.resize(program->tasks.size());
+    run.numRunning = 0;
+
+    for (const task_t & task : program->tasks) {
+        run.numPending.push_back(task.children.size());
     }
-    else {
-        lgLogError("evaluate(): Got invalid items on stack!");
 
-        while (!tokenStack.isEmpty()) {
-            string tok = tokenStack.pop();
-            lgLogError("Invalid item on stack '%s'\n", tok.c_str());
+    {
+        unique_lock<mutex> lock(run.lock);
+
+        for (int i = 0;i < root;i++) {
+            if (program->tasks[i].children.empty()) {
+                _submit(program, bindings, keep, &run, sysGetState(), i);
+            }
         }
 
-        tzrFinish(&tokenizer);
-        throw stack_error("Invalid items on stack", __FILE__, __LINE__);
+        run.isFinished.wait(lock, [&] {
+            return (run.numRunning == 0 && (run.error || run.numPending[root] == 0));
+        });
     }
 
-    tzrFinish(&tokenizer);
+    if (run.error) {
+        rethrow_exception(run.error);
+    }
+
+    return _run(program, bindings, &program->tasks[root], &run.results, keep);
+}
+
+value_t execute(const program_t * program, const bindings_t * bindings) {
+    if (_canRunParallel(program)) {
+        return _executeParallel(program, bindings, NULL);
+    }
+
+    return _run(program, bindings, NULL, NULL, NULL);
+}
+
+/*
+** Run a program as a function of one of its variables, for the commands
+** that run the same calculation at many points...
+*/
+void executeAt(mpfr_t result, const program_t * program, const string & variable, mpfr_t x) {
+    bindings_t      bindings;
+    value_t         v = newValue();
+
+    mpfr_set(v->v, x, MPFR_RNDN);
+    bindings[variable] = v;
+
+    mpfr_set(result, toReal(execute(program, &bindings))->v, MPFR_RNDN);
+}
+
+/*
+** Run job(i) for i from 0 to n - 1 on the shared pool, with each thread
+** attached to the caller's state, for the commands that run the same
+** calculation at many points or split their data into chunks. The first
+** exception thrown by a job is thrown again here...
+*/
+void runParallel(size_t n, const function<void(size_t)> & job) {
+    system_state_t * state = sysGetState();
+
+    _getPool().runEach(n, [&job, state](size_t i) {
+        system_state_t * previous = sysGetState();
+
+        sysSetState(state);
+
+        try {
+            job(i);
+        }
+        catch (...) {
+            sysSetState(previous);
+            throw;
+        }
+
+        sysSetState(previous);
+    });
+}
+
+static bool _isPreciseEnough(const value_t & value) {
+    return (value && (value->type != VALUE_REAL || mpfr_get_prec(value->v) >= getBasePrecision()));
+}
+
+/*
+** Read the numbers in a program again if they were read to fewer bits
+** than are needed now, and those in its sums and products...
+*/
+static void _reread(program_t * program) {
+    for (size_t i = 0;i < program->tokens.size();i++) {
+        if (program->values[i] && !_isPreciseEnough(program->values[i])) {
+            program->values[i] = parseValue(program->tokens[i].c_str(), program->radix);
+        }
+    }
+
+    for (summation_t & sum : program->sums) {
+        _reread(sum.from.get());
+
+        if (sum.to) {
+            _reread(sum.to.get());
+        }
+
+        _reread(sum.body.get());
+    }
+
+    _plan(program);
+}
+
+/*
+** Whether the subtree ending at each token has a constant, or a sum or
+** product, which may have one, in it...
+*/
+static void _findConstants(const program_t * program, vector<bool> & hasConstant) {
+    vector<int>     numBefore(program->tokens.size() + 1, 0);
+
+    for (size_t i = 0;i < program->tokens.size();i++) {
+        const string & t = program->tokens[i];
+        bool isConstant = (!program->values[i] && (Utils::isConstant(t) || t[0] == SUM_TOKEN_PREFIX));
+
+        numBefore[i + 1] = numBefore[i] + (isConstant ? 1 : 0);
+    }
+
+    hasConstant.resize(program->tokens.size());
+
+    for (size_t i = 0;i < program->tokens.size();i++) {
+        hasConstant[i] = (numBefore[i + 1] > numBefore[program->starts[i]]);
+    }
+}
+
+/*
+** Run a program again, perhaps at a higher precision, or for the first
+** time if there are no subtotals yet. The numbers written in it are read
+** again if they were read to fewer bits than are needed now, and the
+** tasks are planned again for the new precision...
+*/
+value_t refine(program_t * program, subtotals_t * subtotals) {
+    keep_t          keep;
+    vector<bool>    hasConstant;
+    bool            isParallel;
+    bool            isMoreDigits = (getPrecision() > subtotals->precision);
+    int             n = (int)program->tokens.size();
+
+    _reread(program);
+    _findConstants(program, hasConstant);
+
+    subtotals->values.resize(n);
+    subtotals->precision = getPrecision();
+
+    keep.subtotals = subtotals;
+    keep.ends.assign(n, -1);
+
+    for (int i = 0;i < n;i++) {
+        if (_isPreciseEnough(subtotals->values[i]) && !(isMoreDigits && hasConstant[i])) {
+            keep.ends[program->starts[i]] = max(keep.ends[program->starts[i]], i);
+        }
+        else {
+            subtotals->values[i].reset();
+        }
+    }
+
+    /*
+    ** Only worth running in parallel if no task can be skipped...
+    */
+    isParallel = _canRunParallel(program);
+
+    for (const task_t & task : program->tasks) {
+        if (keep.ends[task.first] >= task.last) {
+            isParallel = false;
+        }
+    }
+
+    if (isParallel) {
+        return _executeParallel(program, NULL, &keep);
+    }
+
+    return _run(program, NULL, NULL, NULL, &keep);
+}
+
+value_t evaluate(const char * pszExpression, int radix) {
+    program_t               program;
+
+    compile(&program, pszExpression, radix);
+
+    return execute(&program);
 }
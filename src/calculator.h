@@ -1,9 +1,17 @@
 #include <string>
 #include <cstring>
+#include <vector>
+#include <unordered_map>
 #include <queue>
 #include <stack>
+#include <functional>
+
+#include <gmp.h>
+#include <mpfr.h>
 
 #include "tokenizer.h"
+#include "system.h"
+#include "operator.h"
 
 #ifndef __INCL_CALCULATOR
 #define __INCL_CALCULATOR
@@ -20,6 +28,125 @@
 
 #define DEFAULT_LOG_LEVEL                       (LOG_LEVEL_FATAL | LOG_LEVEL_ERROR)
 
-void        evaluate(mpfr_t result, const char * pszExpression, int radix);
+/*
+** Roughly what a function, power or root costs next to a multiplication...
+*/
+#define EXEC_FUNCTION_COST_RATIO                32.0
+
+/*
+** A function, power or root is only given its own thread if it costs at
+** least as much as one at 8192 bits (about 2500 digits), anything
+** cheaper is quicker to do than to hand over...
+*/
+#define EXEC_TASK_MIN_COST                      (EXEC_FUNCTION_COST_RATIO * 8192.0 * 13.0)
+
+/*
+** A part of a program that can run on its own thread, the subtree of
+** tokens first to last, once the tasks below it have finished...
+*/
+typedef struct {
+    int                 first;
+    int                 last;
+    int                 parent;
+
+    /*
+    ** The tasks whose results it needs, in token order...
+    */
+    vector<int>         children;
+}
+task_t;
+
+/*
+** A sum or product written in a calculation is replaced, when it is
+** compiled, by this followed by its place in the program's sums...
+*/
+#define SUM_TOKEN_PREFIX                        '$'
+
+struct _program_t;
+
+/*
+** sum(index, from, to, expression) or prod(...) in a calculation, the
+** limits and the terms are programs of their own, to is empty if it is
+** inf...
+*/
+typedef struct {
+    string                      index;
+    bool                        isProduct;
+
+    shared_ptr<_program_t>      from;
+    shared_ptr<_program_t>      to;
+    shared_ptr<_program_t>      body;
+}
+summation_t;
+
+/*
+** A calculation that has been tokenised and converted to RPN, ready
+** to be executed any number of times without being parsed again...
+*/
+typedef struct _program_t {
+    vector<string>      tokens;
+
+    /*
+    ** The numbers in the calculation, read when it is compiled, the
+    ** other tokens have no value...
+    */
+    vector<value_t>     values;
+    int                 radix;
+
+    /*
+    ** For each operator, the kernel chosen from its operands...
+    */
+    vector<kernel_t>    kernels;
+
+    /*
+    ** For each token, the first token of the subtree it ends...
+    */
+    vector<int>         starts;
+
+    /*
+    ** The expensive subtrees that do not depend on each other, ending with
+    ** the whole program. Empty if there is nothing to run in parallel...
+    */
+    vector<task_t>      tasks;
+
+    /*
+    ** The sums and products in the calculation, by the number in their
+    ** tokens...
+    */
+    vector<summation_t> sums;
+}
+program_t;
+
+/*
+** The values to use for the named variables in a program. A name that
+** is not bound is looked up in the named memory registers...
+*/
+typedef unordered_map<string, value_t>  bindings_t;
+
+/*
+** The result of each operator and function the last time a program was
+** run, by token. When the program is run again at a higher precision
+** the results that are still good enough, those that are exact or were
+** worked out to at least as many bits, are used rather than worked out
+** again...
+*/
+typedef struct {
+    vector<value_t>     values;
+
+    /*
+    ** The digits being displayed when they were worked out. Constants
+    ** are rounded to them, so anything worked out from one is not good
+    ** enough for more digits, however many bits it has...
+    */
+    mpfr_prec_t         precision;
+}
+subtotals_t;
+
+void        compile(program_t * program, const char * pszExpression, int radix);
+value_t     execute(const program_t * program, const bindings_t * bindings = NULL);
+value_t     refine(program_t * program, subtotals_t * subtotals);
+void        executeAt(mpfr_t result, const program_t * program, const string & variable, mpfr_t x);
+void        runParallel(size_t n, const function<void(size_t)> & job);
+value_t     evaluate(const char * pszExpression, int radix);
 
 #endif
@@ -0,0 +1,248 @@
+#include <string>
+#include <map>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "client.h"
+
+using namespace std;
+
+static int _connect(const char * pszSocketPath) {
+    struct sockaddr_un      addr;
+    int                     fd;
+
+    if (strlen(pszSocketPath) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path '%s' is too long\n", pszSocketPath);
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, pszSocketPath, sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Failed to connect to '%s': %s\n", pszSocketPath, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool _send(int fd, const string & request) {
+    size_t sent = 0;
+
+    while (sent < request.length()) {
+        ssize_t n = send(fd, request.data() + sent, request.length() - sent, MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        sent += n;
+    }
+
+    return true;
+}
+
+static bool _receive(int fd, string & buffer, string & response) {
+    char        readBuffer[SERVER_READ_BUFFER_SIZE];
+    size_t      end;
+
+    while ((end = buffer.find('\n')) == string::npos) {
+        ssize_t n = read(fd, readBuffer, sizeof(readBuffer));
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (n <= 0) {
+            return false;
+        }
+
+        buffer.append(readBuffer, n);
+    }
+
+    response = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+
+    return true;
+}
+
+static int _print(const string & response) {
+    if (response.compare(0, strlen(RESPONSE_RESULT), RESPONSE_RESULT) == 0) {
+        printf("%s\n", response.substr(strlen(RESPONSE_RESULT)).c_str());
+    }
+    else if (response.compare(0, strlen(RESPONSE_ERROR), RESPONSE_ERROR) == 0) {
+        fprintf(stderr, "%s\n", response.substr(strlen(RESPONSE_ERROR)).c_str());
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+** The number of lines that follow a batch or vector header, in a request
+** or a response, 0 for anything else. The server reads a frame with a
+** size out of range as a single request, and so does this...
+*/
+static size_t _frameSize(const string & line) {
+    bool isBatch = (line.compare(0, 6, "batch ") == 0);
+    bool isVector = (line.compare(0, 7, "vector ") == 0);
+
+    if (!isBatch && !isVector) {
+        return 0;
+    }
+
+    size_t n = strtoul(line.c_str() + (isBatch ? 6 : 7), NULL, 10);
+
+    return (n <= SERVER_MAX_BATCH_SIZE ? n : 0);
+}
+
+/*
+** Send each line of stdin to the server, printing results on stdout
+** and errors on stderr. Returns non-zero if any request failed.
+**
+** Each request is tagged with its number so that up to a window's
+** worth of requests can be in flight at once, the results are still
+** printed in the order of the input. The lines of a batch or vector
+** frame are sent on untagged, and its response is read back as the
+** header and a line for each of them...
+*/
+int cliRun(const char * pszSocketPath) {
+    char *                      pszLine = NULL;
+    size_t                      lineLength = 0;
+    ssize_t                     n;
+    string                      buffer;
+    string                      requests;
+    string                      response;
+    map<uint64_t, vector<string>>   results;
+    uint64_t                    numSent = 0;
+    size_t                      numFrameLines = 0;
+    uint64_t                    numPrinted = 0;
+    uint64_t                    windowSize;
+    bool                        isEndOfInput = false;
+    int                         status = 0;
+    int                         fd;
+
+    fd = _connect(pszSocketPath);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    /*
+    ** Someone typing at the terminal wants each answer straight away...
+    */
+    windowSize = (isatty(fileno(stdin)) ? 1 : CLIENT_WINDOW_SIZE);
+
+    while (true) {
+        while (!isEndOfInput && (numFrameLines > 0 || (numSent - numPrinted) < windowSize)) {
+            if ((n = getline(&pszLine, &lineLength, stdin)) < 0) {
+                isEndOfInput = true;
+                break;
+            }
+
+            string request(pszLine, n);
+
+            while (!request.empty() && (request.back() == '\n' || request.back() == '\r')) {
+                request.pop_back();
+            }
+
+            if (numFrameLines > 0) {
+                requests.append(request + "\n");
+                numFrameLines--;
+                continue;
+            }
+
+            if (request.empty()) {
+                continue;
+            }
+
+            requests.append("#" + to_string(++numSent) + " " + request + "\n");
+            numFrameLines = _frameSize(request);
+        }
+
+        if (!requests.empty()) {
+            if (!_send(fd, requests)) {
+                fprintf(stderr, "Lost connection to server\n");
+                status = -1;
+                break;
+            }
+
+            requests.clear();
+        }
+
+        if (numPrinted == numSent) {
+            if (isEndOfInput) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (!_receive(fd, buffer, response)) {
+            fprintf(stderr, "Lost connection to server\n");
+            status = -1;
+            break;
+        }
+
+        size_t space = response.find(' ');
+
+        if (response[0] != '#' || space == string::npos) {
+            fprintf(stderr, "Unexpected response '%s'\n", response.c_str());
+            continue;
+        }
+
+        vector<string> & lines = results[strtoull(response.c_str() + 1, NULL, 10)];
+
+        lines.push_back(response.substr(space + 1));
+
+        /*
+        ** The server writes the whole of a frame's response at once...
+        */
+        for (size_t i = _frameSize(lines[0]);i > 0;i--) {
+            if (!_receive(fd, buffer, response)) {
+                break;
+            }
+
+            lines.push_back(response);
+        }
+
+        while (!results.empty() && results.begin()->first == numPrinted + 1) {
+            for (const string & line : results.begin()->second) {
+                if (_print(line)) {
+                    status = 1;
+                }
+            }
+
+            results.erase(results.begin());
+            numPrinted++;
+        }
+    }
+
+    free(pszLine);
+    close(fd);
+
+    return status;
+}
@@ -0,0 +1,8 @@
+#ifndef __INCL_CLIENT
+#define __INCL_CLIENT
+
+#define CLIENT_WINDOW_SIZE                     128
+
+int         cliRun(const char * pszSocketPath);
+
+#endif
@@ -1,10 +1,12 @@
 #include <string>
+#include <unordered_map>
 
 #include <gmp.h>
 #include <mpfr.h>
 
 #include "logger.h"
 #include "system.h"
+#include "series.h"
 
 using namespace std;
 
@@ -16,19 +18,33 @@ using namespace std;
 
 class Constant {
     public:
-        static string evaluate(string & token) {
+        static value_t evaluate(const string & token) {
             mpfr_t          r;
-            char            szOutputString[OUTPUT_MAX_STRING_LENGTH];
-            char            szFormatString[FORMAT_STRING_LENGTH];
-            string          result;
+
+            /*
+            ** Constants only change with the precision, so each thread
+            ** keeps the ones it has already worked out...
+            */
+            static thread_local unordered_map<string, value_t> cache;
+
+            string key = token + ':' + to_string((long)getPrecision());
+
+            auto cached = cache.find(key);
+
+            if (cached != cache.end()) {
+                return cached->second;
+            }
 
             mpfr_init2(r, getBasePrecision());
 
             if (token.compare("pi") == 0) {
-                mpfr_const_pi(r, MPFR_RNDA);
+                serPi(r);
+            }
+            else if (token.compare("e") == 0) {
+                serE(r);
             }
             else if (token.compare("eu") == 0) {
-                mpfr_const_euler(r, MPFR_RNDA);
+                serEuler(r);
             }
             else if (token.compare("g") == 0) {
                 mpfr_set_str(r ,CONSTANT_G, 10, MPFR_RNDA);
@@ -37,13 +53,17 @@ class Constant {
                 mpfr_set_ui(r, CONSTANT_C, MPFR_RNDA);
             }
 
-            snprintf(szFormatString, FORMAT_STRING_LENGTH, "%%.%ldRf", (long)getPrecision());
-            mpfr_snprintf(szOutputString, OUTPUT_MAX_STRING_LENGTH, szFormatString, r);
-
-            result.assign(szOutputString);
+            /*
+            ** A constant has the number of decimal places being displayed...
+            */
+            string digits = toString(r, DECIMAL, (long)getPrecision());
 
             mpfr_clear(r);
 
+            value_t result = parseValue(digits.c_str(), DECIMAL);
+
+            cache[key] = result;
+
             return result;
         }
 };
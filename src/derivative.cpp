@@ -0,0 +1,891 @@
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "logger.h"
+#include "calc_error.h"
+#include "system.h"
+#include "utils.h"
+#include "operator.h"
+#include "function.h"
+#include "constant.h"
+#include "series.h"
+#include "calculator.h"
+#include "derivative.h"
+
+using namespace std;
+
+/*
+** The arithmetic of the coefficients at the working precision. The value
+** of each operator and function is worked out just as a calculation would
+** work it out, so f(x) is the same as running the program...
+*/
+class MpfrArithmetic {
+    public:
+        typedef value_t     scalar_t;
+
+        static value_t fromValue(const value_t & v) {
+            return toReal(v);
+        }
+
+        static value_t fromLong(long n) {
+            value_t r = newValue();
+
+            mpfr_set_si(r->v, n, MPFR_RNDN);
+
+            return r;
+        }
+
+        static bool isZero(const value_t & a) {
+            return (mpfr_zero_p(a->v) != 0);
+        }
+
+        static double toDouble(const value_t & a) {
+            return mpfr_get_d(a->v, MPFR_RNDN);
+        }
+
+        static value_t add(const value_t & a, const value_t & b) {
+            value_t r = newValue();
+
+            mpfr_add(r->v, a->v, b->v, MPFR_RNDN);
+
+            return r;
+        }
+
+        static value_t sub(const value_t & a, const value_t & b) {
+            value_t r = newValue();
+
+            mpfr_sub(r->v, a->v, b->v, MPFR_RNDN);
+
+            return r;
+        }
+
+        static value_t mul(const value_t & a, const value_t & b) {
+            value_t r = newValue();
+
+            mpfr_mul(r->v, a->v, b->v, MPFR_RNDN);
+
+            return r;
+        }
+
+        static value_t div(const value_t & a, const value_t & b) {
+            value_t r = newValue();
+
+            mpfr_div(r->v, a->v, b->v, MPFR_RNDN);
+
+            return r;
+        }
+
+        static value_t mulSi(const value_t & a, long n) {
+            value_t r = newValue();
+
+            mpfr_mul_si(r->v, a->v, n, MPFR_RNDN);
+
+            return r;
+        }
+
+        static value_t divSi(const value_t & a, long n) {
+            value_t r = newValue();
+
+            mpfr_div_si(r->v, a->v, n, MPFR_RNDN);
+
+            return r;
+        }
+
+        static value_t operate(char op, const value_t & a, const value_t & b) {
+            return toReal(Operator::evaluate(string(1, op), DECIMAL, a, b));
+        }
+
+        static value_t function(const string & f, const value_t & a) {
+            return toReal(Function::evaluate(f, DECIMAL, a));
+        }
+
+        static value_t function(const string & f, const value_t & a, const value_t & b) {
+            return toReal(Function::evaluate(f, DECIMAL, a, b));
+        }
+
+        static value_t digamma(const value_t & a) {
+            value_t r = newValue();
+
+            mpfr_digamma(r->v, a->v, MPFR_RNDN);
+
+            return r;
+        }
+
+        /*
+        ** pi / 180, the angles are in degrees...
+        */
+        static value_t degree(void) {
+            value_t r = newValue();
+
+            serPi(r->v);
+            mpfr_div_ui(r->v, r->v, 180U, MPFR_RNDN);
+
+            return r;
+        }
+};
+
+/*
+** The same with doubles, for the first steps of an iteration where the
+** working precision would be wasted...
+*/
+class DoubleArithmetic {
+    public:
+        typedef double      scalar_t;
+
+        static double fromValue(const value_t & v) {
+            return mpfr_get_d(toReal(v)->v, MPFR_RNDN);
+        }
+
+        static double fromLong(long n) {
+            return (double)n;
+        }
+
+        static bool isZero(double a) {
+            return (a == 0.0);
+        }
+
+        static double toDouble(double a) {
+            return a;
+        }
+
+        static double add(double a, double b) {
+            return a + b;
+        }
+
+        static double sub(double a, double b) {
+            return a - b;
+        }
+
+        static double mul(double a, double b) {
+            return a * b;
+        }
+
+        static double div(double a, double b) {
+            return a / b;
+        }
+
+        static double mulSi(double a, long n) {
+            return a * (double)n;
+        }
+
+        static double divSi(double a, long n) {
+            return a / (double)n;
+        }
+
+        static double operate(char op, double a, double b) {
+            switch (op) {
+                case '+':
+                    return a + b;
+
+                case '-':
+                    return a - b;
+
+                case '*':
+                    return a * b;
+
+                case '/':
+                    return a / b;
+
+                case '%':
+                    return remainder(a, b);
+
+                case '^':
+                    return pow(a, b);
+
+                case ':':
+                    /*
+                    ** Odd roots of negative numbers are real...
+                    */
+                    if (a < 0.0 && fmod(b, 2.0) != 0.0) {
+                        return -pow(-a, 1.0 / b);
+                    }
+
+                    return pow(a, 1.0 / b);
+            }
+
+            throw derivative_error(calc_error::buildMsg("The operator '%c' cannot be differentiated", op));
+        }
+
+        static double function(const string & f, double a) {
+            if (f.compare("sin") == 0) {
+                return sin(a * degree());
+            }
+            else if (f.compare("cos") == 0) {
+                return cos(a * degree());
+            }
+            else if (f.compare("tan") == 0) {
+                return tan(a * degree());
+            }
+            else if (f.compare("asin") == 0) {
+                return asin(a) / degree();
+            }
+            else if (f.compare("acos") == 0) {
+                return acos(a) / degree();
+            }
+            else if (f.compare("atan") == 0) {
+                return atan(a) / degree();
+            }
+            else if (f.compare("sinh") == 0) {
+                return sinh(a);
+            }
+            else if (f.compare("cosh") == 0) {
+                return cosh(a);
+            }
+            else if (f.compare("tanh") == 0) {
+                return tanh(a);
+            }
+            else if (f.compare("asinh") == 0) {
+                return asinh(a);
+            }
+            else if (f.compare("acosh") == 0) {
+                return acosh(a);
+            }
+            else if (f.compare("atanh") == 0) {
+                return atanh(a);
+            }
+            else if (f.compare("sqrt") == 0) {
+                return sqrt(a);
+            }
+            else if (f.compare("log") == 0) {
+                return log10(a);
+            }
+            else if (f.compare("ln") == 0) {
+                return log(a);
+            }
+            else if (f.compare("fact") == 0) {
+                return tgamma(a + 1.0);
+            }
+            else if (f.compare("gamma") == 0) {
+                return tgamma(a);
+            }
+            else if (f.compare("lngamma") == 0) {
+                return lgamma(a);
+            }
+            else if (f.compare("rad") == 0) {
+                return a * degree();
+            }
+            else if (f.compare("deg") == 0) {
+                return a / degree();
+            }
+
+            throw derivative_error(calc_error::buildMsg("%s() cannot be differentiated", f.c_str()));
+        }
+
+        /*
+        ** Only needed when both operands are constant, so rare enough to
+        ** borrow the real numbers...
+        */
+        static double function(const string & f, double a, double b) {
+            value_t x = newValue();
+            value_t y = newValue();
+
+            mpfr_set_d(x->v, a, MPFR_RNDN);
+            mpfr_set_d(y->v, b, MPFR_RNDN);
+
+            return mpfr_get_d(toReal(Function::evaluate(f, DECIMAL, x, y))->v, MPFR_RNDN);
+        }
+
+        static double digamma(double a) {
+            mpfr_t      x;
+            double      r;
+
+            mpfr_init2(x, 64);
+            mpfr_set_d(x, a, MPFR_RNDN);
+            mpfr_digamma(x, x, MPFR_RNDN);
+
+            r = mpfr_get_d(x, MPFR_RNDN);
+
+            mpfr_clear(x);
+
+            return r;
+        }
+
+        static double degree(void) {
+            return M_PI / 180.0;
+        }
+};
+
+/*
+** Truncated Taylor series, the coefficients of f(x + h) in powers of h
+** up to the order wanted. Each operator and function works out the
+** series of its result from the series of its operands with the usual
+** recurrences, in one pass over the program, so there are no differences
+** and nothing to choose a step for...
+*/
+template <class A> class Taylor {
+    private:
+        typedef typename A::scalar_t    scalar_t;
+        typedef vector<scalar_t>        series_t;
+
+        static series_t _constant(const scalar_t & c, int order) {
+            series_t s(order + 1, A::fromLong(0));
+
+            s[0] = c;
+
+            return s;
+        }
+
+        static bool _isConstant(const series_t & a) {
+            for (size_t k = 1;k < a.size();k++) {
+                if (!A::isZero(a[k])) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        static int _order(const series_t & a) {
+            return (int)a.size() - 1;
+        }
+
+        static series_t _add(const series_t & a, const series_t & b) {
+            series_t r(a.size());
+
+            for (size_t k = 0;k < a.size();k++) {
+                r[k] = A::add(a[k], b[k]);
+            }
+
+            return r;
+        }
+
+        static series_t _sub(const series_t & a, const series_t & b) {
+            series_t r(a.size());
+
+            for (size_t k = 0;k < a.size();k++) {
+                r[k] = A::sub(a[k], b[k]);
+            }
+
+            return r;
+        }
+
+        static series_t _scale(const series_t & a, const scalar_t & s) {
+            series_t r(a.size());
+
+            for (size_t k = 0;k < a.size();k++) {
+                r[k] = A::mul(a[k], s);
+            }
+
+            return r;
+        }
+
+        static series_t _mul(const series_t & a, const series_t & b) {
+            series_t r(a.size());
+
+            for (int k = 0;k <= _order(a);k++) {
+                scalar_t sum = A::mul(a[0], b[k]);
+
+                for (int j = 1;j <= k;j++) {
+                    sum = A::add(sum, A::mul(a[j], b[k - j]));
+                }
+
+                r[k] = sum;
+            }
+
+            return r;
+        }
+
+        static series_t _div(const series_t & a, const series_t & b) {
+            series_t r(a.size());
+
+            r[0] = A::div(a[0], b[0]);
+
+            for (int k = 1;k <= _order(a);k++) {
+                scalar_t sum = a[k];
+
+                for (int j = 1;j <= k;j++) {
+                    sum = A::sub(sum, A::mul(b[j], r[k - j]));
+                }
+
+                r[k] = A::div(sum, b[0]);
+            }
+
+            return r;
+        }
+
+        /*
+        ** y' = u' w, for the functions whose derivative is simpler than
+        ** they are, e.g. atan...
+        */
+        static series_t _integrate(const scalar_t & y0, const series_t & u, const series_t & w) {
+            series_t r(u.size());
+
+            r[0] = y0;
+
+            for (int k = 1;k <= _order(u);k++) {
+                scalar_t sum = A::mul(u[1], w[k - 1]);
+
+                for (int j = 2;j <= k;j++) {
+                    sum = A::add(sum, A::mul(A::mulSi(u[j], j), w[k - j]));
+                }
+
+                r[k] = A::divSi(sum, k);
+            }
+
+            return r;
+        }
+
+        /*
+        ** y = exp(w), y' = w' y...
+        */
+        static series_t _exponential(const scalar_t & y0, const series_t & w) {
+            series_t r(w.size());
+
+            r[0] = y0;
+
+            for (int k = 1;k <= _order(w);k++) {
+                scalar_t sum = A::mul(w[1], r[k - 1]);
+
+                for (int j = 2;j <= k;j++) {
+                    sum = A::add(sum, A::mul(A::mulSi(w[j], j), r[k - j]));
+                }
+
+                r[k] = A::divSi(sum, k);
+            }
+
+            return r;
+        }
+
+        /*
+        ** y = ln(u), u y' = u'...
+        */
+        static series_t _log(const series_t & u) {
+            series_t r(u.size());
+
+            r[0] = A::function("ln", u[0]);
+
+            for (int k = 1;k <= _order(u);k++) {
+                scalar_t sum = A::mulSi(u[k], k);
+
+                for (int j = 1;j < k;j++) {
+                    sum = A::sub(sum, A::mul(A::mulSi(r[j], j), u[k - j]));
+                }
+
+                r[k] = A::div(A::divSi(sum, k), u[0]);
+            }
+
+            return r;
+        }
+
+        /*
+        ** y = sqrt(u), y y = u...
+        */
+        static series_t _sqrt(const series_t & u) {
+            series_t r(u.size());
+
+            r[0] = A::function("sqrt", u[0]);
+
+            for (int k = 1;k <= _order(u);k++) {
+                scalar_t sum = u[k];
+
+                for (int j = 1;j < k;j++) {
+                    sum = A::sub(sum, A::mul(r[j], r[k - j]));
+                }
+
+                r[k] = A::div(sum, A::mulSi(r[0], 2));
+            }
+
+            return r;
+        }
+
+        /*
+        ** y = u^p for a constant p, u y' = p u' y. Needs u(0) not to be
+        ** 0, unless p is a whole number...
+        */
+        static series_t _power(const scalar_t & y0, const series_t & u, const scalar_t & p) {
+            double  n = A::toDouble(p);
+
+            if (A::isZero(u[0]) && n >= 0.0 && n <= (double)LONG_MAX && n == floor(n)) {
+                series_t r = _constant(A::fromLong(1), _order(u));
+                series_t b = u;
+
+                for (unsigned long e = (unsigned long)n;e > 0;e >>= 1) {
+                    if (e & 1) {
+                        r = _mul(r, b);
+                    }
+
+                    if (e > 1) {
+                        b = _mul(b, b);
+                    }
+                }
+
+                r[0] = y0;
+
+                return r;
+            }
+
+            series_t r(u.size());
+
+            r[0] = y0;
+
+            for (int k = 1;k <= _order(u);k++) {
+                scalar_t sum = A::mul(A::sub(p, A::fromLong(k - 1)), A::mul(u[1], r[k - 1]));
+
+                for (int j = 2;j <= k;j++) {
+                    sum = A::add(sum, A::mul(A::sub(A::mulSi(p, j), A::fromLong(k - j)), A::mul(u[j], r[k - j])));
+                }
+
+                r[k] = A::div(A::divSi(sum, k), u[0]);
+            }
+
+            return r;
+        }
+
+        /*
+        ** s = sin(v), c = cos(v), s' = v' c and c' = -v' s, or +v' s for
+        ** the hyperbolic functions...
+        */
+        static void _sinCos(const scalar_t & s0, const scalar_t & c0, const series_t & v, series_t & s, series_t & c, bool isHyperbolic) {
+            s.assign(v.size(), s0);
+            c.assign(v.size(), c0);
+
+            for (int k = 1;k <= _order(v);k++) {
+                scalar_t sumS = A::mul(v[1], c[k - 1]);
+                scalar_t sumC = A::mul(v[1], s[k - 1]);
+
+                for (int j = 2;j <= k;j++) {
+                    scalar_t jv = A::mulSi(v[j], j);
+
+                    sumS = A::add(sumS, A::mul(jv, c[k - j]));
+                    sumC = A::add(sumC, A::mul(jv, s[k - j]));
+                }
+
+                s[k] = A::divSi(sumS, k);
+                c[k] = A::divSi(sumC, (isHyperbolic ? k : -k));
+            }
+        }
+
+        static series_t _operate(char op, const series_t & a, const series_t & b) {
+            int         order = _order(a);
+            scalar_t    y0;
+
+            switch (op) {
+                case '+':
+                case '-':
+                case '*':
+                case '/':
+                case '%':
+                case '^':
+                case ':':
+                    y0 = A::operate(op, a[0], b[0]);
+                    break;
+
+                default:
+                    throw derivative_error(calc_error::buildMsg("The operator '%c' cannot be differentiated", op));
+            }
+
+            if (_isConstant(a) && _isConstant(b)) {
+                return _constant(y0, order);
+            }
+
+            series_t r;
+
+            switch (op) {
+                case '+':
+                    r = _add(a, b);
+                    break;
+
+                case '-':
+                    r = _sub(a, b);
+                    break;
+
+                case '*':
+                    r = _mul(a, b);
+                    break;
+
+                case '/':
+                    r = _div(a, b);
+                    break;
+
+                /*
+                ** a - q b for the whole number q the remainder is taken
+                ** from...
+                */
+                case '%':
+                    r = _sub(a, _scale(b, A::div(A::sub(a[0], y0), b[0])));
+                    break;
+
+                case '^':
+                    if (_isConstant(b)) {
+                        r = _power(y0, a, b[0]);
+                    }
+                    else {
+                        r = _exponential(y0, _mul(b, _log(a)));
+                    }
+                    break;
+
+                case ':':
+                    if (!_isConstant(b)) {
+                        throw derivative_error("The root in ':' must be a constant to be differentiated");
+                    }
+
+                    r = _power(y0, a, A::div(A::fromLong(1), b[0]));
+                    break;
+            }
+
+            r[0] = y0;
+
+            return r;
+        }
+
+        static series_t _function(const string & f, const series_t & u) {
+            int         order = _order(u);
+            scalar_t    y0 = A::function(f, u[0]);
+
+            if (_isConstant(u)) {
+                return _constant(y0, order);
+            }
+
+            series_t    one = _constant(A::fromLong(1), order);
+            series_t    r;
+
+            if (f.compare("sin") == 0 || f.compare("cos") == 0 || f.compare("tan") == 0) {
+                series_t s;
+                series_t c;
+
+                _sinCos(A::function("sin", u[0]), A::function("cos", u[0]), _scale(u, A::degree()), s, c, false);
+
+                r = (f.compare("sin") == 0 ? s : (f.compare("cos") == 0 ? c : _div(s, c)));
+            }
+            else if (f.compare("sinh") == 0 || f.compare("cosh") == 0 || f.compare("tanh") == 0) {
+                series_t s;
+                series_t c;
+
+                _sinCos(A::function("sinh", u[0]), A::function("cosh", u[0]), u, s, c, true);
+
+                r = (f.compare("sinh") == 0 ? s : (f.compare("cosh") == 0 ? c : _div(s, c)));
+            }
+            else if (f.compare("asin") == 0 || f.compare("acos") == 0) {
+                series_t w = _div(one, _sqrt(_sub(one, _mul(u, u))));
+                scalar_t d = A::div(A::fromLong(f.compare("asin") == 0 ? 1 : -1), A::degree());
+
+                r = _integrate(y0, u, _scale(w, d));
+            }
+            else if (f.compare("atan") == 0) {
+                series_t w = _div(one, _add(one, _mul(u, u)));
+
+                r = _integrate(y0, u, _scale(w, A::div(A::fromLong(1), A::degree())));
+            }
+            else if (f.compare("asinh") == 0) {
+                r = _integrate(y0, u, _div(one, _sqrt(_add(_mul(u, u), one))));
+            }
+            else if (f.compare("acosh") == 0) {
+                r = _integrate(y0, u, _div(one, _sqrt(_sub(_mul(u, u), one))));
+            }
+            else if (f.compare("atanh") == 0) {
+                r = _integrate(y0, u, _div(one, _sub(one, _mul(u, u))));
+            }
+            else if (f.compare("sqrt") == 0) {
+                r = _sqrt(u);
+            }
+            else if (f.compare("ln") == 0) {
+                r = _log(u);
+            }
+            else if (f.compare("log") == 0) {
+                r = _scale(_log(u), A::div(A::fromLong(1), A::function("ln", A::fromLong(10))));
+            }
+            else if (f.compare("rad") == 0) {
+                r = _scale(u, A::degree());
+            }
+            else if (f.compare("deg") == 0) {
+                r = _scale(u, A::div(A::fromLong(1), A::degree()));
+            }
+            else if (f.compare("gamma") == 0 || f.compare("fact") == 0 || f.compare("lngamma") == 0) {
+                /*
+                ** The higher derivatives need the polygamma functions,
+                ** which MPFR does not have...
+                */
+                if (order > 1) {
+                    throw derivative_error(calc_error::buildMsg("Only the first derivative of %s() can be worked out", f.c_str()));
+                }
+
+                scalar_t psi = A::digamma(f.compare("fact") == 0 ? A::add(u[0], A::fromLong(1)) : u[0]);
+
+                r = _constant(y0, order);
+                r[1] = A::mul(psi, u[1]);
+
+                if (f.compare("lngamma") != 0) {
+                    r[1] = A::mul(y0, r[1]);
+                }
+            }
+            else {
+                throw derivative_error(calc_error::buildMsg("%s() cannot be differentiated", f.c_str()));
+            }
+
+            r[0] = y0;
+
+            return r;
+        }
+
+    public:
+        static series_t run(
+                    const program_t * program,
+                    const string & variable,
+                    const scalar_t & x,
+                    int order,
+                    const bindings_t * bindings)
+        {
+            vector<series_t>    stack;
+
+            for (size_t i = 0;i < program->tokens.size();i++) {
+                const string & t = program->tokens[i];
+
+                if (program->values[i]) {
+                    stack.push_back(_constant(A::fromValue(program->values[i]), order));
+                }
+                else if (Utils::isOperator(t[0])) {
+                    if (stack.size() < 2) {
+                        throw stack_error("Missing operand for operator", __FILE__, __LINE__);
+                    }
+
+                    series_t b = stack.back();
+                    stack.pop_back();
+
+                    stack.back() = _operate(t[0], stack.back(), b);
+                }
+                else if (Utils::isConstant(t)) {
+                    stack.push_back(_constant(A::fromValue(Constant::evaluate(t)), order));
+                }
+                else if (Utils::isFunction(t)) {
+                    int arity = Function::getArity(t);
+
+                    if (stack.size() < (size_t)arity) {
+                        throw stack_error("Missing operand for function", __FILE__, __LINE__);
+                    }
+
+                    if (arity == 2) {
+                        series_t b = stack.back();
+                        stack.pop_back();
+
+                        if (!_isConstant(stack.back()) || !_isConstant(b)) {
+                            throw derivative_error(calc_error::buildMsg("%s() cannot be differentiated", t.c_str()));
+                        }
+
+                        stack.back() = _constant(A::function(t, stack.back()[0], b[0]), order);
+                    }
+                    else {
+                        stack.back() = _function(t, stack.back());
+                    }
+                }
+                else if (t[0] == SUM_TOKEN_PREFIX) {
+                    throw derivative_error("A sum or product cannot be differentiated");
+                }
+                else if (Utils::isVariable(t)) {
+                    if (t.compare(variable) == 0) {
+                        series_t s = _constant(x, order);
+
+                        if (order > 0) {
+                            s[1] = A::fromLong(1);
+                        }
+
+                        stack.push_back(s);
+                        continue;
+                    }
+
+                    value_t v;
+
+                    if (bindings != NULL) {
+                        auto binding = bindings->find(t);
+
+                        if (binding != bindings->end()) {
+                            v = binding->second;
+                        }
+                    }
+
+                    if (!v) {
+                        v = memFind(t);
+                    }
+
+                    if (!v) {
+                        throw invalid_token_error(
+                                    calc_error::buildMsg(
+                                                "Unknown variable: %s",
+                                                t.c_str()),
+                                    __FILE__,
+                                    __LINE__);
+                    }
+
+                    stack.push_back(_constant(A::fromValue(v), order));
+                }
+            }
+
+            if (stack.size() != 1) {
+                throw stack_error("Invalid items on stack", __FILE__, __LINE__);
+            }
+
+            return stack.back();
+        }
+};
+
+static void _checkOrder(int order) {
+    if (order < 0 || order > DERIVATIVE_MAX_ORDER) {
+        throw calc_error(calc_error::buildMsg("The order of a derivative must be between 0 and %d", DERIVATIVE_MAX_ORDER));
+    }
+}
+
+void derTaylor(
+            vector<value_t> & coefficients,
+            int order,
+            const program_t * program,
+            const string & variable,
+            mpfr_t x,
+            const bindings_t * bindings)
+{
+    value_t     v = newValue();
+
+    _checkOrder(order);
+
+    mpfr_set(v->v, x, MPFR_RNDN);
+
+    coefficients = Taylor<MpfrArithmetic>::run(program, variable, v, order, bindings);
+}
+
+void derTaylorDouble(
+            double * coefficients,
+            int order,
+            const program_t * program,
+            const string & variable,
+            double x)
+{
+    _checkOrder(order);
+
+    vector<double> series = Taylor<DoubleArithmetic>::run(program, variable, x, order, NULL);
+
+    for (int k = 0;k <= order;k++) {
+        coefficients[k] = series[k];
+    }
+}
+
+/*
+** One pass for each variable, the others held at their values...
+*/
+void derGradient(
+            vector<value_t> & gradient,
+            const program_t * program,
+            const vector<string> & variables,
+            const vector<value_t> & at)
+{
+    gradient.clear();
+
+    for (size_t i = 0;i < variables.size();i++) {
+        bindings_t          bindings;
+        vector<value_t>     coefficients;
+
+        for (size_t j = 0;j < variables.size();j++) {
+            if (j != i) {
+                bindings[variables[j]] = at[j];
+            }
+        }
+
+        derTaylor(coefficients, 1, program, variables[i], toReal(at[i])->v, &bindings);
+
+        gradient.push_back(coefficients[1]);
+    }
+}
@@ -0,0 +1,56 @@
+#include <string>
+#include <vector>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "system.h"
+#include "calculator.h"
+
+using namespace std;
+
+#ifndef __INCL_DERIVATIVE
+#define __INCL_DERIVATIVE
+
+/*
+** Each operator and function costs about the square of the order, so the
+** order is limited...
+*/
+#define DERIVATIVE_MAX_ORDER                    256
+
+/*
+** The Taylor coefficients of the program in the named variable about x,
+** f(x), f'(x), f''(x) / 2!, ... up to f^n(x) / n! for order n, worked
+** out in one pass with truncated power series rather than differences.
+** Any other variables are taken from the bindings or the registers. A
+** program that cannot be differentiated throws derivative_error...
+*/
+void        derTaylor(
+                    vector<value_t> & coefficients,
+                    int order,
+                    const program_t * program,
+                    const string & variable,
+                    mpfr_t x,
+                    const bindings_t * bindings = NULL);
+
+/*
+** The same with doubles, coefficients must have room for order + 1...
+*/
+void        derTaylorDouble(
+                    double * coefficients,
+                    int order,
+                    const program_t * program,
+                    const string & variable,
+                    double x);
+
+/*
+** The partial derivatives of the program with respect to each of the
+** variables, at the point where they have the values given...
+*/
+void        derGradient(
+                    vector<value_t> & gradient,
+                    const program_t * program,
+                    const vector<string> & variables,
+                    const vector<value_t> & at);
+
+#endif
@@ -0,0 +1,286 @@
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "system.h"
+#include "digits.h"
+
+using namespace std;
+
+/*
+** Enough levels of powers for numbers far bigger than will fit in memory...
+*/
+#define DIGITS_MAX_LEVELS                   48
+
+/*
+** Where the digits are going, and how far they have got...
+*/
+typedef struct {
+    FILE *          f;
+    int             radix;
+
+    size_t          numDigits;
+    size_t          numWritten;
+    size_t          pointPosition;
+
+    bool            showProgress;
+    int             percentDone;
+
+    /*
+    ** powers[n] is radix^(DIGITS_CHUNK_SIZE * 2^n)...
+    */
+    mpz_t           powers[DIGITS_MAX_LEVELS];
+    int             numPowers;
+
+    string          buffer;
+}
+digit_stream_t;
+
+static void _progress(digit_stream_t * s) {
+    int percentDone;
+
+    if (!s->showProgress) {
+        return;
+    }
+
+    percentDone = (int)((s->numWritten * 100) / s->numDigits);
+
+    if (percentDone != s->percentDone) {
+        s->percentDone = percentDone;
+
+        fprintf(stderr, "\rWriting %zu digits: %d%%", s->numDigits, percentDone);
+
+        if (s->numWritten == s->numDigits) {
+            fprintf(stderr, "\n");
+        }
+    }
+}
+
+/*
+** Write some digits, putting the point in if it falls amongst them...
+*/
+static void _emit(digit_stream_t * s, const char * digits, size_t n) {
+    if (s->numWritten < s->pointPosition && s->numWritten + n > s->pointPosition) {
+        size_t before = s->pointPosition - s->numWritten;
+
+        fwrite(digits, 1, before, s->f);
+        fputc('.', s->f);
+        fwrite(&digits[before], 1, n - before, s->f);
+    }
+    else {
+        fwrite(digits, 1, n, s->f);
+
+        if (s->numWritten + n == s->pointPosition && s->pointPosition < s->numDigits) {
+            fputc('.', s->f);
+        }
+    }
+
+    s->numWritten += n;
+
+    _progress(s);
+}
+
+static void _emitZeros(digit_stream_t * s, size_t n) {
+    static const char szZeros[] = "0000000000000000000000000000000000000000000000000000000000000000";
+
+    while (n > 0) {
+        size_t chunk = (n < sizeof(szZeros) - 1 ? n : sizeof(szZeros) - 1);
+
+        _emit(s, szZeros, chunk);
+
+        n -= chunk;
+    }
+}
+
+/*
+** Write exactly numDigits digits of z, with leading zeros if need be. Big
+** numbers are split in two by a power of the radix, so the work is that
+** of a few big divisions rather than one digit at a time, and only one
+** chunk of digits is ever held as text...
+*/
+static void _writeDigits(digit_stream_t * s, mpz_t z, size_t numDigits, int level) {
+    while (level >= 0 && numDigits <= (DIGITS_CHUNK_SIZE << level)) {
+        level--;
+    }
+
+    if (level < 0) {
+        size_t length;
+
+        s->buffer.resize(mpz_sizeinbase(z, s->radix) + 2);
+
+        mpz_get_str(&s->buffer[0], (s->radix <= 36 ? -s->radix : s->radix), z);
+
+        length = strlen(s->buffer.c_str());
+
+        if (mpz_sgn(z) == 0) {
+            length = 0;
+        }
+
+        _emitZeros(s, numDigits - length);
+        _emit(s, s->buffer.c_str(), length);
+    }
+    else {
+        mpz_t       q;
+        mpz_t       r;
+        size_t      numLowDigits = DIGITS_CHUNK_SIZE << level;
+
+        mpz_init(q);
+        mpz_init(r);
+
+        mpz_tdiv_qr(q, r, z, s->powers[level]);
+
+        _writeDigits(s, q, numDigits - numLowDigits, level - 1);
+
+        mpz_clear(q);
+
+        _writeDigits(s, r, numLowDigits, level - 1);
+
+        mpz_clear(r);
+    }
+}
+
+/*
+** The exact number of digits, mpz_sizeinbase() may be one too many...
+*/
+static size_t _numDigits(mpz_t z, int radix) {
+    size_t      numDigits = mpz_sizeinbase(z, radix);
+    mpz_t       p;
+
+    if (numDigits > 1) {
+        mpz_init(p);
+        mpz_ui_pow_ui(p, (unsigned long)radix, (unsigned long)(numDigits - 1));
+
+        if (mpz_cmp(z, p) < 0) {
+            numDigits--;
+        }
+
+        mpz_clear(p);
+    }
+
+    return numDigits;
+}
+
+/*
+** Write a non-negative integer with at least minDigits digits before the
+** point and precision zeros after it...
+*/
+static void _writeInteger(
+            FILE * f,
+            mpz_t z,
+            int radix,
+            size_t minDigits,
+            size_t numFractionDigits,
+            size_t numZeros,
+            bool showProgress)
+{
+    digit_stream_t      s;
+    size_t              numDigits = (mpz_sgn(z) == 0 ? 0 : _numDigits(z, radix));
+    size_t              numPadding = 0;
+
+    if (numDigits < minDigits) {
+        numPadding = minDigits - numDigits;
+    }
+
+    s.f = f;
+    s.radix = radix;
+    s.numWritten = 0;
+    s.numDigits = numPadding + numDigits + numZeros;
+    s.pointPosition = s.numDigits - numFractionDigits - numZeros;
+    s.showProgress = (showProgress && s.numDigits >= DIGITS_PROGRESS_MIN);
+    s.percentDone = -1;
+    s.numPowers = 0;
+
+    /*
+    ** Only the powers needed to split a number this size...
+    */
+    while (s.numPowers < DIGITS_MAX_LEVELS && (DIGITS_CHUNK_SIZE << s.numPowers) < numDigits) {
+        mpz_init(s.powers[s.numPowers]);
+
+        if (s.numPowers == 0) {
+            mpz_ui_pow_ui(s.powers[0], (unsigned long)radix, DIGITS_CHUNK_SIZE);
+        }
+        else {
+            mpz_mul(s.powers[s.numPowers], s.powers[s.numPowers - 1], s.powers[s.numPowers - 1]);
+        }
+
+        s.numPowers++;
+    }
+
+    _emitZeros(&s, numPadding);
+    _writeDigits(&s, z, numDigits, s.numPowers - 1);
+    _emitZeros(&s, numZeros);
+
+    for (int i = 0;i < s.numPowers;i++) {
+        mpz_clear(s.powers[i]);
+    }
+}
+
+/*
+** Write a value followed by a newline, without ever holding more than a
+** chunk of its digits as text...
+*/
+void digWrite(FILE * f, const value_t & value, int radix, long precision, bool showProgress) {
+    mpz_t       z;
+    bool        isNegative;
+    size_t      minDigits = 1;
+    size_t      numFractionDigits = 0;
+    size_t      numZeros = 0;
+
+    if (isIntegerMode(radix)) {
+        precision = 0;
+    }
+
+    if (value->type == VALUE_SMALL || value->type == VALUE_RATIONAL) {
+        digWrite(f, (isIntegerMode(radix) ? toInteger(value) : toReal(value)), radix, precision, showProgress);
+        return;
+    }
+
+    if (value->type == VALUE_WORD || (value->type == VALUE_REAL && !mpfr_number_p(value->v))) {
+        fprintf(f, "%s\n", toString(value, radix, precision).c_str());
+        return;
+    }
+
+    mpz_init(z);
+
+    if (value->type == VALUE_INTEGER) {
+        mpz_set(z, value->z);
+        numZeros = (size_t)precision;
+    }
+    else if (isIntegerMode(radix)) {
+        mpfr_get_z(z, value->v, MPFR_RNDA);
+    }
+    else {
+        toScaledInteger(z, value->v, radix, precision);
+
+        numFractionDigits = (size_t)precision;
+        minDigits = (size_t)precision + 1;
+    }
+
+    if (radix == HEXADECIMAL) {
+        minDigits = HEX_MIN_DIGITS;
+    }
+
+    if (value->type == VALUE_REAL && !isIntegerMode(radix)) {
+        isNegative = mpfr_signbit(value->v);
+    }
+    else {
+        isNegative = (mpz_sgn(z) < 0);
+    }
+
+    if (isNegative) {
+        fputc('-', f);
+    }
+
+    mpz_abs(z, z);
+
+    _writeInteger(f, z, radix, minDigits, numFractionDigits, numZeros, showProgress);
+
+    fputc('\n', f);
+
+    mpz_clear(z);
+}
@@ -0,0 +1,27 @@
+#include <stdio.h>
+
+#include "system.h"
+
+#ifndef __INCL_DIGITS
+#define __INCL_DIGITS
+
+/*
+** Digits are converted and written this many at a time, whatever the
+** size of the number...
+*/
+#define DIGITS_CHUNK_SIZE                   65536UL
+
+/*
+** Results with more digits than this are written to stdout as they are
+** converted rather than being built up in memory...
+*/
+#define DIGITS_STREAM_MIN                   10000L
+
+/*
+** Progress is shown for results with at least this many digits...
+*/
+#define DIGITS_PROGRESS_MIN                 100000UL
+
+void        digWrite(FILE * f, const value_t & value, int radix, long precision, bool showProgress);
+
+#endif
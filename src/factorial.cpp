@@ -0,0 +1,204 @@
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "calc_error.h"
+#include "factorial.h"
+
+using namespace std;
+
+typedef struct _integer_t {
+    mpz_t           z;
+
+    _integer_t() {
+        mpz_init(z);
+    }
+
+    ~_integer_t() {
+        mpz_clear(z);
+    }
+}
+integer_t;
+
+/*
+** Every factorial worked out so far (from FACT_MIN_CACHED up), these
+** are the checkpoints the next one can start from...
+*/
+static map<unsigned long, shared_ptr<integer_t>>    cache;
+static size_t                                       cacheBits = 0;
+static mutex                                        cacheLock;
+
+/*
+** The product lo * (lo + 1) * ... * hi, split in half each time so the
+** multiplications are between numbers of a similar size...
+*/
+static void _product(mpz_t result, unsigned long lo, unsigned long hi) {
+    if (hi - lo < 16) {
+        mpz_set_ui(result, lo);
+
+        for (unsigned long i = lo + 1;i <= hi;i++) {
+            mpz_mul_ui(result, result, i);
+        }
+    }
+    else {
+        mpz_t           upper;
+        unsigned long   mid = lo + (hi - lo) / 2;
+
+        mpz_init(upper);
+
+        _product(result, lo, mid);
+        _product(upper, mid + 1, hi);
+
+        mpz_mul(result, result, upper);
+
+        mpz_clear(upper);
+    }
+}
+
+/*
+** The exact value of n!. If a factorial a little below n has already
+** been worked out, n! is that times the few numbers in between, otherwise
+** it comes from GMP's prime swing algorithm. Either way it is kept for
+** next time...
+*/
+void facExact(mpz_t result, unsigned long n) {
+    shared_ptr<integer_t>   checkpoint;
+    unsigned long           m = 0;
+
+    if (n < FACT_MIN_CACHED) {
+        mpz_fac_ui(result, n);
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(cacheLock);
+
+        auto c = cache.upper_bound(n);
+
+        if (c != cache.begin()) {
+            --c;
+
+            m = c->first;
+            checkpoint = c->second;
+        }
+    }
+
+    if (checkpoint && m == n) {
+        mpz_set(result, checkpoint->z);
+        return;
+    }
+
+    if (checkpoint && (n - m) * FACT_INCREMENT_RATIO <= n) {
+        _product(result, m + 1, n);
+        mpz_mul(result, result, checkpoint->z);
+    }
+    else {
+        mpz_fac_ui(result, n);
+    }
+
+    shared_ptr<integer_t> f = make_shared<integer_t>();
+
+    mpz_set(f->z, result);
+
+    lock_guard<mutex> lock(cacheLock);
+
+    if (cacheBits + mpz_sizeinbase(result, 2) > FACT_CACHE_MAX_BITS) {
+        cache.clear();
+        cacheBits = 0;
+    }
+
+    if (cache.emplace(n, f).second) {
+        cacheBits += mpz_sizeinbase(result, 2);
+    }
+}
+
+/*
+** x!, exact for the whole numbers while it is cheap and gamma(x + 1)
+** for everything else...
+*/
+void facFactorial(mpfr_t result, mpfr_t x) {
+    if (mpfr_integer_p(x)) {
+        if (mpfr_sgn(x) < 0) {
+            throw calc_error("The factorial of a negative whole number is undefined");
+        }
+
+        if (mpfr_fits_ulong_p(x, MPFR_RNDN)) {
+            unsigned long n = mpfr_get_ui(x, MPFR_RNDN);
+
+            /*
+            ** log2(n!) is about n * log2(n / e)...
+            */
+            double bits = (n > 2 ? (double)n * log2((double)n / M_E) : 1.0);
+
+            if (bits <= (double)(FACT_EXACT_RATIO * mpfr_get_prec(result))) {
+                mpz_t f;
+
+                mpz_init(f);
+
+                facExact(f, n);
+                mpfr_set_z(result, f, MPFR_RNDA);
+
+                mpz_clear(f);
+
+                return;
+            }
+        }
+    }
+
+    mpfr_add_ui(result, x, 1U, MPFR_RNDA);
+    mpfr_gamma(result, result, MPFR_RNDA);
+}
+
+/*
+** n choose k, exact when n and k are whole numbers and by way of the
+** gamma function when they are not...
+*/
+void facBinomial(mpfr_t result, mpfr_t n, mpfr_t k) {
+    if (mpfr_integer_p(n) && mpfr_integer_p(k)) {
+        if (mpfr_sgn(k) < 0) {
+            mpfr_set_zero(result, 1);
+            return;
+        }
+
+        if (!mpfr_fits_slong_p(n, MPFR_RNDN) || !mpfr_fits_ulong_p(k, MPFR_RNDN)) {
+            throw calc_error("Binomial arguments out of range");
+        }
+
+        mpz_t b;
+
+        mpz_init(b);
+
+        mpz_set_si(b, mpfr_get_si(n, MPFR_RNDN));
+        mpz_bin_ui(b, b, mpfr_get_ui(k, MPFR_RNDN));
+
+        mpfr_set_z(result, b, MPFR_RNDA);
+
+        mpz_clear(b);
+    }
+    else {
+        mpfr_t      t;
+
+        mpfr_init2(t, mpfr_get_prec(result));
+
+        mpfr_add_ui(t, n, 1U, MPFR_RNDA);
+        mpfr_gamma(result, t, MPFR_RNDA);
+
+        mpfr_add_ui(t, k, 1U, MPFR_RNDA);
+        mpfr_gamma(t, t, MPFR_RNDA);
+        mpfr_div(result, result, t, MPFR_RNDA);
+
+        mpfr_sub(t, n, k, MPFR_RNDA);
+        mpfr_add_ui(t, t, 1U, MPFR_RNDA);
+        mpfr_gamma(t, t, MPFR_RNDA);
+        mpfr_div(result, result, t, MPFR_RNDA);
+
+        mpfr_clear(t);
+    }
+}
@@ -0,0 +1,35 @@
+#include <gmp.h>
+#include <mpfr.h>
+
+#ifndef __INCL_FACTORIAL
+#define __INCL_FACTORIAL
+
+/*
+** Factorials below this are quicker to work out than to look up...
+*/
+#define FACT_MIN_CACHED                         256UL
+
+/*
+** n! is worked out from a cached m! when n - m is no more than n / 8,
+** otherwise from scratch...
+*/
+#define FACT_INCREMENT_RATIO                    8UL
+
+/*
+** The cache is emptied when the factorials in it grow beyond this many
+** bits (16MB)...
+*/
+#define FACT_CACHE_MAX_BITS                     (1UL << 27)
+
+/*
+** An exact factorial is only worth it when it is not much bigger than
+** the precision it is going to be rounded to, beyond that the gamma
+** function gets the same answer far quicker...
+*/
+#define FACT_EXACT_RATIO                        8
+
+void        facExact(mpz_t result, unsigned long n);
+void        facFactorial(mpfr_t result, mpfr_t x);
+void        facBinomial(mpfr_t result, mpfr_t n, mpfr_t k);
+
+#endif
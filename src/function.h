@@ -7,6 +7,9 @@
 #include "operator.h"
 #include "logger.h"
 #include "system.h"
+#include "factorial.h"
+#include "series.h"
+#include "word.h"
 
 using namespace std;
 
@@ -22,12 +25,36 @@ class Function {
             mpfr_init2(pi, getBasePrecision());
             mpfr_init2(one_eighty, getBasePrecision());
 
-            mpfr_const_pi(pi, MPFR_RNDA);
+            serPi(pi);
             mpfr_set_ui(one_eighty, 180U, MPFR_RNDA);
 
             mpfr_div(radians, pi, one_eighty, MPFR_RNDA);
 
             mpfr_mul(radians, radians, degrees, MPFR_RNDA);
+
+            mpfr_clear(pi);
+            mpfr_clear(one_eighty);
+        }
+
+        /*
+        ** The bit functions on integers of any width, only the ones that
+        ** do not depend on a word size make sense...
+        */
+        static value_t _evaluateBits(const string & f, const value_t & operand1) {
+            value_t     n = toInteger(operand1);
+            value_t     result = newInteger();
+
+            if (f.compare("popcount") == 0 && mpz_sgn(n->z) >= 0) {
+                mpz_set_ui(result->z, mpz_popcount(n->z));
+            }
+            else if (f.compare("ctz") == 0 && mpz_sgn(n->z) != 0) {
+                mpz_set_ui(result->z, mpz_scan1(n->z, 0));
+            }
+            else {
+                throw calc_error(calc_error::buildMsg("%s() needs a word size here, e.g. word32", f.c_str()));
+            }
+
+            return result;
         }
 
         static void _degrees(mpfr_t degrees, mpfr_t radians) {
@@ -37,26 +64,58 @@ class Function {
             mpfr_init2(pi, getBasePrecision());
             mpfr_init2(one_eighty, getBasePrecision());
 
-            mpfr_const_pi(pi, MPFR_RNDA);
+            serPi(pi);
             mpfr_set_ui(one_eighty, 180U, MPFR_RNDA);
             
             mpfr_div(degrees, one_eighty, pi, MPFR_RNDA);
 
             mpfr_mul(degrees, degrees, radians, MPFR_RNDA);
+
+            mpfr_clear(pi);
+            mpfr_clear(one_eighty);
         }
 
     public:
-        static string evaluate(string & f, int radix, string & operand1) {
-            mpfr_t          r;
-            mpfr_t          o1;
-            string          result;
+        static value_t evaluate(const string & f, int radix, const value_t & operand1) {
+            /*
+            ** A register is already a value, so recalling it is just
+            ** a matter of sharing it...
+            */
+            if (f.compare("mem") == 0) {
+                value_t n = toInteger(operand1);
 
-            lgLogDebug("Evaluating: %s(%s)", f.c_str(), operand1.c_str());
-            
-            mpfr_init2(o1, getBasePrecision());
-            mpfr_strtofr(o1, operand1.c_str(), NULL, radix, MPFR_RNDA);
+                return memRetrieve(mpz_fits_sint_p(n->z) ? (int)mpz_get_si(n->z) : -1);
+            }
+
+            lgLogDebug("Evaluating: function '%s'", f.c_str());
+
+            if (Word::isFunction(f)) {
+                if (isIntegerMode(radix) && getWordSize() > 0) {
+                    return Word::evaluateFunction(f, operand1, operand1);
+                }
+
+                return _evaluateBits(f, operand1);
+            }
+
+            /*
+            ** In the integer modes a factorial is exact however big...
+            */
+            if (isIntegerMode(radix) && f.compare("fact") == 0) {
+                value_t n = toInteger(operand1);
+
+                if (mpz_sgn(n->z) >= 0 && mpz_fits_ulong_p(n->z)) {
+                    value_t result = newInteger();
+
+                    facExact(result->z, mpz_get_ui(n->z));
+
+                    return (getWordSize() > 0 ? toWord(result) : result);
+                }
+            }
 
-            mpfr_init2(r, getBasePrecision());
+            value_t         x = toReal(operand1);
+            value_t         result = newValue();
+            mpfr_ptr        r = result->v;
+            mpfr_ptr        o1 = x->v;
 
             if (f.compare("sin") == 0) {
                 mpfr_sinu(r, o1, 360U, MPFR_RNDA);
@@ -104,7 +163,13 @@ class Function {
                 mpfr_log(r, o1, MPFR_RNDA);
             }
             else if (f.compare("fact") == 0) {
-                mpfr_fac_ui(r, mpfr_get_ui(o1, MPFR_RNDA), MPFR_RNDA);
+                facFactorial(r, o1);
+            }
+            else if (f.compare("gamma") == 0) {
+                mpfr_gamma(r, o1, MPFR_RNDA);
+            }
+            else if (f.compare("lngamma") == 0) {
+                mpfr_lngamma(r, o1, MPFR_RNDA);
             }
             else if (f.compare("rad") == 0) {
                 _radians(r, o1);
@@ -112,23 +177,67 @@ class Function {
             else if (f.compare("deg") == 0) {
                 _degrees(r, o1);
             }
-            else if (f.compare("mem") == 0) {
-                result.assign(memRetrieve(mpfr_get_ui(o1, MPFR_RNDA)));
 
-                mpfr_clear(r);
-                mpfr_clear(o1);
+            if (isIntegerMode(radix)) {
+                return (getWordSize() > 0 ? toWord(result) : toInteger(result));
+            }
+
+            return result;
+        }
 
-                return result;
+        /*
+        ** Functions of two arguments, e.g. binom(n, k)...
+        */
+        static value_t evaluate(const string & f, int radix, const value_t & operand1, const value_t & operand2) {
+            lgLogDebug("Evaluating: function '%s'", f.c_str());
+
+            if (Word::isFunction(f)) {
+                if (isIntegerMode(radix) && getWordSize() > 0) {
+                    return Word::evaluateFunction(f, operand1, operand2);
+                }
+
+                throw calc_error(calc_error::buildMsg("%s() needs a word size, e.g. word32", f.c_str()));
             }
 
-            result.assign(toString(r, radix, getBasePrecision()));
+            if (isIntegerMode(radix) && f.compare("binom") == 0) {
+                value_t n = toInteger(operand1);
+                value_t k = toInteger(operand2);
+
+                if (mpz_fits_slong_p(n->z) && mpz_sgn(k->z) >= 0 && mpz_fits_ulong_p(k->z)) {
+                    value_t result = newInteger();
 
-            mpfr_clear(r);
-            mpfr_clear(o1);
+                    mpz_bin_ui(result->z, n->z, mpz_get_ui(k->z));
+
+                    return (getWordSize() > 0 ? toWord(result) : result);
+                }
+            }
+
+            value_t         x = toReal(operand1);
+            value_t         y = toReal(operand2);
+            value_t         result = newValue();
+
+            if (f.compare("binom") == 0) {
+                facBinomial(result->v, x->v, y->v);
+            }
+
+            if (isIntegerMode(radix)) {
+                return (getWordSize() > 0 ? toWord(result) : toInteger(result));
+            }
 
             return result;
         }
 
+        static int getArity(const string & f) {
+            if (f.compare("binom") == 0) {
+                return 2;
+            }
+            else if (Word::isFunction(f)) {
+                return Word::getArity(f);
+            }
+
+            return 1;
+        }
+
         static int getPrescedence() {
             return 5;
         }
@@ -0,0 +1,231 @@
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "calc_error.h"
+#include "system.h"
+#include "threadpool.h"
+#include "calculator.h"
+#include "statistics.h"
+#include "loader.h"
+
+using namespace std;
+
+typedef struct {
+    const char *        start;
+    const char *        end;
+    stats_t             stats;
+    uint64_t            numSkipped;
+}
+chunk_t;
+
+static inline bool _isSeparator(char ch) {
+    return (ch == ',' || ch == ';' || ch == '\t' || ch == ' ' || ch == '\r');
+}
+
+/*
+** Fields are separated by a comma, semicolon or tab, or by spaces, and
+** any spaces around a field are ignored...
+*/
+static const char * _skipField(const char * p, const char * lineEnd) {
+    while (p < lineEnd && !_isSeparator(*p)) {
+        p++;
+    }
+    while (p < lineEnd && *p == ' ') {
+        p++;
+    }
+    if (p < lineEnd && (*p == ',' || *p == ';' || *p == '\t')) {
+        p++;
+    }
+    while (p < lineEnd && *p == ' ') {
+        p++;
+    }
+
+    return p;
+}
+
+/*
+** The field is copied to the stack before parsing, as mpfr_strtofr()
+** takes time proportional to the length of the whole string rather
+** than the number at its start...
+*/
+static bool _parseField(mpfr_t value, const char * field, const char * fieldEnd) {
+    char        szField[LOADER_MAX_FIELD_LENGTH];
+    char *      pszEnd;
+    size_t      length = fieldEnd - field;
+
+    if (length == 0 || length >= LOADER_MAX_FIELD_LENGTH) {
+        return false;
+    }
+
+    memcpy(szField, field, length);
+    szField[length] = 0;
+
+    mpfr_strtofr(value, szField, &pszEnd, BASE_10, MPFR_RNDN);
+
+    return (pszEnd == &szField[length]);
+}
+
+static void _parseChunk(chunk_t * chunk, int column) {
+    mpfr_t          value;
+    const char *    p = chunk->start;
+
+    mpfr_init2(value, getBasePrecision());
+
+    while (p < chunk->end) {
+        const char * lineEnd = (const char *)memchr(p, '\n', chunk->end - p);
+
+        if (lineEnd == NULL) {
+            lineEnd = chunk->end;
+        }
+
+        const char * field = p;
+
+        while (field < lineEnd && *field == ' ') {
+            field++;
+        }
+
+        for (int c = 1;c < column && field < lineEnd;c++) {
+            field = _skipField(field, lineEnd);
+        }
+
+        const char * fieldEnd = field;
+
+        while (fieldEnd < lineEnd && !_isSeparator(*fieldEnd)) {
+            fieldEnd++;
+        }
+
+        if (_parseField(value, field, fieldEnd)) {
+            statAdd(&chunk->stats, value);
+        }
+        else if (lineEnd > p && !(lineEnd - p == 1 && *p == '\r')) {
+            chunk->numSkipped++;
+        }
+
+        p = lineEnd + 1;
+    }
+
+    mpfr_clear(value);
+}
+
+/*
+** Add the numbers in the given column (from 1) of every line in the
+** file to the statistics. The file is mapped into memory and split at
+** line boundaries into a chunk per thread, each chunk is accumulated
+** separately and the results merged in file order. Lines without a
+** number in the column, e.g. a header, are skipped...
+*/
+uint64_t ldrLoad(stats_t * s, const char * pszFilename, int column, uint64_t * pNumSkipped) {
+    struct stat         st;
+    const char *        data;
+    const char *        fileEnd;
+    int                 fd;
+    uint64_t            numLoaded = 0;
+    size_t              numChunks;
+
+    *pNumSkipped = 0;
+
+    if (column < 1) {
+        throw calc_error("The column must be 1 or more");
+    }
+
+    fd = open(pszFilename, O_RDONLY);
+
+    if (fd < 0) {
+        throw calc_error(calc_error::buildMsg("Failed to open '%s': %s", pszFilename, strerror(errno)));
+    }
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw calc_error(calc_error::buildMsg("Failed to stat '%s': %s", pszFilename, strerror(errno)));
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    data = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        throw calc_error(calc_error::buildMsg("Failed to map '%s': %s", pszFilename, strerror(errno)));
+    }
+
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+    fileEnd = data + st.st_size;
+
+    numChunks = (size_t)st.st_size / LOADER_MIN_CHUNK_SIZE + 1;
+
+    if (numChunks > (size_t)ThreadPool::getDefaultSize()) {
+        numChunks = (size_t)ThreadPool::getDefaultSize();
+    }
+
+    vector<chunk_t> chunks(numChunks);
+
+    for (size_t i = 0;i < numChunks;i++) {
+        const char * start = data + (st.st_size * i) / numChunks;
+
+        /*
+        ** Each chunk after the first starts on a new line...
+        */
+        if (i > 0) {
+            const char * newline = (const char *)memchr(start, '\n', fileEnd - start);
+
+            start = (newline != NULL ? newline + 1 : fileEnd);
+        }
+
+        chunks[i].start = start;
+        chunks[i].numSkipped = 0;
+
+        if (i > 0) {
+            chunks[i - 1].end = start;
+        }
+
+        statInit(&chunks[i].stats);
+    }
+
+    chunks[numChunks - 1].end = fileEnd;
+
+    /*
+    ** On the shared pool, so a chunk that fails reaches the caller...
+    */
+    try {
+        runParallel(numChunks, [&](size_t i) {
+            _parseChunk(&chunks[i], column);
+        });
+    }
+    catch (...) {
+        for (chunk_t & chunk : chunks) {
+            statFree(&chunk.stats);
+        }
+
+        munmap((void *)data, st.st_size);
+        throw;
+    }
+
+    for (chunk_t & chunk : chunks) {
+        numLoaded += statCount(&chunk.stats);
+        *pNumSkipped += chunk.numSkipped;
+
+        statMerge(s, &chunk.stats);
+        statFree(&chunk.stats);
+    }
+
+    munmap((void *)data, st.st_size);
+
+    return numLoaded;
+}
@@ -0,0 +1,13 @@
+#include <stdint.h>
+
+#include "statistics.h"
+
+#ifndef __INCL_LOADER
+#define __INCL_LOADER
+
+#define LOADER_MIN_CHUNK_SIZE               (1UL << 20)
+#define LOADER_MAX_FIELD_LENGTH             128
+
+uint64_t        ldrLoad(stats_t * s, const char * pszFilename, int column, uint64_t * pNumSkipped);
+
+#endif
@@ -20,6 +20,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
 #include <vector>
 
 #include <gmp.h>
@@ -35,10 +38,31 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "utils.h"
 #include "system.h"
 #include "test.h"
+#include "statistics.h"
+#include "bivariate.h"
+#include "loader.h"
+#include "rolling.h"
+#include "digits.h"
+#include "quadrature.h"
+#include "solver.h"
+#include "derivative.h"
+#include "summation.h"
+#include "threadpool.h"
+#include "server.h"
+#include "client.h"
 #include "version.h"
 
 using namespace std;
 
+/*
+** Exit status for a one-shot calculation (-e)...
+*/
+#define EXIT_STATUS_OK                      0
+#define EXIT_STATUS_CALC_ERROR              1
+#define EXIT_STATUS_USAGE_ERROR             2
+
+#define HISTOGRAM_BAR_WIDTH                40
+
 const char * pszWarranty = 
     "This program comes with ABSOLUTELY NO WARRANTY.\n" \
     "This is free software, and you are welcome to redistribute it\n" \
@@ -86,40 +110,443 @@ static void printUsage(void) {
     printf("\tsqrt(x)\treturn the square root of x\n");
     printf("\tlog(x)\treturn the log of x\n");
     printf("\tln(x)\treturn the natural log of x\n");
-    printf("\tfact(x)\treturn the factorial of x\n");
+    printf("\tfact(x)\treturn the factorial of x (gamma(x + 1) if x is not a whole number)\n");
+    printf("\tgamma(x) return the gamma function of x\n");
+    printf("\tlngamma(x) return the natural log of the gamma function of x\n");
+    printf("\tbinom(n, k) return n choose k, the binomial coefficient\n");
+    printf("\tpopcount(x) return the number of bits set in x\n");
+    printf("\tclz(x)\treturn the number of leading zero bits in the word x\n");
+    printf("\tctz(x)\treturn the number of trailing zero bits in x\n");
+    printf("\trol(x, n) return the word x rotated left by n bits\n");
+    printf("\tror(x, n) return the word x rotated right by n bits\n");
+    printf("\tbswap(x) return the word x with its bytes reversed\n");
     printf("\trad(x)\tthe value in radians of x degrees\n");
     printf("\tdeg(x)\tthe value in degrees of x radians\n");
-    printf("\tmem(n)\tthe value in memory location n, where n is 0 - 9\n\n");
+    printf("\tmem(n)\tthe value in memory location n, where n is 0 - 9\n");
+    printf("\tname\tthe value in the register called name\n\n");
     printf("Constants supported:\n");
     printf("\tpi\tthe ratio pi\n");
     printf("\teu\tEulers constant\n");
     printf("\tg\tThe gravitational constant G\n");
     printf("\tc\tthe speed of light in a vacuum\n\n");
     printf("Commands supported:\n");
-    printf("\tmemstn\tStore the last result in memory location n (0 - 9)\n");
-    printf("\tmemclrn\tClear the memory location n (0 - 9)\n");
+    printf("\tmemstn\tStore the last result in memory location n (0 - 9 or a name)\n");
+    printf("\tmemclrn\tClear the memory location n (0 - 9 or a name)\n");
     printf("\tclrall\tClear all memory locations\n");
     printf("\tlistall\tList all memory locations\n");
     printf("\tdec\tSwitch to decimal mode\n");
     printf("\thex\tSwitch to hexadecimal mode\n");
     printf("\tbin\tSwitch to binary mode\n");
     printf("\toct\tSwitch to octal mode\n");
+    printf("\tbasen\tSwitch to base n (2 - 62), bases other than 2, 8 and 16 have fractions\n");
+    printf("\twordn\tUse n bit unsigned words in hex, bin and oct modes (8 - 128, 0 for any width)\n");
+    printf("\tswordn\tUse n bit signed words in hex, bin and oct modes\n");
     printf("\tstat\tSwitch to statistical mode\n");
     printf("\tsum\tStatistical sum function\n");
     printf("\tavg\tStatistical average function\n");
     printf("\tmin\tStatistical minimum function\n");
     printf("\tmax\tStatistical maximum function\n");
+    printf("\tcount\tNumber of values (and x,y pairs) stored for the statistic functions\n");
+    printf("\tvar\tStatistical sample variance function\n");
+    printf("\tstddev\tStatistical sample standard deviation function\n");
+    printf("\tcov\tSample covariance of the x,y pairs\n");
+    printf("\tcorr\tCorrelation coefficient of the x,y pairs\n");
+    printf("\tlinreg\tLeast squares line through the x,y pairs\n");
+    printf("\tprecon\tCalculate cov, corr and linreg at full precision\n");
+    printf("\tprecoff\tCalculate cov, corr and linreg in double precision (default)\n");
+    printf("\tmedian\tStatistical median function\n");
+    printf("\tpctn\tStatistical nth percentile function (0 - 100)\n");
+    printf("\tmode\tStatistical mode function\n");
+    printf("\thistn\tHistogram of the values in n bins (default 10)\n");
+    printf("\tload f c\tLoad the numbers in column c (default 1) of file f\n");
+    printf("\tsave f\tWrite the last result, with all its digits, to file f\n");
     printf("\tclrstat\tClear the statistic buffer of all values\n");
     printf("\tsetpn\tSet the precision to n\n");
+    printf("\tintegrate(f, x, a, b)\tThe integral of f from x = a to x = b\n");
+    printf("\tdiff(f, x, a, n)\tThe nth derivative (default 1) of f at x = a\n");
+    printf("\tgrad(f, x, y, a, b)\tThe partial derivatives of f at x = a, y = b, for any number of variables\n");
+    printf("\tsum(i, a, b, f)\tThe sum of f for i = a to b, b can be inf\n");
+    printf("\tprod(i, a, b, f)\tThe product of f for i = a to b, b can be inf\n");
+    printf("\tsolve(f, x, g)\tThe x near g where f is 0, or solve(f, x, a, b) for the x between a and b\n");
+    printf("\tmore n\tWork out the last calculation to n more digits (default: twice as many)\n");
     printf("\tfmton\tTurn on output formatting (on by default)\n");
     printf("\tfmtoff\tTurn off output formatting\n");
+    printf("\texacton\tKeep the numbers in a calculation as exact fractions through + - * / and ^\n");
+    printf("\texactoff\tWork with real numbers throughout (default)\n");
     printf("\thelp\tThis help text\n");
     printf("\ttest\tRun a self test of the calculator\n");
     printf("\tversion\tPrint the calculator version\n");
     printf("\texit\tExit the calculator\n\n");
 }
 
-static const char * getModeString(int mode) {
+static void printCmdLineUsage(void) {
+    printf("Usage: ccalc [options]\n\n");
+    printf("With no options, ccalc runs interactively.\n\n");
+    printf("Options:\n");
+    printf("\t-e <calculation>\tPrint the result of the calculation and exit\n");
+    printf("\t-p <digits>\t\tPrecision for -e, up to %d (default: %d)\n", MAX_PRECISION, DEFAULT_PRECISION);
+    printf("\t-o <file>\t\tWrite the result of -e to the file\n");
+    printf("\t--hex, --oct, --bin\tMode for -e (default: decimal)\n");
+    printf("\t--base <n>\t\tBase 2 - 62 for -e\n");
+    printf("\t--exact\t\t\tExact fractions for -e, as the exacton command\n");
+    printf("\t--serve <socket>\tServe calculations on the Unix domain socket\n");
+    printf("\t--workers <n>\t\tNumber of server worker threads (default: one per core)\n");
+    printf("\t--client <socket>\tSend each line of stdin to the server on the socket\n");
+    printf("\t--stream\t\tPrint rolling statistics of the numbers read from stdin\n");
+    printf("\t--window <n>\t\tNumber of samples in the rolling window (default: %d)\n", ROLLING_DEFAULT_WINDOW);
+    printf("\t--every <n>\t\tPrint the statistics every n samples (default: %d)\n", ROLLING_DEFAULT_INTERVAL);
+    printf("\t--alpha <a>\t\tSmoothing factor of the EMA (default: 2 / (window + 1))\n");
+    printf("\t--help\t\t\tThis help text\n\n");
+}
+
+/*
+** Calculations to many digits can take a while, so they say what they
+** are doing on stderr, leaving stdout for the result...
+*/
+static value_t runWithProgress(program_t * program, subtotals_t * subtotals) {
+    struct timespec     start;
+    struct timespec     end;
+
+    if ((unsigned long)getPrecision() < DIGITS_PROGRESS_MIN) {
+        return (subtotals != NULL ? refine(program, subtotals) : execute(program));
+    }
+
+    fprintf(
+        stderr,
+        "Calculating to %ld digits (%ld bits)...\n",
+        (long)getPrecision(),
+        (long)getBasePrecision());
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    value_t result = (subtotals != NULL ? refine(program, subtotals) : execute(program));
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    fprintf(
+        stderr,
+        "Calculated in %.3fs\n",
+        (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1.0e9);
+
+    return result;
+}
+
+static bool saveResult(const char * pszFilename, const value_t & result, int mode) {
+    FILE * f = fopen(pszFilename, "w");
+
+    if (f == NULL) {
+        fprintf(stderr, "Failed to open '%s': %s\n", pszFilename, strerror(errno));
+        return false;
+    }
+
+    digWrite(f, result, mode, (long)getPrecision(), true);
+
+    fclose(f);
+
+    return true;
+}
+
+/*
+** integrate(expression, variable, from, to), the expression is compiled
+** once and run for each point...
+*/
+static value_t integrate(const char * pszCommand, int mode, mpfr_t error) {
+    vector<string>      args;
+    program_t           program;
+
+    if (!Utils::splitCall(pszCommand, "integrate", args) || args.size() != 4 || !Utils::isVariable(args[1])) {
+        throw calc_error("Usage: integrate(expression, variable, from, to)");
+    }
+
+    if (isIntegerMode(mode)) {
+        throw calc_error("Integrals need a mode with fractions, e.g. dec");
+    }
+
+    compile(&program, args[0].c_str(), mode);
+
+    value_t a = toReal(evaluate(args[2].c_str(), mode));
+    value_t b = toReal(evaluate(args[3].c_str(), mode));
+    value_t result = newValue();
+
+    quadIntegrate(result->v, error, &program, args[1], a->v, b->v);
+
+    return result;
+}
+
+/*
+** solve(expression, variable, guess) or solve(expression, variable, from,
+** to), for the root near the guess or between the two...
+*/
+static value_t solve(const char * pszCommand, int mode, mpfr_t error) {
+    vector<string>      args;
+    program_t           program;
+
+    if (!Utils::splitCall(pszCommand, "solve", args) || args.size() < 3 || args.size() > 4 || !Utils::isVariable(args[1])) {
+        throw calc_error("Usage: solve(expression, variable, guess) or solve(expression, variable, from, to)");
+    }
+
+    if (isIntegerMode(mode)) {
+        throw calc_error("Roots need a mode with fractions, e.g. dec");
+    }
+
+    compile(&program, args[0].c_str(), mode);
+
+    value_t a = toReal(evaluate(args[2].c_str(), mode));
+    value_t b = (args.size() == 4 ? toReal(evaluate(args[3].c_str(), mode)) : value_t());
+    value_t result = newValue();
+
+    solFindRoot(result->v, error, &program, args[1], a->v, (b ? b->v : NULL));
+
+    return result;
+}
+
+/*
+** diff(expression, variable, at) or diff(expression, variable, at, order),
+** the derivative is the Taylor coefficient times order!...
+*/
+static value_t differentiate(const char * pszCommand, int mode) {
+    vector<string>      args;
+    vector<value_t>     coefficients;
+    program_t           program;
+    long                order = 1;
+
+    if (!Utils::splitCall(pszCommand, "diff", args) || args.size() < 3 || args.size() > 4 || !Utils::isVariable(args[1])) {
+        throw calc_error("Usage: diff(expression, variable, at) or diff(expression, variable, at, order)");
+    }
+
+    if (isIntegerMode(mode)) {
+        throw calc_error("Derivatives need a mode with fractions, e.g. dec");
+    }
+
+    compile(&program, args[0].c_str(), mode);
+
+    value_t at = toReal(evaluate(args[2].c_str(), mode));
+
+    if (args.size() == 4) {
+        value_t n = toInteger(evaluate(args[3].c_str(), mode));
+
+        if (!mpz_fits_slong_p(n->z) || mpz_sgn(n->z) < 0 || mpz_cmp_si(n->z, DERIVATIVE_MAX_ORDER) > 0) {
+            throw calc_error(calc_error::buildMsg("The order of a derivative must be between 0 and %d", DERIVATIVE_MAX_ORDER));
+        }
+
+        order = mpz_get_si(n->z);
+    }
+
+    derTaylor(coefficients, (int)order, &program, args[1], at->v);
+
+    value_t result = newValue();
+
+    mpfr_fac_ui(result->v, (unsigned long)order, MPFR_RNDN);
+    mpfr_mul(result->v, result->v, coefficients[order]->v, MPFR_RNDN);
+
+    return result;
+}
+
+/*
+** grad(expression, x, y, ..., a, b, ...), the partial derivatives with
+** respect to x, y, ... at x = a, y = b, ...
+*/
+static void gradient(const char * pszCommand, int mode, vector<string> & variables, vector<value_t> & partials) {
+    vector<string>      args;
+    vector<value_t>     at;
+    program_t           program;
+
+    if (!Utils::splitCall(pszCommand, "grad", args) || args.size() < 3 || args.size() % 2 == 0) {
+        throw calc_error("Usage: grad(expression, x, y, ..., x value, y value, ...)");
+    }
+
+    size_t n = (args.size() - 1) / 2;
+
+    variables.assign(args.begin() + 1, args.begin() + 1 + n);
+
+    for (const string & v : variables) {
+        if (!Utils::isVariable(v)) {
+            throw calc_error("Usage: grad(expression, x, y, ..., x value, y value, ...)");
+        }
+    }
+
+    if (isIntegerMode(mode)) {
+        throw calc_error("Derivatives need a mode with fractions, e.g. dec");
+    }
+
+    compile(&program, args[0].c_str(), mode);
+
+    for (size_t i = 0;i < n;i++) {
+        at.push_back(toReal(evaluate(args[1 + n + i].c_str(), mode)));
+    }
+
+    derGradient(partials, &program, variables, at);
+}
+
+/*
+** Only sum( and prod( are series, sum on its own is the statistic. A
+** sum that is only part of a calculation is worked out with the rest of
+** it, without its error...
+*/
+static bool isSeries(const char * pszCommand) {
+    vector<string>      args;
+
+    return (Utils::splitCall(pszCommand, "sum", args) || Utils::splitCall(pszCommand, "prod", args));
+}
+
+static long evaluateLimit(const string & limit, int mode) {
+    value_t n = toInteger(evaluate(limit.c_str(), mode));
+
+    if (!mpz_fits_slong_p(n->z)) {
+        throw calc_error("The limits of a sum or product must be whole numbers of up to 64 bits");
+    }
+
+    return mpz_get_si(n->z);
+}
+
+/*
+** sum(index, from, to, expression) or prod(...), to can be inf. The error
+** is only set, and hasError true, for an infinite series...
+*/
+static value_t series(const char * pszCommand, int mode, mpfr_t error, bool * hasError) {
+    vector<string>      args;
+    program_t           program;
+    bool                isProduct = (strncmp(pszCommand, "prod", 4) == 0);
+
+    if (!Utils::splitCall(pszCommand, (isProduct ? "prod" : "sum"), args) || args.size() != 4 || !Utils::isVariable(args[0])) {
+        throw calc_error("Usage: sum(index, from, to, expression) or prod(index, from, to, expression), to can be inf");
+    }
+
+    compile(&program, args[3].c_str(), mode);
+
+    long lo = evaluateLimit(args[1], mode);
+    string hi = args[2];
+
+    *hasError = (Utils::lowercase(hi).compare("inf") == 0);
+
+    if (!*hasError) {
+        return sumFinite(&program, args[0], lo, evaluateLimit(args[2], mode), isProduct);
+    }
+
+    if (isIntegerMode(mode)) {
+        throw calc_error("Infinite series need a mode with fractions, e.g. dec");
+    }
+
+    value_t result = newValue();
+
+    sumInfinite(result->v, error, &program, args[0], lo, isProduct);
+
+    return result;
+}
+
+/*
+** Scripts call this thousands of times, so it does nothing but the
+** calculation: no readline, no banner and no logging...
+*/
+static int evaluateOnce(const char * pszExpression, int mode, long precision, const char * pszOutputFile) {
+    int         status = EXIT_STATUS_OK;
+    mpfr_t      error;
+    bool        hasError = false;
+
+    setPrecision(precision);
+
+    mpfr_init2(error, getBasePrecision());
+
+    try {
+        program_t   program;
+        value_t     result;
+
+        if (strncmp(pszExpression, "integrate", 9) == 0) {
+            result = integrate(pszExpression, mode, error);
+            hasError = true;
+        }
+        else if (strncmp(pszExpression, "solve", 5) == 0) {
+            result = solve(pszExpression, mode, error);
+            hasError = true;
+        }
+        else if (isSeries(pszExpression)) {
+            result = series(pszExpression, mode, error, &hasError);
+        }
+        else if (strncmp(pszExpression, "diff", 4) == 0) {
+            result = differentiate(pszExpression, mode);
+        }
+        else if (strncmp(pszExpression, "grad", 4) == 0) {
+            vector<string>      variables;
+            vector<value_t>     partials;
+
+            gradient(pszExpression, mode, variables, partials);
+
+            /*
+            ** All but the last are printed here, the last is the result...
+            */
+            for (size_t i = 0;i + 1 < partials.size();i++) {
+                printf("%s\n", toString(partials[i], mode, precision).c_str());
+            }
+
+            result = partials.back();
+        }
+        else {
+            compile(&program, pszExpression, mode);
+
+            result = runWithProgress(&program, NULL);
+        }
+
+        if (pszOutputFile != NULL) {
+            if (!saveResult(pszOutputFile, result, mode)) {
+                status = EXIT_STATUS_USAGE_ERROR;
+            }
+        }
+        else if (precision > DIGITS_STREAM_MIN) {
+            digWrite(stdout, result, mode, precision, true);
+        }
+        else {
+            printf("%s\n", toString(result, mode, (isIntegerMode(mode) ? 0L : precision)).c_str());
+        }
+
+        /*
+        ** The estimate goes to stderr, so the result can still be piped...
+        */
+        if (hasError) {
+            fflush(stdout);
+            mpfr_fprintf(stderr, "error estimate %.1Re\n", error);
+        }
+    }
+    catch (calc_error & e) {
+        fprintf(stderr, "Calculation failed for %s: %s\n", pszExpression, e.what());
+        status = EXIT_STATUS_CALC_ERROR;
+    }
+
+    mpfr_clear(error);
+
+    return status;
+}
+
+/*
+** The error is printed under the result if there is an estimate of it...
+*/
+static void printResult(string & answer, const char * pszExpression, const value_t & result, int mode, bool doFormat, mpfr_t error = NULL) {
+    if (getPrecision() > DIGITS_STREAM_MIN) {
+        printf("\n%s\n        = ", pszExpression);
+        digWrite(stdout, result, mode, (long)getPrecision(), true);
+    }
+    else {
+        answer.clear();
+        appendString(answer, result, mode, (long)getPrecision(), doFormat);
+
+        printf("\n%s\n        = %s\n", pszExpression, answer.c_str());
+    }
+
+    if (error != NULL) {
+        mpfr_printf("        error estimate %.1Re\n", error);
+    }
+
+    printf("\n");
+}
+
+static void printStatistic(const char * pszName, mpfr_t value, bool doFormat) {
+    string answer;
+
+    appendString(answer, value, DECIMAL, (long)getPrecision(), doFormat);
+
+    printf("%s = %s\n", pszName, answer.c_str());
+}
+
+static string getModeString(int mode) {
     switch (mode) {
         case DECIMAL:
             return "DEC";
@@ -137,7 +564,7 @@ static const char * getModeString(int mode) {
             return "STAT";
 
         default:
-            return "CUS";
+            return "B" + to_string(mode);
     }
 }
 
@@ -148,18 +575,131 @@ int main(int argc, char ** argv) {
     int                 mode = DECIMAL;
     bool                doFormat = true;
     long                precision;
-    mpfr_t              result;
+    value_t             result = newValue();
     string              answer;
-    vector<string>      stats;
+    program_t           lastProgram;
+    subtotals_t         lastSubtotals = { vector<value_t>(), 0 };
+    string              lastExpression;
+    bool                hasLast = false;
+    stats_t             stats;
+    mpfr_t              statValue;
+    bool                isStatPrecise = false;
+    const char *        pszServerSocket = NULL;
+    const char *        pszClientSocket = NULL;
+    const char *        pszExpression = NULL;
+    const char *        pszOutputFile = NULL;
+    int                 numWorkers = ThreadPool::getDefaultSize();
+    bool                isStream = false;
+    long                window = ROLLING_DEFAULT_WINDOW;
+    long                interval = ROLLING_DEFAULT_INTERVAL;
+    double              alpha = 0.0;
+
+    precision = DEFAULT_PRECISION;
+
+    for (int i = 1;i < argc;i++) {
+        if (strcmp(argv[i], "-e") == 0 && i < argc - 1) {
+            pszExpression = argv[++i];
+        }
+        else if (strcmp(argv[i], "-p") == 0 && i < argc - 1) {
+            char * pszEnd;
+
+            precision = strtol(argv[++i], &pszEnd, BASE_10);
+
+            if (*pszEnd != 0 || precision < 0 || precision > MAX_PRECISION) {
+                fprintf(stderr, "Precision must be between 0 and %d\n", MAX_PRECISION);
+                return EXIT_STATUS_USAGE_ERROR;
+            }
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i < argc - 1) {
+            pszOutputFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--hex") == 0) {
+            mode = HEXADECIMAL;
+        }
+        else if (strcmp(argv[i], "--oct") == 0) {
+            mode = OCTAL;
+        }
+        else if (strcmp(argv[i], "--bin") == 0) {
+            mode = BINARY;
+        }
+        else if (strcmp(argv[i], "--exact") == 0) {
+            setExact(true);
+        }
+        else if (strcmp(argv[i], "--base") == 0 && i < argc - 1) {
+            try {
+                mode = parseRadix(argv[++i]);
+            }
+            catch (calc_error & e) {
+                fprintf(stderr, "%s\n", e.what());
+                return EXIT_STATUS_USAGE_ERROR;
+            }
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i < argc - 1) {
+            pszServerSocket = argv[++i];
+        }
+        else if (strcmp(argv[i], "--client") == 0 && i < argc - 1) {
+            pszClientSocket = argv[++i];
+        }
+        else if (strcmp(argv[i], "--workers") == 0 && i < argc - 1) {
+            numWorkers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--stream") == 0) {
+            isStream = true;
+        }
+        else if (strcmp(argv[i], "--window") == 0 && i < argc - 1) {
+            window = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--every") == 0 && i < argc - 1) {
+            interval = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--alpha") == 0 && i < argc - 1) {
+            alpha = strtod(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--help") == 0) {
+            printCmdLineUsage();
+            return 0;
+        }
+        else {
+            fprintf(stderr, "Unrecognised option '%s'\n\n", argv[i]);
+            printCmdLineUsage();
+            return EXIT_STATUS_USAGE_ERROR;
+        }
+    }
+
+    if (pszExpression != NULL) {
+        return evaluateOnce(pszExpression, mode, precision, pszOutputFile);
+    }
+
+    if (pszClientSocket != NULL) {
+        return cliRun(pszClientSocket);
+    }
+
+    if (isStream) {
+        if (window < 1 || interval < 1 || alpha < 0.0 || alpha > 1.0) {
+            fprintf(stderr, "The window and interval must be at least 1 and alpha between 0 and 1\n");
+            return EXIT_STATUS_USAGE_ERROR;
+        }
+
+        return rolRun(stdin, (size_t)window, alpha, (uint64_t)interval);
+    }
+
+    if (pszServerSocket != NULL) {
+        lgOpenStdout("LOG_LEVEL_ALL");
+        lgSetLogLevel(DEFAULT_LOG_LEVEL | LOG_LEVEL_INFO);
+
+        return srvRun(pszServerSocket, numWorkers);
+    }
 
     rl_bind_key('\t', rl_complete);
 
     using_history();
 
-    mpfr_init2(result, getBasePrecision());
-    mpfr_set_d(result, 0.0, MPFR_RNDA);
+    mpfr_set_zero(result->v, 1);
+
+    mpfr_init2(statValue, getBasePrecision());
+    statInit(&stats);
 
-    memInit();
+    sysInitState(sysGetState());
     setPrecision(DEFAULT_PRECISION);
 
     lgOpenStdout("LOG_LEVEL_ALL");
@@ -168,7 +708,12 @@ int main(int argc, char ** argv) {
     printBanner();
 
     while (loop) {
-        snprintf(szPrompt, 32, "calc [%s]> ", getModeString(mode));
+        if (isIntegerMode(mode) && getWordSize() > 0) {
+            snprintf(szPrompt, 32, "calc [%s %c%d]> ", getModeString(mode).c_str(), (getWordSigned() ? 's' : 'u'), getWordSize());
+        }
+        else {
+            snprintf(szPrompt, 32, "calc [%s]> ", getModeString(mode).c_str());
+        }
 
         pszCommand = readline(szPrompt);
 
@@ -178,20 +723,20 @@ int main(int argc, char ** argv) {
             if (strncmp(pszCommand, "exit", 4) == 0 || strncmp(pszCommand, "quit", 4) == 0 || pszCommand[0] == 'q') {
                 loop = false;
             }
-            else if (strncmp(pszCommand, "help", 4) == 0) {
+            else if (Utils::isCommand(pszCommand, "help")) {
                 printUsage();
             }
-            else if (strncmp(pszCommand, "version", 7) == 0) {
+            else if (Utils::isCommand(pszCommand, "version")) {
                 printVersion();
             }
-            else if (strncmp(pszCommand, "test", 4) == 0) {
+            else if (Utils::isCommand(pszCommand, "test")) {
                 int numTestsFailed = test();
 
                 if (numTestsFailed) {
                     fprintf(stderr, "Self-test failed with %d failures\n\n", numTestsFailed);
                 }
             }
-            else if (strncmp(pszCommand, "setp", 4) == 0) {
+            else if (Utils::isCommand(pszCommand, "setp")) {
                 precision = strtol(&pszCommand[4], NULL, BASE_10);
 
                 if (precision < 0 || precision > MAX_PRECISION) {
@@ -201,266 +746,543 @@ int main(int argc, char ** argv) {
                     setPrecision(precision);
                 }
             }
-            else if (strncmp(pszCommand, "dbgon", 5) == 0) {
+            else if (Utils::isCommand(pszCommand, "dbgon")) {
                 lgSetLogLevel(LOG_LEVEL_ALL);
             }
-            else if (strncmp(pszCommand, "dbgoff", 6) == 0) {
+            else if (Utils::isCommand(pszCommand, "dbgoff")) {
                 lgSetLogLevel(DEFAULT_LOG_LEVEL);
             }
-            else if (strncmp(pszCommand, "staon", 5) == 0) {
+            else if (Utils::isCommand(pszCommand, "staon")) {
                 lgSetLogLevel(DEFAULT_LOG_LEVEL | LOG_LEVEL_STATUS);
             }
-            else if (strncmp(pszCommand, "staoff", 6) == 0) {
+            else if (Utils::isCommand(pszCommand, "staoff")) {
                 lgSetLogLevel(DEFAULT_LOG_LEVEL);
             }
-            else if (strncmp(pszCommand, "fmton", 5) == 0) {
+            else if (Utils::isCommand(pszCommand, "fmton")) {
                 doFormat = true;
             }
-            else if (strncmp(pszCommand, "fmtoff", 6) == 0) {
+            else if (Utils::isCommand(pszCommand, "fmtoff")) {
                 doFormat = false;
             }
-            else if (strncmp(pszCommand, "memst", 5) == 0) {
-                int m = atoi(&pszCommand[5]);
+            else if (Utils::isCommand(pszCommand, "exacton")) {
+                setExact(true);
+                hasLast = false;
+            }
+            else if (Utils::isCommand(pszCommand, "exactoff")) {
+                setExact(false);
+                hasLast = false;
+            }
+            else if (Utils::isCommand(pszCommand, "more")) {
+                long digits = strtol(&pszCommand[4], NULL, BASE_10);
+
+                if (!hasLast) {
+                    fprintf(stderr, "There is no calculation to work out to more digits\n");
+                }
+                else {
+                    /*
+                    ** Twice the digits unless told how many more...
+                    */
+                    if (digits <= 0) {
+                        digits = max((long)getPrecision(), (long)DEFAULT_PRECISION);
+                    }
+
+                    setPrecision(min((long)getPrecision() + digits, (long)MAX_PRECISION));
 
-                memStore(toString(result, mode, (long)getPrecision()), m);
+                    try {
+                        result = runWithProgress(&lastProgram, &lastSubtotals);
+
+                        printResult(answer, lastExpression.c_str(), result, mode, doFormat);
+                    }
+                    catch (calc_error & e) {
+                        printf("Calculation failed for %s: %s\n", lastExpression.c_str(), e.what());
+                    }
+                }
             }
-            else if (strncmp(pszCommand, "memclr", 6) == 0) {
-                int m = atoi(&pszCommand[6]);
+            else if (strncmp(pszCommand, "integrate", 9) == 0) {
+                mpfr_t      error;
+
+                mpfr_init2(error, getBasePrecision());
+
+                try {
+                    result = integrate(pszCommand, mode, error);
+
+                    printResult(answer, pszCommand, result, mode, doFormat, error);
+                }
+                catch (calc_error & e) {
+                    printf("Calculation failed for %s: %s\n", pszCommand, e.what());
+                }
 
-                memClear(m);
+                mpfr_clear(error);
             }
-            else if (strncmp(pszCommand, "clrall", 6) == 0) {
-                for (int m = 0;m < NUM_MEMORY_LOCATIONS;m++) {
-                    memClear(m);
+            else if (isSeries(pszCommand)) {
+                mpfr_t      error;
+                bool        hasError;
+
+                mpfr_init2(error, getBasePrecision());
+
+                try {
+                    result = series(pszCommand, mode, error, &hasError);
+
+                    printResult(answer, pszCommand, result, mode, doFormat, (hasError ? error : NULL));
+                }
+                catch (calc_error & e) {
+                    printf("Calculation failed for %s: %s\n", pszCommand, e.what());
                 }
+
+                mpfr_clear(error);
             }
-            else if (strncmp(pszCommand, "listall", 7) == 0) {
-                for (int m = 0;m < NUM_MEMORY_LOCATIONS;m++) {
-                    printf("\tmem %d -> %s\n", m, memRetrieve(m).c_str());
+            else if (strncmp(pszCommand, "diff", 4) == 0) {
+                try {
+                    result = differentiate(pszCommand, mode);
+
+                    printResult(answer, pszCommand, result, mode, doFormat);
+                }
+                catch (calc_error & e) {
+                    printf("Calculation failed for %s: %s\n", pszCommand, e.what());
                 }
             }
-            else if (strncmp(pszCommand, "dec", 3) == 0) {
-                mode = DECIMAL;
-                
-                if (doFormat) {
-                    answer.assign(toFormattedString(result, mode, (long)getPrecision()));
+            else if (strncmp(pszCommand, "grad", 4) == 0) {
+                vector<string>      variables;
+                vector<value_t>     partials;
+
+                try {
+                    gradient(pszCommand, mode, variables, partials);
+
+                    for (size_t i = 0;i < partials.size();i++) {
+                        string name = "d/d" + variables[i];
+
+                        printResult(answer, name.c_str(), partials[i], mode, doFormat);
+                    }
+
+                    result = partials.back();
                 }
-                else {
-                    answer.assign(toString(result, mode, (long)getPrecision()));
+                catch (calc_error & e) {
+                    printf("Calculation failed for %s: %s\n", pszCommand, e.what());
                 }
+            }
+            else if (strncmp(pszCommand, "solve", 5) == 0) {
+                mpfr_t      error;
 
-                printf("= %s\n", answer.c_str());
+                mpfr_init2(error, getBasePrecision());
+
+                try {
+                    result = solve(pszCommand, mode, error);
+
+                    printResult(answer, pszCommand, result, mode, doFormat, error);
+                }
+                catch (calc_error & e) {
+                    printf("Calculation failed for %s: %s\n", pszCommand, e.what());
+                }
+
+                mpfr_clear(error);
             }
-            else if (strncmp(pszCommand, "hex", 3) == 0) {
-                mode = HEXADECIMAL;
+            else if (Utils::isCommand(pszCommand, "memst")) {
+                hasLast = false;
 
-                if (doFormat) {
-                    answer.assign(toFormattedString(result, mode, 0L));
+                try {
+                    memStore(result, &pszCommand[5]);
                 }
-                else {
-                    answer.assign(toString(result, mode, 0L));
+                catch (calc_error & e) {
+                    fprintf(stderr, "%s\n", e.what());
                 }
+            }
+            else if (Utils::isCommand(pszCommand, "memclr")) {
+                hasLast = false;
 
-                printf("= %s\n", answer.c_str());
+                try {
+                    memClear(&pszCommand[6]);
+                }
+                catch (calc_error & e) {
+                    fprintf(stderr, "%s\n", e.what());
+                }
             }
-            else if (strncmp(pszCommand, "bin", 3) == 0) {
-                mode = BINARY;
+            else if (Utils::isCommand(pszCommand, "save")) {
+                char        szFilename[PATH_MAX];
 
-                if (doFormat) {
-                    answer.assign(toFormattedString(result, mode, 0L));
+                if (sscanf(&pszCommand[4], " %4095s", szFilename) < 1) {
+                    fprintf(stderr, "Usage: save <file>\n");
                 }
                 else {
-                    answer.assign(toString(result, mode, 0L));
+                    saveResult(szFilename, result, mode);
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "clrall")) {
+                memInit();
+                hasLast = false;
+            }
+            else if (Utils::isCommand(pszCommand, "listall")) {
+                for (int m = 0;m < NUM_MEMORY_LOCATIONS;m++) {
+                    printf("\tmem %d -> %s\n", m, toString(memRetrieve(m), mode, (long)getPrecision()).c_str());
                 }
 
+                for (auto & r : memRegisters()) {
+                    printf("\t%s -> %s\n", r.first.c_str(), toString(r.second, mode, (long)getPrecision()).c_str());
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "dec")) {
+                mode = DECIMAL;
+                hasLast = false;
+                
+                answer.clear();
+                appendString(answer, result, mode, (long)getPrecision(), doFormat);
+
                 printf("= %s\n", answer.c_str());
             }
-            else if (strncmp(pszCommand, "oct", 3) == 0) {
-                mode = OCTAL;
+            else if (Utils::isCommand(pszCommand, "word") || Utils::isCommand(pszCommand, "sword")) {
+                bool isSigned = (pszCommand[0] == 's');
+
+                hasLast = false;
 
-                if (doFormat) {
-                    answer.assign(toFormattedString(result, mode, 0L));
+                try {
+                    setWordSize(atoi(&pszCommand[isSigned ? 5 : 4]), isSigned);
                 }
-                else {
-                    answer.assign(toString(result, mode, 0L));
+                catch (calc_error & e) {
+                    fprintf(stderr, "%s\n", e.what());
                 }
+            }
+            else if (Utils::isCommand(pszCommand, "hex")) {
+                mode = HEXADECIMAL;
+                hasLast = false;
+
+                answer.clear();
+                appendString(answer, result, mode, 0L, doFormat);
 
                 printf("= %s\n", answer.c_str());
             }
-            else if (strncmp(pszCommand, "stat", 4) == 0) {
-                mode = STATISTIC;
-            }
-            else if (strncmp(pszCommand, "sum", 3) == 0) {
-                if (mode == STATISTIC) {
-                    if (stats.size() > 0) {
-                        string addition(stats[0] + " + ");
+            else if (Utils::isCommand(pszCommand, "bin")) {
+                mode = BINARY;
+                hasLast = false;
 
-                        for (uint32_t s = 1;s < (uint32_t)stats.size();s++) {
-                            addition.append(stats[s]);
+                answer.clear();
+                appendString(answer, result, mode, 0L, doFormat);
 
-                            if (s < stats.size() - 1) {
-                                addition.append(" + ");
-                            }
-                        }
+                printf("= %s\n", answer.c_str());
+            }
+            else if (Utils::isCommand(pszCommand, "base")) {
+                try {
+                    mode = parseRadix(&pszCommand[4]);
+                    hasLast = false;
 
-                        evaluate(result, addition.c_str(), DECIMAL);
+                    answer.clear();
+                    appendString(answer, result, mode, (long)getPrecision(), doFormat);
 
-                        if (doFormat) {
-                            answer.assign(toFormattedString(result, DECIMAL, (long)getPrecision()));
-                        }
-                        else {
-                            answer.assign(toString(result, DECIMAL, (long)getPrecision()));
-                        }
+                    printf("= %s\n", answer.c_str());
+                }
+                catch (calc_error & e) {
+                    fprintf(stderr, "%s\n", e.what());
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "oct")) {
+                mode = OCTAL;
+                hasLast = false;
+
+                answer.clear();
+                appendString(answer, result, mode, 0L, doFormat);
 
-                        printf("SUM = %s\n", answer.c_str());
+                printf("= %s\n", answer.c_str());
+            }
+            else if (Utils::isCommand(pszCommand, "stat")) {
+                mode = STATISTIC;
+            }
+            else if (Utils::isCommand(pszCommand, "sum")) {
+                if (mode == STATISTIC) {
+                    try {
+                        statSum(statValue, &stats);
+                        printStatistic("SUM", statValue, doFormat);
                     }
-                    else {
-                        fprintf(stderr, "No data stored for statistic function\n");
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
                     }
                 }
                 else {
                     fprintf(stderr, "Must be in STAT mode to use the SUM command\n");
                 }
             }
-            else if (strncmp(pszCommand, "avg", 3) == 0) {
+            else if (Utils::isCommand(pszCommand, "avg")) {
+                if (mode == STATISTIC) {
+                    try {
+                        statMean(statValue, &stats);
+                        printStatistic("AVG", statValue, doFormat);
+                    }
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
+                    }
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the AVG command\n");
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "min")) {
+                if (mode == STATISTIC) {
+                    try {
+                        statMin(statValue, &stats);
+                        printStatistic("MIN", statValue, doFormat);
+                    }
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
+                    }
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the MIN command\n");
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "max")) {
                 if (mode == STATISTIC) {
-                    if (stats.size() > 0) {
-                        char    szCount[40];
-                        string  average("(" + stats[0] + " + ");
+                    try {
+                        statMax(statValue, &stats);
+                        printStatistic("MAX", statValue, doFormat);
+                    }
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
+                    }
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the MAX command\n");
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "count")) {
+                if (mode == STATISTIC) {
+                    printf("COUNT = %lu\n", (unsigned long)statCount(&stats));
 
-                        for (uint32_t s = 1;s < (uint32_t)stats.size();s++) {
-                            average.append(stats[s]);
+                    if (statPairCount(&stats) > 0) {
+                        printf("PAIRS = %lu\n", (unsigned long)statPairCount(&stats));
+                    }
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the COUNT command\n");
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "var")) {
+                if (mode == STATISTIC) {
+                    try {
+                        statVariance(statValue, &stats);
+                        printStatistic("VAR", statValue, doFormat);
+                    }
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
+                    }
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the VAR command\n");
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "stddev")) {
+                if (mode == STATISTIC) {
+                    try {
+                        statStdDev(statValue, &stats);
+                        printStatistic("STDDEV", statValue, doFormat);
+                    }
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
+                    }
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the STDDEV command\n");
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "cov") || Utils::isCommand(pszCommand, "corr") || Utils::isCommand(pszCommand, "linreg")) {
+                if (mode == STATISTIC) {
+                    comoments_t     moments;
 
-                            if (s < stats.size() - 1) {
-                                average.append(" + ");
-                            }
-                        }
+                    bivInit(&moments);
 
-                        snprintf(szCount, 40, "%lu", stats.size());
-                        average.append(") / ");
-                        average.append(szCount);
+                    try {
+                        bivCompute(&moments, &stats, isStatPrecise);
 
-                        evaluate(result, average.c_str(), DECIMAL);
+                        if (pszCommand[0] == 'l') {
+                            mpfr_t intercept;
 
-                        if (doFormat) {
-                            answer.assign(toFormattedString(result, DECIMAL, (long)getPrecision()));
+                            mpfr_init2(intercept, getBasePrecision());
+
+                            bivRegression(statValue, intercept, &moments);
+
+                            printStatistic("SLOPE", statValue, doFormat);
+                            printStatistic("INTERCEPT", intercept, doFormat);
+
+                            mpfr_clear(intercept);
+                        }
+                        else if (pszCommand[2] == 'r') {
+                            bivCorrelation(statValue, &moments);
+                            printStatistic("CORR", statValue, doFormat);
                         }
                         else {
-                            answer.assign(toString(result, DECIMAL, (long)getPrecision()));
+                            bivCovariance(statValue, &moments);
+                            printStatistic("COV", statValue, doFormat);
                         }
+                    }
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
+                    }
 
-                        printf("AVG = %s\n", answer.c_str());
+                    bivFree(&moments);
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the %s command\n", pszCommand);
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "precon")) {
+                isStatPrecise = true;
+            }
+            else if (Utils::isCommand(pszCommand, "precoff")) {
+                isStatPrecise = false;
+            }
+            else if (Utils::isCommand(pszCommand, "median")) {
+                if (mode == STATISTIC) {
+                    try {
+                        statQuantile(statValue, &stats, 0.5);
+                        printStatistic(statIsExact(&stats) ? "MEDIAN" : "MEDIAN (approx)", statValue, doFormat);
                     }
-                    else {
-                        fprintf(stderr, "No data stored for statistic function\n");
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
                     }
                 }
                 else {
-                    fprintf(stderr, "Must be in STAT mode to use the AVG command\n");
+                    fprintf(stderr, "Must be in STAT mode to use the MEDIAN command\n");
                 }
             }
-            else if (strncmp(pszCommand, "min", 3) == 0) {
+            else if (Utils::isCommand(pszCommand, "pct")) {
                 if (mode == STATISTIC) {
-                    if (stats.size() > 0) {
-                        double  min = strtod(stats[0].c_str(), NULL);
-                        int     minIndex = 0;
-                        mpfr_t  minValue;
+                    try {
+                        double percentile = strtod(&pszCommand[3], NULL);
 
-                        for (uint32_t s = 1;s < (uint32_t)stats.size();s++) {
-                            double v = strtod(stats[s].c_str(), NULL);
-
-                            if (v < min) {
-                                min = v;
-                                minIndex = s;
-                            }
-                        }
-
-                        mpfr_init2(minValue, getBasePrecision());
-                        mpfr_set_str(minValue, stats[minIndex].c_str(), DECIMAL, MPFR_RNDA);
-
-                        if (doFormat) {
-                            answer.assign(toFormattedString(minValue, DECIMAL, (long)getPrecision()));
-                        }
-                        else {
-                            answer.assign(toString(minValue, DECIMAL, (long)getPrecision()));
-                        }
-
-                        mpfr_clear(minValue);
+                        statQuantile(statValue, &stats, percentile / 100.0);
+                        printStatistic(statIsExact(&stats) ? "PCT" : "PCT (approx)", statValue, doFormat);
+                    }
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
+                    }
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the PCT command\n");
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "mode")) {
+                if (mode == STATISTIC) {
+                    try {
+                        uint64_t frequency = statMode(statValue, &stats);
 
-                        printf("MIN = %s\n", answer.c_str());
+                        printStatistic("MODE", statValue, doFormat);
+                        printf("\toccurs %lu times\n", (unsigned long)frequency);
                     }
-                    else {
-                        fprintf(stderr, "No data stored for statistic function\n");
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
                     }
                 }
                 else {
-                    fprintf(stderr, "Must be in STAT mode to use the MIN command\n");
+                    fprintf(stderr, "Must be in STAT mode to use the MODE command\n");
                 }
             }
-            else if (strncmp(pszCommand, "max", 3) == 0) {
+            else if (Utils::isCommand(pszCommand, "hist")) {
                 if (mode == STATISTIC) {
-                    if (stats.size() > 0) {
-                        double  max = strtod(stats[0].c_str(), NULL);
-                        int     maxIndex = 0;
-                        mpfr_t  maxValue;
+                    try {
+                        vector<uint64_t>    counts;
+                        double              low;
+                        double              width;
+                        uint64_t            largest = 1;
+                        int                 numBins = atoi(&pszCommand[4]);
 
-                        for (uint32_t s = 1;s < (uint32_t)stats.size();s++) {
-                            double v = strtod(stats[s].c_str(), NULL);
+                        statHistogram(&stats, (numBins > 0 ? numBins : STAT_DEFAULT_HISTOGRAM_BINS), counts, &low, &width);
 
-                            if (v > max) {
-                                max = v;
-                                maxIndex = s;
-                            }
+                        for (uint64_t c : counts) {
+                            largest = (c > largest ? c : largest);
                         }
 
-                        mpfr_init2(maxValue, getBasePrecision());
-                        mpfr_set_str(maxValue, stats[maxIndex].c_str(), DECIMAL, MPFR_RNDA);
+                        for (size_t b = 0;b < counts.size();b++) {
+                            printf(
+                                "\t[%14.6g, %14.6g) %10lu ", 
+                                low + b * width, 
+                                low + (b + 1) * width, 
+                                (unsigned long)counts[b]);
 
-                        if (doFormat) {
-                            answer.assign(toFormattedString(maxValue, DECIMAL, (long)getPrecision()));
-                        }
-                        else {
-                            answer.assign(toString(maxValue, DECIMAL, (long)getPrecision()));
+                            for (uint64_t i = 0;i < (counts[b] * HISTOGRAM_BAR_WIDTH) / largest;i++) {
+                                putchar('*');
+                            }
+
+                            putchar('\n');
                         }
 
-                        mpfr_clear(maxValue);
+                        if (!statIsExact(&stats)) {
+                            printf("\t(counts estimated to within %.2f%% of the total)\n", SKETCH_RANK_ERROR * 200.0);
+                        }
+                    }
+                    catch (calc_error & e) {
+                        fprintf(stderr, "%s\n", e.what());
+                    }
+                }
+                else {
+                    fprintf(stderr, "Must be in STAT mode to use the HIST command\n");
+                }
+            }
+            else if (Utils::isCommand(pszCommand, "load")) {
+                if (mode == STATISTIC) {
+                    char        szFilename[PATH_MAX];
+                    int         column = 1;
 
-                        printf("MIN = %s\n", answer.c_str());
+                    if (sscanf(&pszCommand[4], " %4095s %d", szFilename, &column) < 1) {
+                        fprintf(stderr, "Usage: load <file> [column]\n");
                     }
                     else {
-                        fprintf(stderr, "No data stored for statistic function\n");
+                        try {
+                            uint64_t numSkipped;
+                            uint64_t numLoaded = ldrLoad(&stats, szFilename, column, &numSkipped);
+
+                            printf("Loaded %lu values, skipped %lu lines\n", (unsigned long)numLoaded, (unsigned long)numSkipped);
+                        }
+                        catch (calc_error & e) {
+                            fprintf(stderr, "%s\n", e.what());
+                        }
                     }
                 }
                 else {
-                    fprintf(stderr, "Must be in STAT mode to use the MAX command\n");
+                    fprintf(stderr, "Must be in STAT mode to use the LOAD command\n");
                 }
             }
-            else if (strncmp(pszCommand, "clrstat", 7) == 0) {
-                for (uint32_t s = 0;s < (uint32_t)stats.size();s++) {
-                    stats[s].clear();
-                    stats[s].resize(0);
-                }
-
-                stats.clear();
+            else if (Utils::isCommand(pszCommand, "clrstat")) {
+                statClear(&stats);
             }
             else {
                 try {
                     if (mode == STATISTIC) {
-                        if (Utils::isOperand(pszCommand)) {
-                            stats.push_back(string(pszCommand));
+                        char *  pszEnd;
+                        mpfr_t  x;
+                        mpfr_t  y;
+
+                        /*
+                        ** Pairs are kept at the working precision, for precon...
+                        */
+                        mpfr_inits2(getBasePrecision(), x, y, (mpfr_ptr)0);
+
+                        mpfr_strtofr(x, pszCommand, &pszEnd, DECIMAL, MPFR_RNDN);
+
+                        if (pszEnd != pszCommand && *pszEnd == ',') {
+                            char *  pszY = pszEnd + 1;
+
+                            mpfr_strtofr(y, pszY, &pszEnd, DECIMAL, MPFR_RNDN);
+
+                            if (pszEnd != pszY) {
+                                statAddPair(&stats, x, y);
+                            }
+                        }
+                        else if (Utils::isOperand(pszCommand)) {
+                            mpfr_strtofr(statValue, pszCommand, NULL, DECIMAL, MPFR_RNDN);
+                            statAdd(&stats, statValue);
                         }
+
+                        mpfr_clears(x, y, (mpfr_ptr)0);
                     }
                     else {
-                        evaluate(result, pszCommand, mode);
+                        hasLast = false;
 
-                        if (doFormat) {
-                            answer.assign(toFormattedString(result, mode, (long)getPrecision()));
-                        }
-                        else {
-                            answer.assign(toString(result, mode, (long)getPrecision()));
-                        }
+                        compile(&lastProgram, pszCommand, mode);
+                        lastSubtotals.values.clear();
+                        lastSubtotals.precision = getPrecision();
 
-                        printf("\n%s\n        = %s\n\n", pszCommand, answer.c_str());
+                        result = runWithProgress(&lastProgram, &lastSubtotals);
+
+                        lastExpression = pszCommand;
+                        hasLast = true;
+
+                        printResult(answer, pszCommand, result, mode, doFormat);
                     }
                 }
                 catch (calc_error & e) {
@@ -472,7 +1294,7 @@ int main(int argc, char ** argv) {
         free(pszCommand);
     }
 
-    mpfr_clear(result);
-
+    statFree(&stats);
+    mpfr_clear(statValue);
     return 0;
 }
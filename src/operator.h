@@ -4,8 +4,10 @@
 #include <mpfr.h>
 
 #include "logger.h"
+#include "calc_error.h"
 #include "utils.h"
 #include "system.h"
+#include "word.h"
 
 using namespace std;
 
@@ -18,23 +20,53 @@ typedef enum {
 }
 associativity;
 
-class Operator {
-    public:
-        static string evaluate(string & op, int radix, string & operand1, string & operand2) {
-            mpfr_t          r;
-            mpfr_t          o1;
-            mpfr_t          o2;
-            string          result;
+/*
+** A cheaper way to work out an operator on real numbers, chosen when the
+** program is compiled because one of the operands is a whole number
+** written in the calculation (n below), or both operands are the same.
+** The results are the same as the generic MPFR calls, correctly rounded...
+*/
+typedef enum {
+    KERNEL_GENERIC,
+    KERNEL_SQUARE,              // x * x, x ^ 2
+    KERNEL_POW_SI,              // x ^ n
+    KERNEL_UI_POW,              // n ^ x, n >= 0
+    KERNEL_ADD_SI,              // x + n, n + x
+    KERNEL_SUB_SI,              // x - n
+    KERNEL_SI_SUB,              // n - x
+    KERNEL_MUL_SI,              // x * n, n * x
+    KERNEL_MUL_2SI,             // x * 2^n, 2^n * x
+    KERNEL_DIV_SI,              // x / n
+    KERNEL_DIV_2SI,             // x / 2^n
+    KERNEL_SI_DIV,              // n / x
+    KERNEL_ROOT_UI              // x : n
+}
+kernel_type_t;
 
-            lgLogDebug("Evaluating: %s %s %s", operand1.c_str(), op.c_str(), operand2.c_str());
+typedef struct {
+    kernel_type_t   type;
+    long            n;
 
-            mpfr_init2(o1, getBasePrecision());
-            mpfr_strtofr(o1, operand1.c_str(), NULL, radix, MPFR_RNDA);
+    /*
+    ** Whether n is the first operand, x is then the second...
+    */
+    bool            isFirstLiteral;
+}
+kernel_t;
 
-            mpfr_init2(o2, getBasePrecision());
-            mpfr_strtofr(o2, operand2.c_str(), NULL, radix, MPFR_RNDA);
+class Operator {
+    private:
+        static void _checkSize(double bits) {
+            if (bits > (double)INTEGER_MAX_BITS) {
+                throw calc_error(calc_error::buildMsg("Integer result too large, the limit is %ld bits", INTEGER_MAX_BITS));
+            }
+        }
 
-            mpfr_init2(r, getBasePrecision());
+        static value_t _evaluateReal(const string & op, const value_t & operand1, const value_t & operand2) {
+            value_t         result = newValue();
+            mpfr_ptr        r = result->v;
+            mpfr_srcptr     o1 = operand1->v;
+            mpfr_srcptr     o2 = operand2->v;
 
             switch (op[0]) {
                 case '+':
@@ -65,59 +97,538 @@ class Operator {
                     mpfr_rootn_ui(r, o1, mpfr_get_ui(o2, MPFR_RNDA), MPFR_RNDA);
                     break;
 
+                /*
+                ** The bitwise operators work on whole numbers...
+                */
+                case '&':
+                case '|':
+                case '~':
+                case '<':
+                case '>':
+                    return toReal(_evaluateInteger(op, toInteger(operand1), toInteger(operand2)));
+            }
+
+            return result;
+        }
+
+        /*
+        ** Exact integer arithmetic of any width. An operation whose
+        ** answer is not a whole number (e.g. 7 / 2) is worked out with
+        ** real numbers and rounded away from zero...
+        */
+        static value_t _evaluateInteger(const string & op, const value_t & operand1, const value_t & operand2) {
+            value_t         result = newInteger();
+            mpz_ptr         r = result->z;
+            mpz_srcptr      o1 = operand1->z;
+            mpz_srcptr      o2 = operand2->z;
+
+            switch (op[0]) {
+                case '+':
+                    mpz_add(r, o1, o2);
+                    break;
+
+                case '-':
+                    mpz_sub(r, o1, o2);
+                    break;
+
+                case '*':
+                    _checkSize((double)mpz_sizeinbase(o1, 2) + (double)mpz_sizeinbase(o2, 2));
+                    mpz_mul(r, o1, o2);
+                    break;
+
+                case '/':
+                    if (mpz_sgn(o2) == 0) {
+                        throw calc_error("Integer division by zero");
+                    }
+
+                    if (!mpz_divisible_p(o1, o2)) {
+                        return toInteger(_evaluateReal(op, toReal(operand1), toReal(operand2)));
+                    }
+
+                    mpz_divexact(r, o1, o2);
+                    break;
+
+                case '%':
+                    if (mpz_sgn(o2) == 0) {
+                        throw calc_error("Integer division by zero");
+                    }
+
+                    mpz_tdiv_r(r, o1, o2);
+                    break;
+
+                case '^':
+                    if (mpz_sgn(o2) < 0 || !mpz_fits_ulong_p(o2)) {
+                        return toInteger(_evaluateReal(op, toReal(operand1), toReal(operand2)));
+                    }
+
+                    if (mpz_cmpabs_ui(o1, 1) > 0) {
+                        _checkSize((double)mpz_sizeinbase(o1, 2) * (double)mpz_get_ui(o2));
+                    }
+
+                    mpz_pow_ui(r, o1, mpz_get_ui(o2));
+                    break;
+
+                case ':':
+                    /*
+                    ** Exact if the root is a whole number...
+                    */
+                    if (mpz_sgn(o2) > 0 && mpz_fits_ulong_p(o2) && 
+                        (mpz_sgn(o1) >= 0 || mpz_odd_p(o2)) &&
+                        mpz_root(r, o1, mpz_get_ui(o2)))
+                    {
+                        break;
+                    }
+
+                    return toInteger(_evaluateReal(op, toReal(operand1), toReal(operand2)));
+
                 case '&':
-                    mpfr_set_ui(
-                            r, 
-                            (mpfr_get_ui(o1, MPFR_RNDA) & 
-                            mpfr_get_ui(o2, MPFR_RNDA)), 
-                            MPFR_RNDA);
+                    mpz_and(r, o1, o2);
                     break;
 
                 case '|':
-                    mpfr_set_ui(
-                            r, 
-                            (mpfr_get_ui(o1, MPFR_RNDA) | 
-                            mpfr_get_ui(o2, MPFR_RNDA)), 
-                            MPFR_RNDA);
+                    mpz_ior(r, o1, o2);
                     break;
 
                 case '~':
-                    mpfr_set_ui(
-                            r, 
-                            (mpfr_get_ui(o1, MPFR_RNDA) ^ 
-                            mpfr_get_ui(o2, MPFR_RNDA)), 
-                            MPFR_RNDA);
+                    mpz_xor(r, o1, o2);
                     break;
 
                 case '<':
-                    mpfr_set_ui(
-                            r, 
-                            (mpfr_get_ui(o1, MPFR_RNDA) << 
-                            mpfr_get_ui(o2, MPFR_RNDA)), 
-                            MPFR_RNDA);
+                case '>':
+                    if (!mpz_fits_slong_p(o2)) {
+                        throw calc_error("Shift out of range");
+                    }
+
+                    long shift = mpz_get_si(o2);
+
+                    if (op[0] == '>') {
+                        shift = -shift;
+                    }
+
+                    if (shift >= 0) {
+                        _checkSize((double)mpz_sizeinbase(o1, 2) + (double)shift);
+                        mpz_mul_2exp(r, o1, (mp_bitcnt_t)shift);
+                    }
+                    else {
+                        mpz_fdiv_q_2exp(r, o1, (mp_bitcnt_t)(-shift));
+                    }
+                    break;
+            }
+
+            return result;
+        }
+
+        /*
+        ** Small integers are worked out with native 64 bit arithmetic,
+        ** giving the same answer as the exact (or real) arithmetic would.
+        ** The answer is empty if it overflows, is not a whole number or
+        ** would be a real negative zero, the operator is then worked out
+        ** with GMP or MPFR as usual...
+        */
+        static value_t _evaluateSmall(const string & op, int radix, int64_t a, int64_t b) {
+            int64_t         r;
+            bool            isReal = !isIntegerMode(radix);
+
+            switch (op[0]) {
+                case '+':
+                    if (__builtin_add_overflow(a, b, &r)) {
+                        return value_t();
+                    }
+                    break;
+
+                case '-':
+                    if (__builtin_sub_overflow(a, b, &r)) {
+                        return value_t();
+                    }
+                    break;
+
+                case '*':
+                    if (__builtin_mul_overflow(a, b, &r) || (isReal && r == 0 && (a < 0 || b < 0))) {
+                        return value_t();
+                    }
+                    break;
+
+                case '/':
+                    if (b == 0 || (b == -1 && a == INT64_MIN) || a % b != 0 || (isReal && a == 0 && b < 0)) {
+                        return value_t();
+                    }
+
+                    r = a / b;
+                    break;
+
+                case '%':
+                    /*
+                    ** The real remainder rounds the quotient to nearest...
+                    */
+                    if (isReal || b == 0) {
+                        return value_t();
+                    }
+
+                    r = (b == -1 ? 0 : a % b);
                     break;
 
+                case '^':
+                    if (b < 0) {
+                        return value_t();
+                    }
+
+                    r = 1;
+
+                    while (b > 0) {
+                        if ((b & 1) && __builtin_mul_overflow(r, a, &r)) {
+                            return value_t();
+                        }
+
+                        b >>= 1;
+
+                        if (b > 0 && __builtin_mul_overflow(a, a, &a)) {
+                            return value_t();
+                        }
+                    }
+                    break;
+
+                case '&':
+                    r = a & b;
+                    break;
+
+                case '|':
+                    r = a | b;
+                    break;
+
+                case '~':
+                    r = a ^ b;
+                    break;
+
+                case '<':
                 case '>':
-                    mpfr_set_ui(
-                            r, 
-                            (mpfr_get_ui(o1, MPFR_RNDA) >> 
-                            mpfr_get_ui(o2, MPFR_RNDA)), 
-                            MPFR_RNDA);
+                    if (b == INT64_MIN) {
+                        return value_t();
+                    }
+
+                    if (op[0] == '>') {
+                        b = -b;
+                    }
+
+                    if (a == 0) {
+                        r = 0;
+                    }
+                    else if (b >= 0) {
+                        if (b >= 63 || __builtin_mul_overflow(a, (int64_t)1 << b, &r)) {
+                            return value_t();
+                        }
+                    }
+                    else {
+                        r = (b <= -63 ? (a < 0 ? -1 : 0) : a >> -b);
+                    }
+                    break;
+
+                default:
+                    return value_t();
+            }
+
+            return newSmall(r);
+        }
+
+        static bool _isRational(const value_t & value) {
+            return (value->type == VALUE_RATIONAL || value->type == VALUE_SMALL || value->type == VALUE_INTEGER);
+        }
+
+        /*
+        ** Exact arithmetic on fractions, the answer is empty if it is
+        ** not a fraction (e.g. 2 ^ 0.5 or 1 / 0) or is not worth working
+        ** out exactly, the operator is then worked out on real numbers...
+        */
+        static value_t _evaluateRational(const string & op, const value_t & operand1, const value_t & operand2) {
+            value_t         a = toRational(operand1);
+            value_t         b = toRational(operand2);
+            value_t         result = newRational();
+            mpq_ptr         r = result->q;
+            mpq_srcptr      o1 = a->q;
+            mpq_srcptr      o2 = b->q;
+
+            switch (op[0]) {
+                case '+':
+                    mpq_add(r, o1, o2);
+                    break;
+
+                case '-':
+                    mpq_sub(r, o1, o2);
+                    break;
+
+                case '*':
+                    mpq_mul(r, o1, o2);
+                    break;
+
+                case '/':
+                    if (mpq_sgn(o2) == 0) {
+                        return value_t();
+                    }
+
+                    mpq_div(r, o1, o2);
                     break;
+
+                case '^':
+                    /*
+                    ** Whole powers only, of numbers that are not zero,
+                    ** and not so big the real numbers are not better...
+                    */
+                    if (mpz_cmp_ui(mpq_denref(o2), 1) != 0 || !mpz_fits_slong_p(mpq_numref(o2)) || mpq_sgn(o1) == 0) {
+                        return value_t();
+                    }
+                    else {
+                        long            n = mpz_get_si(mpq_numref(o2));
+                        unsigned long   e = (n < 0 ? 0UL - (unsigned long)n : (unsigned long)n);
+                        double          bits = (double)mpz_sizeinbase(mpq_numref(o1), 2) + (double)mpz_sizeinbase(mpq_denref(o1), 2);
+
+                        if (bits * (double)e > (double)INTEGER_MAX_BITS) {
+                            return value_t();
+                        }
+
+                        mpz_pow_ui(mpq_numref(r), mpq_numref(o1), e);
+                        mpz_pow_ui(mpq_denref(r), mpq_denref(o1), e);
+
+                        if (n < 0) {
+                            mpq_inv(r, r);
+                        }
+                    }
+                    break;
+
+                default:
+                    return value_t();
+            }
+
+            return result;
+        }
+
+        static bool _isSmallInteger(const value_t & value, long * n) {
+            if (value && value->type == VALUE_SMALL) {
+                *n = (long)value->i;
+                return true;
+            }
+
+            if (!value || value->type != VALUE_REAL) {
+                return false;
             }
 
-            result.assign(toString(r, radix, getBasePrecision()));
+            if (!mpfr_integer_p(value->v) || !mpfr_fits_slong_p(value->v, MPFR_RNDN)) {
+                return false;
+            }
+
+            *n = mpfr_get_si(value->v, MPFR_RNDN);
+
+            return true;
+        }
+
+        static value_t _evaluateKernel(const kernel_t & kernel, const value_t & operand1, const value_t & operand2) {
+            value_t         result = newValue();
+            mpfr_ptr        r = result->v;
+            mpfr_srcptr     x = (kernel.isFirstLiteral ? operand2->v : operand1->v);
+            long            n = kernel.n;
+
+            switch (kernel.type) {
+                case KERNEL_SQUARE:
+                    mpfr_sqr(r, x, MPFR_RNDA);
+                    break;
+
+                case KERNEL_POW_SI:
+                    mpfr_pow_si(r, x, n, MPFR_RNDA);
+                    break;
+
+                case KERNEL_UI_POW:
+                    mpfr_ui_pow(r, (unsigned long)n, x, MPFR_RNDA);
+                    break;
+
+                case KERNEL_ADD_SI:
+                    mpfr_add_si(r, x, n, MPFR_RNDA);
+                    break;
+
+                case KERNEL_SUB_SI:
+                    mpfr_sub_si(r, x, n, MPFR_RNDA);
+                    break;
 
-            lgLogDebug("Result = %s", result.c_str());
+                case KERNEL_SI_SUB:
+                    mpfr_si_sub(r, n, x, MPFR_RNDA);
+                    break;
+
+                case KERNEL_MUL_SI:
+                    mpfr_mul_si(r, x, n, MPFR_RNDA);
+                    break;
+
+                case KERNEL_MUL_2SI:
+                    mpfr_mul_2si(r, x, n, MPFR_RNDA);
+                    break;
+
+                case KERNEL_DIV_SI:
+                    mpfr_div_si(r, x, n, MPFR_RNDA);
+                    break;
+
+                case KERNEL_DIV_2SI:
+                    mpfr_div_2si(r, x, n, MPFR_RNDA);
+                    break;
 
-            mpfr_clear(r);
-            mpfr_clear(o2);
-            mpfr_clear(o1);
+                case KERNEL_SI_DIV:
+                    mpfr_si_div(r, n, x, MPFR_RNDA);
+                    break;
+
+                case KERNEL_ROOT_UI:
+                    if (n == 2) {
+                        mpfr_sqrt(r, x, MPFR_RNDA);
+                    }
+                    else {
+                        mpfr_rootn_ui(r, x, (unsigned long)n, MPFR_RNDA);
+                    }
+                    break;
+
+                case KERNEL_GENERIC:
+                    break;
+            }
 
             return result;
         }
 
-        static int getPrescedence(string & op) {
+    public:
+        /*
+        ** Choose the kernel for an operator from its operands, literal1
+        ** and literal2 are the numbers if the operands are written in the
+        ** calculation (empty if not), isSame if both operands are the same
+        ** name or number...
+        */
+        static kernel_t getKernel(const string & op, const value_t & literal1, const value_t & literal2, bool isSame) {
+            kernel_t        kernel = { KERNEL_GENERIC, 0, false };
+            long            n = 0;
+
+            bool isSmall2 = _isSmallInteger(literal2, &n);
+            bool isSmall1 = !isSmall2 && _isSmallInteger(literal1, &n);
+
+            kernel.n = n;
+            kernel.isFirstLiteral = isSmall1;
+
+            switch (op[0]) {
+                case '+':
+                    if (isSmall1 || isSmall2) {
+                        kernel.type = KERNEL_ADD_SI;
+                    }
+                    break;
+
+                case '-':
+                    if (isSmall2) {
+                        kernel.type = KERNEL_SUB_SI;
+                    }
+                    else if (isSmall1) {
+                        kernel.type = KERNEL_SI_SUB;
+                    }
+                    break;
+
+                case '*':
+                    if (isSame) {
+                        kernel.type = KERNEL_SQUARE;
+                    }
+                    else if (isSmall1 || isSmall2) {
+                        if (n > 0 && (n & (n - 1)) == 0) {
+                            kernel.type = KERNEL_MUL_2SI;
+                            kernel.n = __builtin_ctzl((unsigned long)n);
+                        }
+                        else {
+                            kernel.type = KERNEL_MUL_SI;
+                        }
+                    }
+                    break;
+
+                case '/':
+                    if (isSmall2 && n != 0) {
+                        if (n > 0 && (n & (n - 1)) == 0) {
+                            kernel.type = KERNEL_DIV_2SI;
+                            kernel.n = __builtin_ctzl((unsigned long)n);
+                        }
+                        else {
+                            kernel.type = KERNEL_DIV_SI;
+                        }
+                    }
+                    else if (isSmall1) {
+                        kernel.type = KERNEL_SI_DIV;
+                    }
+                    break;
+
+                case '^':
+                    if (isSmall2) {
+                        kernel.type = (n == 2 ? KERNEL_SQUARE : KERNEL_POW_SI);
+                    }
+                    else if (isSmall1 && n >= 0) {
+                        kernel.type = KERNEL_UI_POW;
+                    }
+                    break;
+
+                case ':':
+                    if (isSmall2 && n > 0) {
+                        kernel.type = KERNEL_ROOT_UI;
+                    }
+                    break;
+            }
+
+            if (kernel.type == KERNEL_GENERIC) {
+                kernel.isFirstLiteral = false;
+            }
+
+            return kernel;
+        }
+
+        /*
+        ** The kernels are only for real numbers, the integer modes and
+        ** exact mode have their own exact arithmetic, and two small
+        ** integers are quicker still...
+        */
+        static value_t evaluate(const string & op, int radix, const value_t & operand1, const value_t & operand2, const kernel_t & kernel) {
+            if (kernel.type == KERNEL_GENERIC || isIntegerMode(radix) || getExact() ||
+                (operand1->type == VALUE_SMALL && operand2->type == VALUE_SMALL))
+            {
+                return evaluate(op, radix, operand1, operand2);
+            }
+
+            lgLogDebug("Evaluating: operator '%s' with kernel %d", op.c_str(), (int)kernel.type);
+
+            return _evaluateKernel(kernel, toReal(operand1), toReal(operand2));
+        }
+
+        static value_t evaluate(const string & op, int radix, const value_t & operand1, const value_t & operand2) {
+            lgLogDebug("Evaluating: operator '%s'", op.c_str());
+
+            if (operand1->type == VALUE_SMALL && operand2->type == VALUE_SMALL &&
+                !(isIntegerMode(radix) && getWordSize() > 0))
+            {
+                value_t result = _evaluateSmall(op, radix, operand1->i, operand2->i);
+
+                if (result) {
+                    return result;
+                }
+            }
+
+            if (isIntegerMode(radix)) {
+                if (getWordSize() > 0) {
+                    /*
+                    ** Roots are rare enough to borrow the integer code...
+                    */
+                    if (op[0] == ':') {
+                        return toWord(_evaluateInteger(op, toInteger(operand1), toInteger(operand2)));
+                    }
+
+                    return Word::evaluate(op, operand1, operand2);
+                }
+
+                return _evaluateInteger(op, toInteger(operand1), toInteger(operand2));
+            }
+
+            if (getExact() && _isRational(operand1) && _isRational(operand2)) {
+                value_t result = _evaluateRational(op, operand1, operand2);
+
+                if (result) {
+                    return result;
+                }
+            }
+
+            return _evaluateReal(op, toReal(operand1), toReal(operand2));
+        }
+
+        static int getPrescedence(const string & op) {
             int p = 0;
 
             switch (op[0]) {
@@ -173,7 +684,7 @@ class Operator {
             return p;
         }
 
-        static associativity getAssociativity(string & op) {
+        static associativity getAssociativity(const string & op) {
             associativity a = LEFT;
 
             switch (op[0]) {
@@ -0,0 +1,463 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "logger.h"
+#include "calc_error.h"
+#include "system.h"
+#include "threadpool.h"
+#include "series.h"
+#include "calculator.h"
+#include "quadrature.h"
+
+using namespace std;
+
+/*
+** The 15 point Kronrod rule and the 7 point Gauss rule it extends, the
+** nodes are symmetric about the middle of the range, which is the last
+** node. The Gauss nodes are every other Kronrod node...
+*/
+static const double xgk[8] = {
+    0.991455371120812639206854697526329,
+    0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926,
+    0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013,
+    0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245,
+    0.000000000000000000000000000000000
+};
+
+static const double wgk[8] = {
+    0.022935322010529224963732008058970,
+    0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518,
+    0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550,
+    0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649,
+    0.209482141084727828012999174891714
+};
+
+static const double wg[4] = {
+    0.129484966168869693270611432679082,
+    0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975,
+    0.417959183673469387755102040816327
+};
+
+typedef struct {
+    const program_t *   program;
+    const string *      variable;
+}
+integrand_t;
+
+typedef struct {
+    double      a;
+    double      b;
+    double      result;
+    double      error;
+    double      resabs;
+}
+segment_t;
+
+static double _evaluateDouble(const integrand_t * f, double x) {
+    mpfr_t          v;
+    double          fx;
+
+    mpfr_init2(v, getBasePrecision());
+    mpfr_set_d(v, x, MPFR_RNDN);
+
+    executeAt(v, f->program, *f->variable, v);
+
+    fx = mpfr_get_d(v, MPFR_RNDN);
+
+    mpfr_clear(v);
+
+    if (!isfinite(fx)) {
+        throw calc_error(calc_error::buildMsg("The integrand is not finite at %.17g", x));
+    }
+
+    return fx;
+}
+
+/*
+** The 15 point rule on one segment, with the error estimate as QUADPACK
+** works it out...
+*/
+static void _kronrod(const integrand_t * f, segment_t * s) {
+    double      c = 0.5 * (s->a + s->b);
+    double      d = 0.5 * (s->b - s->a);
+    double      fc = _evaluateDouble(f, c);
+    double      fv1[7];
+    double      fv2[7];
+    double      resultKronrod = fc * wgk[7];
+    double      resultGauss = fc * wg[3];
+    double      resabs = fabs(resultKronrod);
+    double      resasc;
+    double      mean;
+
+    for (int j = 0;j < 7;j++) {
+        double dx = d * xgk[j];
+
+        fv1[j] = _evaluateDouble(f, c - dx);
+        fv2[j] = _evaluateDouble(f, c + dx);
+
+        resultKronrod += wgk[j] * (fv1[j] + fv2[j]);
+        resabs += wgk[j] * (fabs(fv1[j]) + fabs(fv2[j]));
+
+        if (j & 1) {
+            resultGauss += wg[j / 2] * (fv1[j] + fv2[j]);
+        }
+    }
+
+    mean = 0.5 * resultKronrod;
+    resasc = wgk[7] * fabs(fc - mean);
+
+    for (int j = 0;j < 7;j++) {
+        resasc += wgk[j] * (fabs(fv1[j] - mean) + fabs(fv2[j] - mean));
+    }
+
+    s->result = resultKronrod * d;
+    s->resabs = resabs * fabs(d);
+    s->error = fabs((resultKronrod - resultGauss) * d);
+
+    resasc *= fabs(d);
+
+    if (resasc != 0.0 && s->error != 0.0) {
+        s->error = resasc * min(1.0, pow(200.0 * s->error / resasc, 1.5));
+    }
+
+    if (s->resabs > DBL_MIN / (50.0 * DBL_EPSILON)) {
+        s->error = max(50.0 * DBL_EPSILON * s->resabs, s->error);
+    }
+}
+
+/*
+** Split the segments with the biggest errors, as many at a time as there
+** are cores, until the total error is small enough for the digits being
+** shown. False if it never gets there, e.g. if doubles are not precise
+** enough...
+*/
+static bool _gaussKronrod(mpfr_t result, mpfr_t error, const integrand_t * f, double a, double b) {
+    vector<segment_t>   segments(1);
+    size_t              numThreads = (size_t)ThreadPool::getDefaultSize();
+    double              tolerance = 0.1 * pow(10.0, -(double)getPrecision());
+    double              total;
+    double              totalError;
+    double              totalAbs;
+
+    segments[0] = { a, b, 0.0, 0.0, 0.0 };
+    _kronrod(f, &segments[0]);
+
+    while (true) {
+        total = 0.0;
+        totalError = 0.0;
+        totalAbs = 0.0;
+
+        for (segment_t & s : segments) {
+            total += s.result;
+            totalError += s.error;
+            totalAbs += s.resabs;
+        }
+
+        if (totalError <= max(tolerance, 50.0 * DBL_EPSILON * totalAbs) || segments.size() >= QUAD_MAX_SEGMENTS) {
+            break;
+        }
+
+        sort(segments.begin(), segments.end(), [](const segment_t & x, const segment_t & y) {
+            return (x.error > y.error);
+        });
+
+        size_t              numSplit = min(segments.size(), numThreads);
+        vector<segment_t>   halves(numSplit * 2);
+
+        for (size_t i = 0;i < numSplit;i++) {
+            double m = 0.5 * (segments[i].a + segments[i].b);
+
+            /*
+            ** Too narrow to split again...
+            */
+            if (m == segments[i].a || m == segments[i].b) {
+                numSplit = i;
+                break;
+            }
+
+            halves[i * 2] = { segments[i].a, m, 0.0, 0.0, 0.0 };
+            halves[i * 2 + 1] = { m, segments[i].b, 0.0, 0.0, 0.0 };
+        }
+
+        if (numSplit == 0) {
+            break;
+        }
+
+        halves.resize(numSplit * 2);
+
+        runParallel(halves.size(), [&](size_t i) {
+            _kronrod(f, &halves[i]);
+        });
+
+        segments.erase(segments.begin(), segments.begin() + numSplit);
+        segments.insert(segments.end(), halves.begin(), halves.end());
+    }
+
+    lgLogDebug("Gauss-Kronrod: %d segments, error %g", (int)segments.size(), totalError);
+
+    mpfr_set_d(result, total, MPFR_RNDN);
+    mpfr_set_d(error, totalError, MPFR_RNDN);
+
+    return (totalError <= tolerance);
+}
+
+/*
+** Whether a point u from the end differs from it only in its guard bits...
+*/
+static bool _isAtEnd(mpfr_t end, mpfr_t u, mpfr_prec_t wp) {
+    if (mpfr_zero_p(end)) {
+        return false;
+    }
+
+    return (mpfr_get_exp(u) < mpfr_get_exp(end) - (wp - PRECISION_GUARD_BITS));
+}
+
+/*
+** The tanh-sinh (double exponential) rule, x = c + d * tanh(pi/2 sinh(t))
+** at the points t = k * h, halving h until the sum settles. The points
+** near the ends are worked out from their distance to the end, so ends
+** where the integrand is infinite are never reached...
+*/
+static void _tanhSinh(mpfr_t result, mpfr_t error, const integrand_t * f, mpfr_t a, mpfr_t b) {
+    mpfr_prec_t     wp = getBasePrecision();
+    mpfr_t          c;
+    mpfr_t          d;
+    mpfr_t          halfPi;
+    mpfr_t          total;
+    mpfr_t          totalAbs;
+    mpfr_t          previous;
+    mpfr_t          tolerance;
+    double          tMax = asinh(((double)wp * M_LN2 + 20.0) / M_PI) + 1.0;
+
+    mpfr_inits2(wp, c, d, halfPi, total, totalAbs, previous, tolerance, (mpfr_ptr)0);
+
+    mpfr_add(c, a, b, MPFR_RNDN);
+    mpfr_div_2ui(c, c, 1, MPFR_RNDN);
+    mpfr_sub(d, b, a, MPFR_RNDN);
+    mpfr_div_2ui(d, d, 1, MPFR_RNDN);
+
+    serPi(halfPi);
+    mpfr_div_2ui(halfPi, halfPi, 1, MPFR_RNDN);
+
+    mpfr_set_zero(total, 1);
+    mpfr_set_zero(totalAbs, 1);
+    mpfr_set_inf(error, 1);
+
+    for (int level = 0;level <= QUAD_MAX_LEVELS;level++) {
+        vector<long>    points;
+        long            n = (long)ceil(ldexp(tMax, level));
+
+        /*
+        ** Each level adds the points half way between the last ones...
+        */
+        for (long k = (level == 0 ? 0 : 1);k <= n;k += (level == 0 ? 1 : 2)) {
+            points.push_back(k);
+        }
+
+        size_t              numParts = min((size_t)ThreadPool::getDefaultSize(), max((size_t)1, points.size() / QUAD_MIN_POINTS_PER_THREAD));
+        vector<__mpfr_struct>   sums(numParts);
+        vector<__mpfr_struct>   sumsAbs(numParts);
+
+        for (size_t i = 0;i < numParts;i++) {
+            mpfr_init2(&sums[i], wp);
+            mpfr_init2(&sumsAbs[i], wp);
+            mpfr_set_zero(&sums[i], 1);
+            mpfr_set_zero(&sumsAbs[i], 1);
+        }
+
+        auto sumPart = [&](size_t part) {
+            mpfr_t      t;
+            mpfr_t      sh;
+            mpfr_t      ch;
+            mpfr_t      y;
+            mpfr_t      u;
+            mpfr_t      w;
+            mpfr_t      x;
+            mpfr_t      fx;
+
+            mpfr_inits2(wp, t, sh, ch, y, u, w, x, fx, (mpfr_ptr)0);
+
+            try {
+                for (size_t i = points.size() * part / numParts;i < points.size() * (part + 1) / numParts;i++) {
+                    long k = points[i];
+
+                    mpfr_set_si_2exp(t, k, -level, MPFR_RNDN);
+                    mpfr_sinh_cosh(sh, ch, t, MPFR_RNDN);
+
+                    /*
+                    ** y = pi/2 sinh(t), w = pi/2 cosh(t) / cosh(y)^2 and
+                    ** u = 1 - tanh(y) = 1 / (e^y cosh(y))...
+                    */
+                    mpfr_mul(y, halfPi, sh, MPFR_RNDN);
+                    mpfr_cosh(u, y, MPFR_RNDN);
+                    mpfr_sqr(w, u, MPFR_RNDN);
+                    mpfr_div(w, ch, w, MPFR_RNDN);
+                    mpfr_mul(w, w, halfPi, MPFR_RNDN);
+
+                    if (mpfr_zero_p(w) || mpfr_get_exp(w) < -wp) {
+                        continue;
+                    }
+
+                    mpfr_exp(y, y, MPFR_RNDN);
+                    mpfr_mul(u, u, y, MPFR_RNDN);
+                    mpfr_ui_div(u, 1, u, MPFR_RNDN);
+                    mpfr_mul(u, u, d, MPFR_RNDN);
+
+                    for (int side = 0;side < (k == 0 ? 1 : 2);side++) {
+                        if (k == 0) {
+                            mpfr_set(x, c, MPFR_RNDN);
+                        }
+                        else if (side == 0) {
+                            mpfr_sub(x, b, u, MPFR_RNDN);
+
+                            if (mpfr_equal_p(x, b)) {
+                                continue;
+                            }
+                        }
+                        else {
+                            mpfr_add(x, a, u, MPFR_RNDN);
+
+                            if (mpfr_equal_p(x, a)) {
+                                continue;
+                            }
+                        }
+
+                        executeAt(fx, f->program, *f->variable, x);
+
+                        /*
+                        ** An integrand may be infinite at an end, and a
+                        ** point that is the end but for its guard bits can
+                        ** hit that, its weight is far too small to matter...
+                        */
+                        if (k != 0 && mpfr_inf_p(fx) && _isAtEnd((side == 0 ? b : a), u, wp)) {
+                            continue;
+                        }
+
+                        if (!mpfr_number_p(fx)) {
+                            throw calc_error(
+                                    calc_error::buildMsg(
+                                        "The integrand is not finite at %.17g",
+                                        mpfr_get_d(x, MPFR_RNDN)));
+                        }
+
+                        mpfr_mul(fx, fx, w, MPFR_RNDN);
+                        mpfr_add(&sums[part], &sums[part], fx, MPFR_RNDN);
+                        mpfr_abs(fx, fx, MPFR_RNDN);
+                        mpfr_add(&sumsAbs[part], &sumsAbs[part], fx, MPFR_RNDN);
+                    }
+                }
+            }
+            catch (...) {
+                mpfr_clears(t, sh, ch, y, u, w, x, fx, (mpfr_ptr)0);
+                throw;
+            }
+
+            mpfr_clears(t, sh, ch, y, u, w, x, fx, (mpfr_ptr)0);
+        };
+
+        try {
+            runParallel(numParts, sumPart);
+        }
+        catch (...) {
+            for (size_t i = 0;i < numParts;i++) {
+                mpfr_clear(&sums[i]);
+                mpfr_clear(&sumsAbs[i]);
+            }
+
+            mpfr_clears(c, d, halfPi, total, totalAbs, previous, tolerance, (mpfr_ptr)0);
+            throw;
+        }
+
+        for (size_t i = 0;i < numParts;i++) {
+            mpfr_add(total, total, &sums[i], MPFR_RNDN);
+            mpfr_add(totalAbs, totalAbs, &sumsAbs[i], MPFR_RNDN);
+
+            mpfr_clear(&sums[i]);
+            mpfr_clear(&sumsAbs[i]);
+        }
+
+        /*
+        ** The sum at this level is h * d * total...
+        */
+        mpfr_mul(result, total, d, MPFR_RNDN);
+        mpfr_div_2si(result, result, level, MPFR_RNDN);
+
+        if (level > 0) {
+            mpfr_sub(error, result, previous, MPFR_RNDN);
+            mpfr_abs(error, error, MPFR_RNDN);
+
+            /*
+            ** Small enough for the digits shown, or as small as the
+            ** working precision allows...
+            */
+            mpfr_set_ui(tolerance, 10, MPFR_RNDN);
+            mpfr_pow_si(tolerance, tolerance, -(long)getPrecision() - 1, MPFR_RNDN);
+
+            mpfr_mul(previous, totalAbs, d, MPFR_RNDN);
+            mpfr_abs(previous, previous, MPFR_RNDN);
+            mpfr_div_2si(previous, previous, level + wp - PRECISION_GUARD_BITS, MPFR_RNDN);
+
+            if (mpfr_cmp(previous, tolerance) > 0) {
+                mpfr_set(tolerance, previous, MPFR_RNDN);
+            }
+
+            lgLogDebug("Tanh-sinh: level %d, %d points, error %g", level, (int)points.size(), mpfr_get_d(error, MPFR_RNDN));
+
+            if (level > 2 && mpfr_cmp(error, tolerance) <= 0) {
+                break;
+            }
+        }
+
+        mpfr_set(previous, result, MPFR_RNDN);
+    }
+
+    mpfr_clears(c, d, halfPi, total, totalAbs, previous, tolerance, (mpfr_ptr)0);
+}
+
+void quadIntegrate(
+            mpfr_t result,
+            mpfr_t error,
+            const program_t * program,
+            const string & variable,
+            mpfr_t a,
+            mpfr_t b)
+{
+    integrand_t     f = { program, &variable };
+
+    if (!mpfr_number_p(a) || !mpfr_number_p(b)) {
+        throw calc_error("The limits of an integral must be finite");
+    }
+
+    if (mpfr_equal_p(a, b)) {
+        mpfr_set_zero(result, 1);
+        mpfr_set_zero(error, 1);
+        return;
+    }
+
+    /*
+    ** Doubles are enough if Gauss-Kronrod gets the error down to the
+    ** digits being shown...
+    */
+    if (getPrecision() <= QUAD_DOUBLE_DIGITS) {
+        if (_gaussKronrod(result, error, &f, mpfr_get_d(a, MPFR_RNDN), mpfr_get_d(b, MPFR_RNDN))) {
+            return;
+        }
+    }
+
+    _tanhSinh(result, error, &f, a, b);
+}
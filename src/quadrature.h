@@ -0,0 +1,45 @@
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "calculator.h"
+
+#ifndef __INCL_QUADRATURE
+#define __INCL_QUADRATURE
+
+/*
+** Up to this many digits the integral is worked out with doubles, by
+** adaptive Gauss-Kronrod, above it with tanh-sinh at the working
+** precision...
+*/
+#define QUAD_DOUBLE_DIGITS                      15
+
+/*
+** Gauss-Kronrod gives up after splitting the range into this many
+** parts...
+*/
+#define QUAD_MAX_SEGMENTS                       4096
+
+/*
+** Tanh-sinh gives up after halving the step this many times...
+*/
+#define QUAD_MAX_LEVELS                         12
+
+/*
+** Points are only shared out between threads in runs of at least this
+** many, fewer are quicker to do than to hand over...
+*/
+#define QUAD_MIN_POINTS_PER_THREAD              8
+
+/*
+** The integral of the program from a to b with respect to the named
+** variable, and an estimate of its error...
+*/
+void        quadIntegrate(
+                    mpfr_t result,
+                    mpfr_t error,
+                    const program_t * program,
+                    const string & variable,
+                    mpfr_t a,
+                    mpfr_t b);
+
+#endif
@@ -0,0 +1,199 @@
+#include <vector>
+#include <deque>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "rolling.h"
+
+using namespace std;
+
+static inline double _sample(rolling_t * r, uint64_t index) {
+    return r->samples[index % r->window];
+}
+
+void rolInit(rolling_t * r, size_t window, double alpha) {
+    r->window = (window > 0 ? window : 1);
+    r->alpha = (alpha > 0.0 && alpha <= 1.0 ? alpha : 2.0 / (double)(r->window + 1));
+
+    r->count = 0;
+    r->samples.assign(r->window, 0.0);
+
+    r->mean = 0.0;
+    r->m2 = 0.0;
+    r->ema = 0.0;
+
+    r->minQueue.clear();
+    r->maxQueue.clear();
+}
+
+void rolAdd(rolling_t * r, double value) {
+    uint64_t    index = r->count;
+
+    if (r->count < r->window) {
+        /*
+        ** Still filling the window, this is plain Welford...
+        */
+        double delta = value - r->mean;
+
+        r->mean += delta / (double)(r->count + 1);
+        r->m2 += delta * (value - r->mean);
+
+        r->ema = (r->count == 0 ? value : r->ema + r->alpha * (value - r->ema));
+    }
+    else {
+        /*
+        ** The oldest sample leaves as the new one arrives, the window
+        ** size stays the same...
+        */
+        double oldest = _sample(r, index);
+        double oldMean = r->mean;
+
+        r->mean += (value - oldest) / (double)r->window;
+        r->m2 += (value - oldest) * (value - r->mean + oldest - oldMean);
+
+        if (r->m2 < 0.0) {
+            r->m2 = 0.0;
+        }
+
+        r->ema += r->alpha * (value - r->ema);
+    }
+
+    r->samples[index % r->window] = value;
+    r->count++;
+
+    while (!r->minQueue.empty() && _sample(r, r->minQueue.back()) >= value) {
+        r->minQueue.pop_back();
+    }
+
+    while (!r->maxQueue.empty() && _sample(r, r->maxQueue.back()) <= value) {
+        r->maxQueue.pop_back();
+    }
+
+    r->minQueue.push_back(index);
+    r->maxQueue.push_back(index);
+
+    /*
+    ** Drop anything that has fallen out of the window...
+    */
+    while (r->minQueue.front() + r->window <= index) {
+        r->minQueue.pop_front();
+    }
+
+    while (r->maxQueue.front() + r->window <= index) {
+        r->maxQueue.pop_front();
+    }
+}
+
+size_t rolSize(rolling_t * r) {
+    return (r->count < r->window ? (size_t)r->count : r->window);
+}
+
+double rolMean(rolling_t * r) {
+    return r->mean;
+}
+
+/*
+** The sample variance of the window...
+*/
+double rolVariance(rolling_t * r) {
+    size_t n = rolSize(r);
+
+    return (n > 1 ? r->m2 / (double)(n - 1) : 0.0);
+}
+
+double rolMin(rolling_t * r) {
+    return _sample(r, r->minQueue.front());
+}
+
+double rolMax(rolling_t * r) {
+    return _sample(r, r->maxQueue.front());
+}
+
+double rolEMA(rolling_t * r) {
+    return r->ema;
+}
+
+static void _print(rolling_t * r) {
+    printf(
+        "%lu\t%.10g\t%.10g\t%.10g\t%.10g\t%.10g\t%.10g\n",
+        (unsigned long)r->count,
+        _sample(r, r->count - 1),
+        rolMean(r),
+        rolEMA(r),
+        rolMin(r),
+        rolMax(r),
+        rolVariance(r));
+}
+
+/*
+** Read numbers from the stream until it ends, printing a line of
+** statistics every 'interval' samples. A line may hold several numbers
+** separated by spaces or commas, anything that is not a number is
+** counted and skipped...
+*/
+int rolRun(FILE * fptr, size_t window, double alpha, uint64_t interval) {
+    rolling_t       r;
+    char            szLine[ROLLING_MAX_LINE_LENGTH];
+    uint64_t        numSkipped = 0;
+
+    rolInit(&r, window, alpha);
+
+    if (interval == 0) {
+        interval = 1;
+    }
+
+    /*
+    ** Whoever is reading wants each line as soon as it is printed...
+    */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    printf("# window %lu, ema alpha %g\n", (unsigned long)r.window, r.alpha);
+    printf("# n\tvalue\tmean\tema\tmin\tmax\tvar\n");
+
+    while (fgets(szLine, ROLLING_MAX_LINE_LENGTH, fptr) != NULL) {
+        char * p = szLine;
+
+        while (*p) {
+            char * pszEnd;
+            double value;
+
+            while (*p && (isspace(*p) || *p == ',')) {
+                p++;
+            }
+
+            if (*p == 0) {
+                break;
+            }
+
+            value = strtod(p, &pszEnd);
+
+            if (pszEnd == p) {
+                numSkipped++;
+
+                while (*p && !isspace(*p) && *p != ',') {
+                    p++;
+                }
+
+                continue;
+            }
+
+            p = pszEnd;
+
+            rolAdd(&r, value);
+
+            if (r.count % interval == 0) {
+                _print(&r);
+            }
+        }
+    }
+
+    if (numSkipped) {
+        fprintf(stderr, "Skipped %lu fields that were not numbers\n", (unsigned long)numSkipped);
+    }
+
+    return 0;
+}
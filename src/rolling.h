@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+
+using namespace std;
+
+#ifndef __INCL_ROLLING
+#define __INCL_ROLLING
+
+#define ROLLING_DEFAULT_WINDOW              10
+#define ROLLING_DEFAULT_INTERVAL            1
+#define ROLLING_MAX_LINE_LENGTH             4096
+
+/*
+** Statistics over the last 'window' samples of an unbounded stream. The
+** samples in the window are kept in a ring buffer, the mean and variance
+** are updated as one sample enters and the oldest leaves, and the min
+** and max are the fronts of monotonic deques, so every sample costs
+** O(1) amortized however long the stream runs...
+*/
+typedef struct {
+    size_t          window;
+    double          alpha;
+
+    uint64_t        count;
+    vector<double>  samples;
+
+    double          mean;
+    double          m2;
+    double          ema;
+
+    /*
+    ** Indexes (by count) of the samples that may still become the
+    ** min or max of the window...
+    */
+    deque<uint64_t> minQueue;
+    deque<uint64_t> maxQueue;
+}
+rolling_t;
+
+void        rolInit(rolling_t * r, size_t window, double alpha);
+void        rolAdd(rolling_t * r, double value);
+size_t      rolSize(rolling_t * r);
+double      rolMean(rolling_t * r);
+double      rolVariance(rolling_t * r);
+double      rolMin(rolling_t * r);
+double      rolMax(rolling_t * r);
+double      rolEMA(rolling_t * r);
+
+int         rolRun(FILE * fptr, size_t window, double alpha, uint64_t interval);
+
+#endif
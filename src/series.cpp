@@ -0,0 +1,561 @@
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "logger.h"
+#include "threadpool.h"
+#include "series.h"
+
+using namespace std;
+
+#define SERIES_GUARD_BITS                       64L
+
+/*
+** pi = 426880 * sqrt(10005) / sum, each term of the sum adds about
+** log2(640320^3 / 1728) bits...
+*/
+#define CHUDNOVSKY_A                            13591409UL
+#define CHUDNOVSKY_B                            545140134UL
+#define CHUDNOVSKY_C3_OVER_24                   10939058860032000UL
+#define CHUDNOVSKY_BITS_PER_TERM                47.11041313821584
+
+/*
+** The Brent-McMillan sums for Euler's constant need about alpha * n
+** terms, where alpha * (log(alpha) - 1) = 3...
+*/
+#define EULER_ALPHA                             4.970625759544232
+
+/*
+** A binary split series over the terms [a, b), where term k is the
+** product of p(j) / q(j) for j <= k:
+**
+**  P = p(a)...p(b - 1)    Q = q(a)...q(b - 1)    T / Q = sum of the terms
+**
+** and, for sums weighted by a harmonic-like series c(j) / d(j):
+**
+**  D = d(a)...d(b - 1)    C / D = sum of c / d   V / DQ = weighted sum
+*/
+typedef struct _split_t {
+    mpz_t           P;
+    mpz_t           Q;
+    mpz_t           T;
+    mpz_t           D;
+    mpz_t           C;
+    mpz_t           V;
+
+    _split_t() {
+        mpz_inits(P, Q, T, D, C, V, NULL);
+    }
+
+    ~_split_t() {
+        mpz_clears(P, Q, T, D, C, V, NULL);
+    }
+}
+split_t;
+
+typedef void (* split_leaf_t)(split_t * s, unsigned long k, unsigned long n);
+
+/*
+** The most precise value of each constant worked out so far...
+*/
+typedef struct _series_cache_t {
+    mutex           lock;
+    mpfr_t          value;
+    bool            isValid;
+
+    _series_cache_t() : isValid(false) {
+        mpfr_init2(value, MPFR_PREC_MIN);
+    }
+
+    ~_series_cache_t() {
+        mpfr_clear(value);
+    }
+}
+series_cache_t;
+
+static series_cache_t       piCache;
+static series_cache_t       eCache;
+static series_cache_t       eulerCache;
+
+static void _chudnovskyLeaf(split_t * s, unsigned long k, unsigned long n) {
+    if (k == 0) {
+        mpz_set_ui(s->P, 1);
+        mpz_set_ui(s->Q, 1);
+    }
+    else {
+        mpz_set_ui(s->P, 6 * k - 5);
+        mpz_mul_ui(s->P, s->P, 2 * k - 1);
+        mpz_mul_ui(s->P, s->P, 6 * k - 1);
+
+        mpz_set_ui(s->Q, k);
+        mpz_mul_ui(s->Q, s->Q, k);
+        mpz_mul_ui(s->Q, s->Q, k);
+        mpz_mul_ui(s->Q, s->Q, CHUDNOVSKY_C3_OVER_24);
+    }
+
+    mpz_mul_ui(s->T, s->P, CHUDNOVSKY_A + CHUDNOVSKY_B * k);
+
+    if (k & 1) {
+        mpz_neg(s->T, s->T);
+    }
+}
+
+/*
+** e = sum of 1 / k!...
+*/
+static void _eLeaf(split_t * s, unsigned long k, unsigned long n) {
+    mpz_set_ui(s->P, 1);
+    mpz_set_ui(s->Q, (k == 0 ? 1 : k));
+    mpz_set_ui(s->T, 1);
+}
+
+/*
+** Euler's constant = V / DT - log(n), where the terms are (n^k / k!)^2
+** weighted by the harmonic numbers H(k)...
+*/
+static void _eulerLeaf(split_t * s, unsigned long k, unsigned long n) {
+    if (k == 0) {
+        mpz_set_ui(s->P, 1);
+        mpz_set_ui(s->Q, 1);
+        mpz_set_ui(s->T, 1);
+        mpz_set_ui(s->D, 1);
+        mpz_set_ui(s->C, 0);
+        mpz_set_ui(s->V, 0);
+    }
+    else {
+        mpz_set_ui(s->P, n);
+        mpz_mul_ui(s->P, s->P, n);
+        mpz_set_ui(s->Q, k);
+        mpz_mul_ui(s->Q, s->Q, k);
+        mpz_set(s->T, s->P);
+        mpz_set_ui(s->D, k);
+        mpz_set_ui(s->C, 1);
+        mpz_set(s->V, s->P);
+    }
+}
+
+/*
+** The temporaries of one step of combining two runs of terms...
+*/
+typedef struct _combine_t {
+    split_t *       l;
+    split_t *       r;
+    mpz_t           d;
+    mpz_t           e;
+    mpz_t           f;
+
+    _combine_t() : l(NULL), r(NULL) {
+        mpz_inits(d, e, f, NULL);
+    }
+
+    _combine_t(const _combine_t &) = delete;
+
+    ~_combine_t() {
+        mpz_clears(d, e, f, NULL);
+    }
+}
+combine_t;
+
+static void _run(vector<function<void()>> & jobs, bool isParallel) {
+    if (!isParallel) {
+        for (auto & job : jobs) {
+            job();
+        }
+
+        return;
+    }
+
+    ThreadPool::getShared().runEach(jobs.size(), [&](size_t i) {
+        jobs[i]();
+    });
+}
+
+/*
+** Fold each r, the terms to the right, into its l. The products in each
+** step only read what the others in the step do not write, so near the
+** top of the tree, where the numbers are biggest, the products of every
+** pair in a level are worked out in parallel...
+*/
+static void _combine(vector<combine_t> & steps, bool hasHarmonic, bool isParallel) {
+    vector<function<void()>>    jobs;
+
+    for (combine_t & step : steps) {
+        combine_t * c = &step;
+        split_t *   l = step.l;
+        split_t *   r = step.r;
+
+        jobs.push_back([=] { mpz_mul(r->P, l->P, r->P); });
+        jobs.push_back([=] { mpz_mul(l->Q, l->Q, r->Q); });
+        jobs.push_back([=] { mpz_mul(l->T, l->T, r->Q); });
+        jobs.push_back([=] { mpz_mul(r->T, l->P, r->T); });
+
+        if (hasHarmonic) {
+            jobs.push_back([=] { mpz_mul(l->V, l->V, r->D); });
+            jobs.push_back([=] { mpz_mul(r->V, l->D, r->V); });
+            jobs.push_back([=] { mpz_mul(c->e, l->C, r->D); });
+            jobs.push_back([=] { mpz_mul(r->C, l->D, r->C); });
+            jobs.push_back([=] { mpz_mul(c->d, l->D, r->D); });
+        }
+    }
+
+    _run(jobs, isParallel);
+
+    jobs.clear();
+
+    for (combine_t & step : steps) {
+        combine_t * c = &step;
+        split_t *   l = step.l;
+        split_t *   r = step.r;
+
+        jobs.push_back([=] { mpz_add(l->T, l->T, r->T); });
+
+        if (hasHarmonic) {
+            jobs.push_back([=] { mpz_mul(l->V, l->V, r->Q); });
+            jobs.push_back([=] { mpz_mul(r->V, r->V, l->P); });
+            jobs.push_back([=] { mpz_mul(c->f, c->e, r->T); });
+            jobs.push_back([=] { mpz_add(l->C, c->e, r->C); });
+        }
+    }
+
+    _run(jobs, isParallel);
+
+    for (combine_t & step : steps) {
+        mpz_swap(step.l->P, step.r->P);
+
+        if (hasHarmonic) {
+            mpz_add(step.l->V, step.l->V, step.r->V);
+            mpz_add(step.l->V, step.l->V, step.f);
+            mpz_swap(step.l->D, step.d);
+        }
+    }
+}
+
+static void _split(
+            split_t * s,
+            unsigned long a,
+            unsigned long b,
+            split_leaf_t leaf,
+            unsigned long n,
+            bool hasHarmonic)
+{
+    split_t             r;
+    unsigned long       m;
+
+    if (b - a == 1) {
+        leaf(s, a, n);
+        return;
+    }
+
+    m = a + (b - a) / 2;
+
+    _split(s, a, m, leaf, n, hasHarmonic);
+    _split(&r, m, b, leaf, n, hasHarmonic);
+
+    vector<combine_t> steps(1);
+
+    steps[0].l = s;
+    steps[0].r = &r;
+
+    _combine(steps, hasHarmonic, false);
+}
+
+/*
+** The terms are cut into 2^depth runs that are split on the shared pool,
+** then the runs are combined a level at a time, with the products of
+** each level shared out between the pool...
+*/
+static void _splitParallel(
+            split_t * s,
+            unsigned long a,
+            unsigned long b,
+            split_leaf_t leaf,
+            unsigned long n,
+            bool hasHarmonic,
+            int depth)
+{
+    unsigned long numRuns = min(1UL << depth, b - a);
+
+    if (numRuns < 2) {
+        _split(s, a, b, leaf, n, hasHarmonic);
+        return;
+    }
+
+    vector<split_t> runs(numRuns);
+
+    ThreadPool::getShared().runEach(numRuns, [&](size_t i) {
+        _split(&runs[i], a + (b - a) * i / numRuns, a + (b - a) * (i + 1) / numRuns, leaf, n, hasHarmonic);
+    });
+
+    for (unsigned long width = 1;width < numRuns;width <<= 1) {
+        vector<combine_t>   steps((numRuns - width + (width << 1) - 1) / (width << 1));
+        size_t              i = 0;
+
+        for (unsigned long c = 0;c + width < numRuns;c += width << 1) {
+            steps[i].l = &runs[c];
+            steps[i].r = &runs[c + width];
+            i++;
+        }
+
+        _combine(steps, hasHarmonic, true);
+    }
+
+    mpz_swap(s->P, runs[0].P);
+    mpz_swap(s->Q, runs[0].Q);
+    mpz_swap(s->T, runs[0].T);
+    mpz_swap(s->D, runs[0].D);
+    mpz_swap(s->C, runs[0].C);
+    mpz_swap(s->V, runs[0].V);
+}
+
+static int _threadDepth(void) {
+    int     numThreads = ThreadPool::getDefaultSize();
+    int     depth = 0;
+
+    while ((1 << depth) < numThreads && depth < SERIES_MAX_THREAD_DEPTH) {
+        depth++;
+    }
+
+    return depth;
+}
+
+static void _computePi(mpfr_t result) {
+    split_t             s;
+    mpfr_t              t;
+    mpfr_prec_t         bits = mpfr_get_prec(result);
+    unsigned long       numTerms = (unsigned long)((double)bits / CHUDNOVSKY_BITS_PER_TERM) + 2;
+
+    _splitParallel(&s, 0, numTerms, _chudnovskyLeaf, 0, false, _threadDepth());
+
+    mpfr_init2(t, bits);
+
+    mpfr_sqrt_ui(result, 10005, MPFR_RNDN);
+    mpfr_mul_ui(result, result, 426880, MPFR_RNDN);
+    mpfr_set_z(t, s.Q, MPFR_RNDN);
+    mpfr_mul(result, result, t, MPFR_RNDN);
+    mpfr_set_z(t, s.T, MPFR_RNDN);
+    mpfr_div(result, result, t, MPFR_RNDN);
+
+    mpfr_clear(t);
+}
+
+static void _computeE(mpfr_t result) {
+    split_t             s;
+    mpfr_t              t;
+    mpfr_prec_t         bits = mpfr_get_prec(result);
+    unsigned long       numTerms = 2;
+    double              log2Factorial = 0.0;
+
+    /*
+    ** Enough terms for 1 / n! to be below the precision...
+    */
+    while (log2Factorial < (double)bits) {
+        log2Factorial += log2((double)numTerms);
+        numTerms++;
+    }
+
+    _splitParallel(&s, 0, numTerms, _eLeaf, 0, false, _threadDepth());
+
+    mpfr_init2(t, bits);
+
+    mpfr_set_z(result, s.T, MPFR_RNDN);
+    mpfr_set_z(t, s.Q, MPFR_RNDN);
+    mpfr_div(result, result, t, MPFR_RNDN);
+
+    mpfr_clear(t);
+}
+
+static void _computeEuler(mpfr_t result) {
+    split_t             s;
+    mpfr_t              t;
+    mpfr_prec_t         bits = mpfr_get_prec(result);
+
+    /*
+    ** The error is about exp(-4n)...
+    */
+    unsigned long       n = (unsigned long)ceil((double)bits * M_LN2 / 4.0) + 1;
+    unsigned long       numTerms = (unsigned long)ceil(EULER_ALPHA * (double)n) + 1;
+
+    _splitParallel(&s, 0, numTerms, _eulerLeaf, n, true, _threadDepth());
+
+    mpfr_init2(t, bits);
+
+    mpfr_set_z(result, s.V, MPFR_RNDN);
+    mpfr_set_z(t, s.D, MPFR_RNDN);
+    mpfr_div(result, result, t, MPFR_RNDN);
+    mpfr_set_z(t, s.T, MPFR_RNDN);
+    mpfr_div(result, result, t, MPFR_RNDN);
+    mpfr_log_ui(t, n, MPFR_RNDN);
+    mpfr_sub(result, result, t, MPFR_RNDN);
+
+    mpfr_clear(t);
+}
+
+/*
+** Make the directory and any of its parents that are missing...
+*/
+static bool _makeDirectory(const string & path) {
+    for (size_t i = 1;i <= path.length();i++) {
+        if (i == path.length() || path[i] == '/') {
+            string dir = path.substr(0, i);
+
+            if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool _getCachePath(string & path, const char * pszName, mpfr_prec_t bits) {
+    const char *    pszDir = getenv(SERIES_CACHE_DIR_ENV);
+    string          dir;
+
+    if (pszDir != NULL) {
+        dir.assign(pszDir);
+    }
+    else if ((pszDir = getenv("XDG_CACHE_HOME")) != NULL) {
+        dir.assign(pszDir).append("/ccalc");
+    }
+    else if ((pszDir = getenv("HOME")) != NULL) {
+        dir.assign(pszDir).append("/.cache/ccalc");
+    }
+    else {
+        return false;
+    }
+
+    if (!_makeDirectory(dir)) {
+        lgLogError("Failed to create the cache directory '%s': %s", dir.c_str(), strerror(errno));
+        return false;
+    }
+
+    path = dir + '/' + pszName + '-' + to_string((long)bits) + ".hex";
+
+    return true;
+}
+
+static bool _load(const char * pszName, mpfr_t value) {
+    string      path;
+    FILE *      f;
+    bool        isLoaded;
+
+    if (!_getCachePath(path, pszName, mpfr_get_prec(value))) {
+        return false;
+    }
+
+    f = fopen(path.c_str(), "r");
+
+    if (f == NULL) {
+        return false;
+    }
+
+    isLoaded = (mpfr_inp_str(value, f, 16, MPFR_RNDN) != 0 && mpfr_number_p(value));
+
+    fclose(f);
+
+    return isLoaded;
+}
+
+/*
+** Written to a temporary file first, so that another process never sees
+** half a constant. Hex is exact, the file reads back to the same bits...
+*/
+static void _save(const char * pszName, mpfr_t value) {
+    string      path;
+    string      tempPath;
+    FILE *      f;
+
+    if (!_getCachePath(path, pszName, mpfr_get_prec(value))) {
+        return;
+    }
+
+    tempPath = path + ".tmp." + to_string((long)getpid());
+
+    f = fopen(tempPath.c_str(), "w");
+
+    if (f == NULL) {
+        lgLogError("Failed to save '%s': %s", tempPath.c_str(), strerror(errno));
+        return;
+    }
+
+    bool isWritten = (mpfr_out_str(f, 16, 0, value, MPFR_RNDN) != 0);
+
+    if (fclose(f) != 0 || !isWritten || rename(tempPath.c_str(), path.c_str()) != 0) {
+        lgLogError("Failed to save '%s'", path.c_str());
+        unlink(tempPath.c_str());
+    }
+}
+
+/*
+** Threads wanting the same constant wait for the first to work it out,
+** which is then kept in memory and, if it is big, on disk...
+*/
+static void _getConstant(
+            mpfr_t result,
+            series_cache_t * cache,
+            const char * pszName,
+            void (* compute)(mpfr_t))
+{
+    mpfr_prec_t         bits = mpfr_get_prec(result) + SERIES_GUARD_BITS;
+    lock_guard<mutex>   lock(cache->lock);
+
+    if (cache->isValid && mpfr_get_prec(cache->value) >= bits) {
+        mpfr_set(result, cache->value, MPFR_RNDN);
+        return;
+    }
+
+    mpfr_set_prec(cache->value, bits);
+
+    if (bits < SERIES_CACHE_MIN_BITS || !_load(pszName, cache->value)) {
+        compute(cache->value);
+
+        if (bits >= SERIES_CACHE_MIN_BITS) {
+            _save(pszName, cache->value);
+        }
+    }
+
+    cache->isValid = true;
+
+    mpfr_set(result, cache->value, MPFR_RNDN);
+}
+
+void serPi(mpfr_t result) {
+    if (mpfr_get_prec(result) < SERIES_MIN_BITS) {
+        mpfr_const_pi(result, MPFR_RNDN);
+    }
+    else {
+        _getConstant(result, &piCache, "pi", _computePi);
+    }
+}
+
+void serE(mpfr_t result) {
+    if (mpfr_get_prec(result) < SERIES_MIN_BITS) {
+        mpfr_set_ui(result, 1, MPFR_RNDN);
+        mpfr_exp(result, result, MPFR_RNDN);
+    }
+    else {
+        _getConstant(result, &eCache, "e", _computeE);
+    }
+}
+
+void serEuler(mpfr_t result) {
+    if (mpfr_get_prec(result) < SERIES_MIN_BITS) {
+        mpfr_const_euler(result, MPFR_RNDN);
+    }
+    else {
+        _getConstant(result, &eulerCache, "euler", _computeEuler);
+    }
+}
@@ -0,0 +1,34 @@
+#include <gmp.h>
+#include <mpfr.h>
+
+#ifndef __INCL_SERIES
+#define __INCL_SERIES
+
+/*
+** Below this many bits MPFR's own constants are quicker than starting
+** threads...
+*/
+#define SERIES_MIN_BITS                         (1L << 16)
+
+/*
+** Constants of at least this many bits are saved to disk, and loaded
+** from there the next time they are needed...
+*/
+#define SERIES_CACHE_MIN_BITS                   (1L << 18)
+
+/*
+** Series are split between threads down to this depth, 2^depth parts...
+*/
+#define SERIES_MAX_THREAD_DEPTH                 6
+
+/*
+** The directory the constants are saved in, otherwise they go in
+** $XDG_CACHE_HOME/ccalc or $HOME/.cache/ccalc...
+*/
+#define SERIES_CACHE_DIR_ENV                    "CCALC_CACHE_DIR"
+
+void        serPi(mpfr_t result);
+void        serE(mpfr_t result);
+void        serEuler(mpfr_t result);
+
+#endif
@@ -0,0 +1,1055 @@
+#include <string>
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "logger.h"
+#include "calc_error.h"
+#include "calculator.h"
+#include "system.h"
+#include "utils.h"
+#include "threadpool.h"
+#include "server.h"
+
+using namespace std;
+
+/*
+** epoll user data for the two descriptors that are not connections...
+*/
+#define ID_LISTENER                     0
+#define ID_WAKEUP                       1
+#define ID_FIRST_CONNECTION             2
+
+#define REQUEST_SINGLE                  0
+#define REQUEST_BATCH                   1
+#define REQUEST_VECTOR                  2
+#define REQUEST_INVALID                 3
+
+typedef struct {
+    uint64_t            sequence;
+    string              tag;
+    int                 type;
+    string              body;
+    size_t              numItems;
+    vector<string>      items;
+}
+request_t;
+
+/*
+** Everything a connection can change, so that one client setting hex
+** mode or storing to memory does not affect any other. The settings
+** are only changed by a command, and a command never runs alongside
+** any other request from the same connection...
+*/
+typedef struct {
+    system_state_t      state;
+    int                 radix;
+    bool                doFormat;
+
+    mutex               resultLock;
+    uint64_t            resultSequence;
+    value_t             result;
+}
+session_t;
+
+typedef struct {
+    uint64_t            id;
+    int                 fd;
+    int                 numInFlight;
+    bool                isExclusive;
+    bool                isEndOfInput;
+    bool                isFailed;
+    bool                isCollecting;
+    uint64_t            nextSequence;
+    string              inBuffer;
+    string              outBuffer;
+    request_t           frame;
+    deque<request_t>    pending;
+    session_t           session;
+}
+connection_t;
+
+typedef struct {
+    uint64_t            connectionId;
+    bool                isExclusive;
+    string              response;
+}
+completion_t;
+
+/*
+** A batch or vector request is split into chunks that are run in
+** parallel, the last chunk to finish sends the whole response...
+*/
+typedef struct {
+    uint64_t                connectionId;
+    bool                    isExclusive;
+    int                     wakeFd;
+    string                  header;
+    session_t *             session;
+    shared_ptr<program_t>   program;
+    vector<string>          items;
+    vector<string>          responses;
+    atomic<size_t>          remainingChunks;
+}
+batch_t;
+
+static volatile sig_atomic_t                            isRunning = 1;
+
+static mutex                                            cacheLock;
+static unordered_map<string, shared_ptr<program_t>>     programCache;
+
+static mutex                                            completionLock;
+static vector<completion_t>                             completions;
+
+static void _handleSignal(int sig) {
+    isRunning = 0;
+}
+
+/*
+** Compiled programs are shared between all connections, the same
+** calculation sent by many clients is only ever parsed once...
+*/
+static shared_ptr<program_t> _getProgram(const string & expression, int radix) {
+    string key = 
+                to_string(radix) + ':' + 
+                (getWordSigned() ? 's' : 'u') + to_string(getWordSize()) + ':' + 
+                (getExact() ? 'q' : 'r') + ':' + 
+                to_string((long)getBasePrecision()) + ':' + 
+                expression;
+
+    {
+        lock_guard<mutex> lock(cacheLock);
+
+        auto cached = programCache.find(key);
+
+        if (cached != programCache.end()) {
+            return cached->second;
+        }
+    }
+
+    shared_ptr<program_t> program = make_shared<program_t>();
+
+    compile(program.get(), expression.c_str(), radix);
+
+    lock_guard<mutex> lock(cacheLock);
+
+    if (programCache.size() >= SERVER_PROGRAM_CACHE_SIZE) {
+        programCache.clear();
+    }
+
+    programCache[key] = program;
+
+    return program;
+}
+
+static void _sessionInit(session_t * s) {
+    sysInitState(&s->state);
+
+    s->radix = DECIMAL;
+    s->doFormat = false;
+    s->resultSequence = 0;
+
+    s->result = newValue();
+    mpfr_set_zero(s->result->v, 1);
+}
+
+static void _sessionFree(session_t * s) {
+    s->result.reset();
+}
+
+static bool _isCommand(const string & request) {
+    static const char * commands[] = {
+        "setp", "fmton", "fmtoff", "exacton", "exactoff", "memst", "memclr", "clrall", "dec", "hex", "oct", "bin", "base", "word", "sword", NULL
+    };
+
+    for (int i = 0;commands[i] != NULL;i++) {
+        if (Utils::isCommand(request.c_str(), commands[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+** Bindings are given as name=value pairs separated by spaces or commas,
+** the values are numbers in the connection's current mode...
+*/
+static void _parseBindings(const string & line, int radix, bindings_t & bindings) {
+    size_t      start = 0;
+
+    bindings.clear();
+
+    while (start < line.length()) {
+        size_t end = line.find_first_of(" \t,", start);
+
+        if (end == string::npos) {
+            end = line.length();
+        }
+
+        if (end > start) {
+            string binding = line.substr(start, end - start);
+            size_t equals = binding.find('=');
+
+            if (equals == string::npos) {
+                throw calc_error(calc_error::buildMsg("Invalid binding '%s'", binding.c_str()));
+            }
+
+            string name = binding.substr(0, equals);
+            string value = binding.substr(equals + 1);
+
+            if (!Utils::isVariable(name) || value.empty() || !Utils::isOperand(value)) {
+                throw calc_error(calc_error::buildMsg("Invalid binding '%s'", binding.c_str()));
+            }
+
+            bindings[name] = parseValue(value.c_str(), radix);
+        }
+
+        start = end + 1;
+    }
+}
+
+static string _formatResult(session_t * s, const value_t & result) {
+    long        precision = (isIntegerMode(s->radix) ? 0L : (long)getPrecision());
+    string      response(RESPONSE_RESULT);
+
+    appendString(response, result, s->radix, precision, s->doFormat);
+
+    return response;
+}
+
+/*
+** Runs on a worker thread with the thread attached to the session's
+** state. Only the newest calculation to arrive becomes the session's
+** last result, however the calculations happen to finish...
+*/
+static string _calculate(session_t * s, const request_t & request) {
+    string      response;
+
+    try {
+        shared_ptr<program_t> program = _getProgram(request.body, s->radix);
+
+        value_t result = execute(program.get());
+
+        response = _formatResult(s, result);
+
+        lock_guard<mutex> lock(s->resultLock);
+
+        if (request.sequence > s->resultSequence) {
+            s->result = result;
+            s->resultSequence = request.sequence;
+        }
+    }
+    catch (calc_error & e) {
+        response.assign(RESPONSE_ERROR);
+        response.append(e.what());
+    }
+
+    return response;
+}
+
+static string _command(session_t * s, const request_t & request) {
+    const char *        pszRequest = request.body.c_str();
+    string              response(RESPONSE_OK);
+
+    try {
+        if (Utils::isCommand(pszRequest, "setp")) {
+            long precision = strtol(&pszRequest[4], NULL, BASE_10);
+
+            if (precision < 0 || precision > SERVER_MAX_PRECISION) {
+                throw calc_error(calc_error::buildMsg("Precision must be between 0 and %d", SERVER_MAX_PRECISION));
+            }
+
+            setPrecision(precision);
+        }
+        else if (Utils::isCommand(pszRequest, "fmton")) {
+            s->doFormat = true;
+        }
+        else if (Utils::isCommand(pszRequest, "fmtoff")) {
+            s->doFormat = false;
+        }
+        else if (Utils::isCommand(pszRequest, "exacton")) {
+            setExact(true);
+        }
+        else if (Utils::isCommand(pszRequest, "exactoff")) {
+            setExact(false);
+        }
+        else if (Utils::isCommand(pszRequest, "memst")) {
+            memStore(s->result, &pszRequest[5]);
+        }
+        else if (Utils::isCommand(pszRequest, "memclr")) {
+            memClear(&pszRequest[6]);
+        }
+        else if (Utils::isCommand(pszRequest, "clrall")) {
+            memInit();
+        }
+        else if (Utils::isCommand(pszRequest, "word")) {
+            setWordSize(atoi(&pszRequest[4]), false);
+        }
+        else if (Utils::isCommand(pszRequest, "sword")) {
+            setWordSize(atoi(&pszRequest[5]), true);
+        }
+        else if (Utils::isCommand(pszRequest, "dec")) {
+            s->radix = DECIMAL;
+        }
+        else if (Utils::isCommand(pszRequest, "hex")) {
+            s->radix = HEXADECIMAL;
+        }
+        else if (Utils::isCommand(pszRequest, "oct")) {
+            s->radix = OCTAL;
+        }
+        else if (Utils::isCommand(pszRequest, "bin")) {
+            s->radix = BINARY;
+        }
+        else if (Utils::isCommand(pszRequest, "base")) {
+            s->radix = parseRadix(&pszRequest[4]);
+        }
+    }
+    catch (calc_error & e) {
+        response.assign(RESPONSE_ERROR);
+        response.append(e.what());
+    }
+
+    return response;
+}
+
+/*
+** A single request, on the thread attached to the session's state...
+*/
+static string _respond(session_t * s, const request_t & request) {
+    if (_isCommand(request.body)) {
+        return _command(s, request);
+    }
+
+    return _calculate(s, request);
+}
+
+static string _tagResponse(const request_t & request, const string & response) {
+    if (request.tag.empty()) {
+        return response;
+    }
+
+    return request.tag + ' ' + response;
+}
+
+static void _wakeup(int wakeFd) {
+    uint64_t one = 1;
+
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        lgLogError("Failed to wake server loop: %s", strerror(errno));
+    }
+}
+
+static void _complete(uint64_t connectionId, bool isExclusive, const string & response, int wakeFd) {
+    completion_t completion;
+
+    completion.connectionId = connectionId;
+    completion.isExclusive = isExclusive;
+    completion.response = response;
+
+    {
+        lock_guard<mutex> lock(completionLock);
+        completions.push_back(std::move(completion));
+    }
+
+    _wakeup(wakeFd);
+}
+
+static void _runChunk(shared_ptr<batch_t> batch, size_t start, size_t end) {
+    session_t *     s = batch->session;
+    value_t         result;
+    bindings_t      bindings;
+
+    sysSetState(&s->state);
+
+    for (size_t i = start;i < end;i++) {
+        try {
+            if (batch->program) {
+                _parseBindings(batch->items[i], batch->program->radix, bindings);
+                result = execute(batch->program.get(), &bindings);
+            }
+            else {
+                if (_isCommand(batch->items[i])) {
+                    throw calc_error("Commands are not allowed in a batch");
+                }
+
+                shared_ptr<program_t> program = _getProgram(batch->items[i], s->radix);
+
+                result = execute(program.get());
+            }
+
+            batch->responses[i] = _formatResult(s, result);
+        }
+        catch (calc_error & e) {
+            batch->responses[i] = RESPONSE_ERROR;
+            batch->responses[i].append(e.what());
+        }
+    }
+
+    sysSetState(NULL);
+
+    if (--batch->remainingChunks == 0) {
+        string response(batch->header);
+
+        for (string & r : batch->responses) {
+            response.append(1, '\n');
+            response.append(r);
+        }
+
+        _complete(batch->connectionId, batch->isExclusive, response, batch->wakeFd);
+    }
+}
+
+static void _submitBatch(connection_t * c, request_t & request, bool isExclusive, ThreadPool & pool, int wakeFd) {
+    shared_ptr<batch_t> batch = make_shared<batch_t>();
+
+    batch->connectionId = c->id;
+    batch->isExclusive = isExclusive;
+    batch->wakeFd = wakeFd;
+    batch->session = &c->session;
+    batch->items = std::move(request.items);
+    batch->responses.resize(batch->items.size());
+
+    if (request.type == REQUEST_VECTOR) {
+        batch->header = _tagResponse(request, "vector " + to_string(batch->items.size()));
+
+        /*
+        ** How the program is compiled depends on the session's settings...
+        */
+        sysSetState(&c->session.state);
+
+        try {
+            batch->program = _getProgram(request.body, c->session.radix);
+        }
+        catch (calc_error & e) {
+            sysSetState(NULL);
+            _complete(c->id, isExclusive, _tagResponse(request, string(RESPONSE_ERROR) + e.what()), wakeFd);
+            return;
+        }
+
+        sysSetState(NULL);
+    }
+    else {
+        batch->header = _tagResponse(request, "batch " + to_string(batch->items.size()));
+    }
+
+    size_t numChunks = (batch->items.size() + SERVER_BATCH_CHUNK_SIZE - 1) / SERVER_BATCH_CHUNK_SIZE;
+
+    batch->remainingChunks = numChunks;
+
+    for (size_t chunk = 0;chunk < numChunks;chunk++) {
+        size_t start = chunk * SERVER_BATCH_CHUNK_SIZE;
+        size_t end = min(start + SERVER_BATCH_CHUNK_SIZE, batch->items.size());
+
+        pool.submit([batch, start, end] {
+            _runChunk(batch, start, end);
+        });
+    }
+}
+
+/*
+** Untagged requests and commands are answered strictly in order: they
+** wait for everything before them to finish and hold back everything
+** after them. Tagged calculations, batches and vectors are run as soon
+** as they arrive and may be answered in any order...
+*/
+static void _dispatch(connection_t * c, ThreadPool & pool, int wakeFd) {
+    while (!c->pending.empty() && !c->isExclusive && c->numInFlight < SERVER_MAX_IN_FLIGHT) {
+        request_t & request = c->pending.front();
+
+        bool isExclusive =
+                    request.tag.empty() || 
+                    (request.type == REQUEST_SINGLE && _isCommand(request.body));
+
+        if (isExclusive && c->numInFlight > 0) {
+            break;
+        }
+
+        if (request.type == REQUEST_INVALID) {
+            c->outBuffer.append(_tagResponse(request, string(RESPONSE_ERROR) + request.body));
+            c->outBuffer.append(1, '\n');
+
+            c->pending.pop_front();
+            continue;
+        }
+
+        c->numInFlight++;
+        c->isExclusive = isExclusive;
+
+        if (request.type == REQUEST_SINGLE) {
+            uint64_t id = c->id;
+            session_t * session = &c->session;
+            request_t r = std::move(request);
+
+            pool.submit([id, session, r, isExclusive, wakeFd] {
+                string response;
+
+                sysSetState(&session->state);
+
+                response = _respond(session, r);
+
+                sysSetState(NULL);
+
+                _complete(id, isExclusive, _tagResponse(r, response), wakeFd);
+            });
+        }
+        else {
+            _submitBatch(c, request, isExclusive, pool, wakeFd);
+        }
+
+        c->pending.pop_front();
+    }
+}
+
+static void _closeConnection(int epollFd, unordered_map<uint64_t, connection_t *> & connections, connection_t * c) {
+    lgLogStatus("Closing connection %lu", (unsigned long)c->id);
+
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+
+    connections.erase(c->id);
+
+    _sessionFree(&c->session);
+    delete c;
+}
+
+/*
+** Once the client has finished sending, only wait for the socket to
+** drain, otherwise the end of input would be reported over and over...
+*/
+static void _updateEvents(int epollFd, connection_t * c) {
+    struct epoll_event  ev;
+
+    ev.events = (c->isEndOfInput ? 0 : EPOLLIN) | (c->outBuffer.empty() ? 0 : EPOLLOUT);
+    ev.data.u64 = c->id;
+
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/*
+** Write as much of the pending output as the socket will take, and only
+** ask to be told about writability while there is something left over...
+*/
+static bool _flush(int epollFd, connection_t * c) {
+    while (!c->outBuffer.empty()) {
+        ssize_t n = send(c->fd, c->outBuffer.data(), c->outBuffer.length(), MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            return false;
+        }
+
+        c->outBuffer.erase(0, n);
+    }
+
+    _updateEvents(epollFd, c);
+
+    return true;
+}
+
+static bool _isFinished(connection_t * c) {
+    return (c->isEndOfInput && c->numInFlight == 0 && c->pending.empty() && c->outBuffer.empty());
+}
+
+/*
+** A request is either a single line, or a frame header followed by the
+** given number of lines:
+**
+**  [#tag] <calculation or command>
+**  [#tag] batch <n>                then n calculations
+**  [#tag] vector <n> <calculation> then n lines of name=value bindings
+*/
+static void _acceptLine(connection_t * c, const string & line) {
+    if (c->isCollecting) {
+        c->frame.items.push_back(line);
+
+        if (c->frame.items.size() == c->frame.numItems) {
+            c->pending.push_back(std::move(c->frame));
+            c->isCollecting = false;
+        }
+
+        return;
+    }
+
+    if (line.empty()) {
+        return;
+    }
+
+    request_t request;
+
+    request.sequence = ++c->nextSequence;
+    request.type = REQUEST_SINGLE;
+    request.numItems = 0;
+
+    size_t start = 0;
+
+    if (line[0] == '#') {
+        size_t end = line.find_first_of(" \t");
+
+        request.tag = line.substr(0, end);
+        start = line.find_first_not_of(" \t", end);
+
+        if (end == string::npos || start == string::npos) {
+            request.type = REQUEST_INVALID;
+            request.body = "Missing request";
+            c->pending.push_back(std::move(request));
+            return;
+        }
+    }
+
+    request.body = line.substr(start);
+
+    bool isBatch = (request.body.compare(0, 6, "batch ") == 0);
+    bool isVector = (request.body.compare(0, 7, "vector ") == 0);
+
+    if (isBatch || isVector) {
+        char * pszEnd;
+
+        request.numItems = strtoul(request.body.c_str() + (isBatch ? 6 : 7), &pszEnd, BASE_10);
+
+        if (request.numItems == 0 || request.numItems > SERVER_MAX_BATCH_SIZE) {
+            request.type = REQUEST_INVALID;
+            request.body = calc_error::buildMsg("Frame size must be between 1 and %d", SERVER_MAX_BATCH_SIZE);
+            c->pending.push_back(std::move(request));
+            return;
+        }
+
+        if (isVector) {
+            while (isspace(*pszEnd)) {
+                pszEnd++;
+            }
+
+            request.type = REQUEST_VECTOR;
+            request.body.assign(pszEnd);
+        }
+        else {
+            request.type = REQUEST_BATCH;
+        }
+
+        request.items.reserve(request.numItems);
+
+        c->frame = std::move(request);
+        c->isCollecting = true;
+    }
+    else {
+        c->pending.push_back(std::move(request));
+    }
+}
+
+/*
+** Read everything available and queue each complete line as a request.
+** Returns false if the connection has failed...
+*/
+static bool _read(connection_t * c) {
+    char        buffer[SERVER_READ_BUFFER_SIZE];
+
+    while (true) {
+        ssize_t n = read(c->fd, buffer, sizeof(buffer));
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            return false;
+        }
+        else if (n == 0) {
+            c->isEndOfInput = true;
+            break;
+        }
+
+        c->inBuffer.append(buffer, n);
+    }
+
+    size_t start = 0;
+    size_t end;
+
+    while ((end = c->inBuffer.find('\n', start)) != string::npos) {
+        size_t length = end - start;
+
+        if (length > 0 && c->inBuffer[end - 1] == '\r') {
+            length--;
+        }
+
+        _acceptLine(c, c->inBuffer.substr(start, length));
+
+        start = end + 1;
+    }
+
+    c->inBuffer.erase(0, start);
+
+    if (c->inBuffer.length() > SERVER_MAX_REQUEST_LENGTH) {
+        lgLogError("Request on connection %lu is too long", (unsigned long)c->id);
+        return false;
+    }
+
+    return true;
+}
+
+static int _listen(const char * pszSocketPath) {
+    struct sockaddr_un      addr;
+    int                     fd;
+
+    if (strlen(pszSocketPath) >= sizeof(addr.sun_path)) {
+        lgLogError("Socket path '%s' is too long", pszSocketPath);
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        lgLogError("Failed to create socket: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, pszSocketPath, sizeof(addr.sun_path) - 1);
+
+    unlink(pszSocketPath);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        lgLogError("Failed to bind to '%s': %s", pszSocketPath, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (listen(fd, SERVER_LISTEN_BACKLOG) < 0) {
+        lgLogError("Failed to listen on '%s': %s", pszSocketPath, strerror(errno));
+        close(fd);
+        unlink(pszSocketPath);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void _accept(int epollFd, int listenFd, unordered_map<uint64_t, connection_t *> & connections, uint64_t & nextId) {
+    struct epoll_event  ev;
+
+    while (true) {
+        int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                lgLogError("Failed to accept connection: %s", strerror(errno));
+            }
+            break;
+        }
+
+        connection_t * c = new connection_t();
+
+        c->id = nextId++;
+        c->fd = fd;
+        c->isEndOfInput = false;
+        c->isFailed = false;
+        c->isCollecting = false;
+        c->numInFlight = 0;
+        c->isExclusive = false;
+        c->nextSequence = 0;
+
+        _sessionInit(&c->session);
+
+        ev.events = EPOLLIN;
+        ev.data.u64 = c->id;
+
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            lgLogError("Failed to add connection to epoll: %s", strerror(errno));
+            _sessionFree(&c->session);
+            close(fd);
+            delete c;
+            continue;
+        }
+
+        connections[c->id] = c;
+
+        lgLogStatus("Accepted connection %lu", (unsigned long)c->id);
+    }
+}
+
+/*
+** Runs the lines through the same parsing and dispatch as a connection,
+** on a pool of its own, waiting for each completion rather than polling
+** a socket...
+*/
+void srvRespond(const vector<string> & lines, vector<string> & responses) {
+    connection_t *      c = new connection_t();
+    int                 wakeFd = eventfd(0, EFD_CLOEXEC);
+    size_t              start = 0;
+
+    if (wakeFd < 0) {
+        delete c;
+        throw calc_error(calc_error::buildMsg("Failed to create an event: %s", strerror(errno)));
+    }
+
+    c->id = ID_LISTENER;
+    c->fd = -1;
+
+    _sessionInit(&c->session);
+
+    for (const string & line : lines) {
+        _acceptLine(c, line);
+    }
+
+    {
+        ThreadPool pool(ThreadPool::getDefaultSize());
+
+        _dispatch(c, pool, wakeFd);
+
+        while (c->numInFlight > 0) {
+            uint64_t                count;
+            vector<completion_t>    done;
+
+            if (read(wakeFd, &count, sizeof(count)) < 0 && errno != EINTR) {
+                break;
+            }
+
+            {
+                lock_guard<mutex> lock(completionLock);
+
+                for (completion_t & completion : completions) {
+                    if (completion.connectionId == c->id) {
+                        done.push_back(std::move(completion));
+                    }
+                }
+
+                completions.erase(
+                            remove_if(
+                                completions.begin(),
+                                completions.end(),
+                                [c](const completion_t & completion) { return completion.connectionId == c->id; }),
+                            completions.end());
+            }
+
+            for (completion_t & completion : done) {
+                c->numInFlight--;
+
+                if (completion.isExclusive) {
+                    c->isExclusive = false;
+                }
+
+                c->outBuffer.append(completion.response);
+                c->outBuffer.append(1, '\n');
+            }
+
+            _dispatch(c, pool, wakeFd);
+        }
+    }
+
+    close(wakeFd);
+
+    responses.clear();
+
+    while (start < c->outBuffer.length()) {
+        size_t end = c->outBuffer.find('\n', start);
+
+        responses.push_back(c->outBuffer.substr(start, end - start));
+        start = end + 1;
+    }
+
+    _sessionFree(&c->session);
+
+    delete c;
+}
+
+int srvRun(const char * pszSocketPath, int numWorkers) {
+    struct sigaction                            sa;
+    struct epoll_event                          ev;
+    struct epoll_event                          events[SERVER_MAX_EVENTS];
+    unordered_map<uint64_t, connection_t *>     connections;
+    uint64_t                                    nextId = ID_FIRST_CONNECTION;
+    int                                         listenFd;
+    int                                         wakeFd;
+    int                                         epollFd;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = _handleSignal;
+    sigemptyset(&sa.sa_mask);
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    listenFd = _listen(pszSocketPath);
+
+    if (listenFd < 0) {
+        return -1;
+    }
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (wakeFd < 0 || epollFd < 0) {
+        lgLogError("Failed to create server event loop: %s", strerror(errno));
+        close(listenFd);
+        unlink(pszSocketPath);
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = ID_LISTENER;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = ID_WAKEUP;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    lgLogInfo("Serving on '%s' with %d workers", pszSocketPath, numWorkers);
+
+    {
+        ThreadPool pool(numWorkers);
+
+        while (isRunning) {
+            int numEvents = epoll_wait(epollFd, events, SERVER_MAX_EVENTS, -1);
+
+            if (numEvents < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                lgLogError("epoll_wait() failed: %s", strerror(errno));
+                break;
+            }
+
+            for (int i = 0;i < numEvents;i++) {
+                uint64_t id = events[i].data.u64;
+
+                if (id == ID_LISTENER) {
+                    _accept(epollFd, listenFd, connections, nextId);
+                }
+                else if (id == ID_WAKEUP) {
+                    uint64_t            count;
+                    vector<completion_t> done;
+
+                    if (read(wakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                        lgLogError("Failed to read wakeup event: %s", strerror(errno));
+                    }
+
+                    {
+                        lock_guard<mutex> lock(completionLock);
+                        done.swap(completions);
+                    }
+
+                    for (completion_t & completion : done) {
+                        auto it = connections.find(completion.connectionId);
+
+                        if (it == connections.end()) {
+                            continue;
+                        }
+
+                        connection_t * c = it->second;
+
+                        c->numInFlight--;
+
+                        if (completion.isExclusive) {
+                            c->isExclusive = false;
+                        }
+
+                        if (c->isFailed) {
+                            if (c->numInFlight == 0) {
+                                _closeConnection(epollFd, connections, c);
+                            }
+                            continue;
+                        }
+
+                        c->outBuffer.append(completion.response);
+                        c->outBuffer.append(1, '\n');
+
+                        _dispatch(c, pool, wakeFd);
+
+                        if (!_flush(epollFd, c) || _isFinished(c)) {
+                            _closeConnection(epollFd, connections, c);
+                        }
+                    }
+                }
+                else {
+                    auto it = connections.find(id);
+
+                    if (it == connections.end()) {
+                        continue;
+                    }
+
+                    connection_t * c = it->second;
+                    bool isOk = !(events[i].events & (EPOLLERR | EPOLLHUP));
+
+                    if (isOk && (events[i].events & EPOLLIN)) {
+                        isOk = _read(c);
+                    }
+
+                    if (isOk && (events[i].events & EPOLLOUT)) {
+                        isOk = _flush(epollFd, c);
+                    }
+
+                    if (isOk) {
+                        _dispatch(c, pool, wakeFd);
+
+                        isOk = _flush(epollFd, c);
+                    }
+
+                    if (!isOk) {
+                        /*
+                        ** A connection with requests in progress is only
+                        ** closed once the workers have finished with the
+                        ** session, until then just stop listening to it...
+                        */
+                        c->pending.clear();
+                        c->outBuffer.clear();
+                        c->isEndOfInput = true;
+                        c->isFailed = true;
+
+                        epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+                    }
+
+                    if (_isFinished(c)) {
+                        _closeConnection(epollFd, connections, c);
+                    }
+                }
+            }
+        }
+
+        lgLogInfo("Server shutting down");
+    }
+
+    /*
+    ** The pool has been joined, no worker is using any session now...
+    */
+    while (!connections.empty()) {
+        _closeConnection(epollFd, connections, connections.begin()->second);
+    }
+
+    close(epollFd);
+    close(wakeFd);
+    close(listenFd);
+
+    unlink(pszSocketPath);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#ifndef __INCL_SERVER
+#define __INCL_SERVER
+
+#define SERVER_LISTEN_BACKLOG                   64
+#define SERVER_MAX_EVENTS                       64
+#define SERVER_READ_BUFFER_SIZE               4096
+#define SERVER_MAX_REQUEST_LENGTH            65536
+#define SERVER_PROGRAM_CACHE_SIZE             1024
+#define SERVER_MAX_IN_FLIGHT                   256
+#define SERVER_MAX_BATCH_SIZE              1000000
+#define SERVER_BATCH_CHUNK_SIZE                256
+
+/*
+** A connection cannot set more digits than this, so that one request
+** cannot hold a worker for long and a few pipelined ones cannot take
+** over the whole pool...
+*/
+#define SERVER_MAX_PRECISION                 10000
+
+/*
+** Each request is a single line of text, either a calculation or one of
+** the commands below. Each request gets a single line in response:
+**
+**  = <result>      the result of a calculation
+**  ok              a command was accepted
+**  ! <message>     the request failed
+**
+** Commands: setpn, dec, hex, oct, bin, basen, fmton, fmtoff, exacton,
+**           exactoff, memstn, memclrn, clrall, wordn, swordn
+**
+** where n, for memst and memclr, is 0 - 9 or the name of a register and,
+** for base, is 2 - 62...
+**
+** A request may start with a tag, '#' followed by any text without spaces,
+** which is repeated at the start of its response. Tagged calculations are
+** run as soon as they arrive and answered as soon as they finish, so
+** many can be in flight at once. Untagged requests and all commands are
+** answered strictly in order.
+**
+** Many calculations can be sent in one frame:
+**
+**  [#tag] batch <n>                followed by n calculations
+**  [#tag] vector <n> <calculation> followed by n lines of bindings for the
+**                                  calculation's variables, e.g. x=1 y=2
+**
+** the response is 'batch <n>' or 'vector <n>' (tagged as the request)
+** followed by n result lines, in the same order as the frame...
+*/
+#define RESPONSE_RESULT                         "= "
+#define RESPONSE_OK                             "ok"
+#define RESPONSE_ERROR                          "! "
+
+int         srvRun(const char * pszSocketPath, int numWorkers);
+
+/*
+** The lines a new connection would get back for the lines it sent, one
+** for each line of the responses, without a socket...
+*/
+void        srvRespond(const vector<string> & lines, vector<string> & responses);
+
+#endif
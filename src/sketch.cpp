@@ -0,0 +1,200 @@
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <math.h>
+#include <stdint.h>
+
+#include "sketch.h"
+
+using namespace std;
+
+#define SKETCH_CAPACITY_RATIO               (2.0 / 3.0)
+#define SKETCH_MIN_CAPACITY                 2
+
+/*
+** Lower levels hold exponentially fewer values than the top level...
+*/
+static size_t _capacity(sketch_t * s, size_t level) {
+    size_t depth = s->compactors.size() - level - 1;
+    size_t c = (size_t)ceil(SKETCH_K * pow(SKETCH_CAPACITY_RATIO, (double)depth));
+
+    return (c > SKETCH_MIN_CAPACITY ? c : SKETCH_MIN_CAPACITY);
+}
+
+static void _grow(sketch_t * s) {
+    s->compactors.push_back(vector<double>());
+
+    s->maxSize = 0;
+
+    for (size_t h = 0;h < s->compactors.size();h++) {
+        s->maxSize += _capacity(s, h);
+    }
+}
+
+/*
+** xorshift64, the choice of odd or even half only needs to be unbiased...
+*/
+static bool _coinFlip(sketch_t * s) {
+    s->random ^= s->random << 13;
+    s->random ^= s->random >> 7;
+    s->random ^= s->random << 17;
+
+    return (s->random & 1) != 0;
+}
+
+/*
+** Sort the first full level and promote every other value to the level
+** above, where each will count twice as much...
+*/
+static void _compress(sketch_t * s) {
+    for (size_t h = 0;h < s->compactors.size();h++) {
+        if (s->compactors[h].size() >= _capacity(s, h)) {
+            if (h + 1 == s->compactors.size()) {
+                _grow(s);
+            }
+
+            vector<double> & level = s->compactors[h];
+            vector<double> & above = s->compactors[h + 1];
+
+            sort(level.begin(), level.end());
+
+            /*
+            ** With an odd number, the largest stays behind...
+            */
+            double leftOver = level.back();
+            bool hasLeftOver = (level.size() & 1) != 0;
+
+            if (hasLeftOver) {
+                level.pop_back();
+            }
+
+            size_t before = level.size();
+
+            for (size_t i = (_coinFlip(s) ? 1 : 0);i < level.size();i += 2) {
+                above.push_back(level[i]);
+            }
+
+            level.clear();
+
+            if (hasLeftOver) {
+                level.push_back(leftOver);
+            }
+
+            s->size -= before / 2;
+
+            return;
+        }
+    }
+}
+
+static void _weighted(sketch_t * s, vector<pair<double, uint64_t>> & items) {
+    items.clear();
+    items.reserve(s->size);
+
+    for (size_t h = 0;h < s->compactors.size();h++) {
+        for (double v : s->compactors[h]) {
+            items.push_back(make_pair(v, (uint64_t)1 << h));
+        }
+    }
+
+    sort(items.begin(), items.end());
+}
+
+void skInit(sketch_t * s) {
+    s->count = 0;
+    s->size = 0;
+    s->random = 0x9E3779B97F4A7C15ULL;
+
+    s->compactors.clear();
+
+    _grow(s);
+}
+
+void skAdd(sketch_t * s, double value) {
+    s->compactors[0].push_back(value);
+
+    s->count++;
+    s->size++;
+
+    if (s->size >= s->maxSize) {
+        _compress(s);
+    }
+}
+
+/*
+** Sketches of two parts of the data combine into a sketch of the whole,
+** with the same error bound...
+*/
+void skMerge(sketch_t * s, sketch_t * other) {
+    while (s->compactors.size() < other->compactors.size()) {
+        _grow(s);
+    }
+
+    for (size_t h = 0;h < other->compactors.size();h++) {
+        s->compactors[h].insert(s->compactors[h].end(), other->compactors[h].begin(), other->compactors[h].end());
+        s->size += other->compactors[h].size();
+    }
+
+    s->count += other->count;
+
+    while (s->size >= s->maxSize) {
+        size_t before = s->size;
+
+        _compress(s);
+
+        if (s->size == before) {
+            break;
+        }
+    }
+}
+
+/*
+** The value at fraction q (0 - 1) of the way through the data...
+*/
+double skQuantile(sketch_t * s, double q) {
+    vector<pair<double, uint64_t>>  items;
+    uint64_t                        total = 0;
+    uint64_t                        cumulative = 0;
+
+    _weighted(s, items);
+
+    if (items.empty()) {
+        return 0.0;
+    }
+
+    for (auto & item : items) {
+        total += item.second;
+    }
+
+    double target = q * (double)total;
+
+    for (auto & item : items) {
+        cumulative += item.second;
+
+        if ((double)cumulative >= target) {
+            return item.first;
+        }
+    }
+
+    return items.back().first;
+}
+
+/*
+** The fraction (0 - 1) of the data less than or equal to value...
+*/
+double skRank(sketch_t * s, double value) {
+    uint64_t        total = 0;
+    uint64_t        below = 0;
+
+    for (size_t h = 0;h < s->compactors.size();h++) {
+        for (double v : s->compactors[h]) {
+            total += (uint64_t)1 << h;
+
+            if (v <= value) {
+                below += (uint64_t)1 << h;
+            }
+        }
+    }
+
+    return (total > 0 ? (double)below / (double)total : 0.0);
+}
@@ -0,0 +1,37 @@
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+#ifndef __INCL_SKETCH
+#define __INCL_SKETCH
+
+/*
+** A KLL quantile sketch (Karnin, Lang & Liberty, 2016), it keeps a
+** bounded sample of the values seen, each standing in for 2^level of
+** the originals.
+**
+** With k = 200 the rank of any value returned is within 1.65% of the
+** rank asked for (i.e. within 0.0165 * n places), with 99% confidence,
+** however many values are added. The memory used grows only with log(n)
+** and is a few thousand values for any practical n...
+*/
+#define SKETCH_K                                200
+#define SKETCH_RANK_ERROR                       0.0165
+
+typedef struct {
+    uint64_t                    count;
+    uint64_t                    random;
+    size_t                      size;
+    size_t                      maxSize;
+    vector<vector<double>>      compactors;
+}
+sketch_t;
+
+void        skInit(sketch_t * s);
+void        skAdd(sketch_t * s, double value);
+void        skMerge(sketch_t * s, sketch_t * other);
+double      skQuantile(sketch_t * s, double q);
+double      skRank(sketch_t * s, double value);
+
+#endif
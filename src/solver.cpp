@@ -0,0 +1,561 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "logger.h"
+#include "calc_error.h"
+#include "system.h"
+#include "calculator.h"
+#include "derivative.h"
+#include "solver.h"
+
+using namespace std;
+
+/*
+** The bits of the working precision that a step has to be below for the
+** root to be taken as found...
+*/
+#define SOLVE_GUARD_BITS                        16
+
+typedef struct {
+    const program_t *   program;
+    const string *      variable;
+
+    /*
+    ** The highest derivative that can be worked out exactly, 2 for
+    ** Halley's method, 1 for Newton's, 0 for differences...
+    */
+    int                 order;
+}
+equation_t;
+
+static double _evaluateDouble(const equation_t * f, double x) {
+    mpfr_t          v;
+    double          fx;
+
+    mpfr_init2(v, getBasePrecision());
+    mpfr_set_d(v, x, MPFR_RNDN);
+
+    executeAt(v, f->program, *f->variable, v);
+
+    fx = mpfr_get_d(v, MPFR_RNDN);
+
+    mpfr_clear(v);
+
+    return fx;
+}
+
+static bool _isOppositeSign(double fa, double fb) {
+    return ((fa < 0.0 && fb > 0.0) || (fa > 0.0 && fb < 0.0));
+}
+
+/*
+** The step to the root from the first few Taylor coefficients f, f' and
+** f'' / 2, Halley's if there is a second derivative, otherwise Newton's.
+** Halley's step is only taken while it is within a factor of 2 of
+** Newton's, further from the root it can point the wrong way...
+*/
+static double _stepFromTaylor(const double * c, int order) {
+    if (order > 1 && fabs(c[0] * c[2]) < 0.5 * c[1] * c[1]) {
+        double step = c[0] * c[1] / (c[1] * c[1] - c[0] * c[2]);
+
+        if (isfinite(step)) {
+            return step;
+        }
+    }
+
+    return c[0] / c[1];
+}
+
+/*
+** f(x) and the step to the root with doubles, from the derivatives or
+** failing that from a central difference. False if either is not
+** finite...
+*/
+static bool _stepDouble(const equation_t * f, double x, double * fx, double * step) {
+    if (f->order > 0) {
+        double c[3];
+
+        derTaylorDouble(c, f->order, f->program, *f->variable, x);
+
+        *fx = c[0];
+        *step = _stepFromTaylor(c, f->order);
+    }
+    else {
+        double h = cbrt(DBL_EPSILON) * max(1.0, fabs(x));
+
+        *fx = _evaluateDouble(f, x);
+        *step = *fx / ((_evaluateDouble(f, x + h) - _evaluateDouble(f, x - h)) / (2.0 * h));
+    }
+
+    return (isfinite(*fx) && isfinite(*step));
+}
+
+/*
+** Halley's or Newton's method with doubles, each step is halved until it
+** makes f smaller...
+*/
+static bool _newtonDouble(const equation_t * f, double * root) {
+    double      x = *root;
+
+    for (int i = 0;i < SOLVE_MAX_ITERATIONS;i++) {
+        double fx;
+        double step;
+
+        if (!_stepDouble(f, x, &fx, &step)) {
+            return false;
+        }
+
+        if (fx == 0.0) {
+            *root = x;
+            return true;
+        }
+
+        if (fabs(step) <= 4.0 * DBL_EPSILON * max(1.0, fabs(x))) {
+            *root = x - step;
+            return true;
+        }
+
+        int k;
+
+        for (k = 0;k < 30;k++) {
+            double fn = _evaluateDouble(f, x - step);
+
+            if (isfinite(fn) && fabs(fn) < fabs(fx)) {
+                break;
+            }
+
+            step *= 0.5;
+        }
+
+        if (k == 30) {
+            return false;
+        }
+
+        x -= step;
+    }
+
+    return false;
+}
+
+/*
+** Look further and further either side of x for a change of sign...
+*/
+static bool _findBracket(const equation_t * f, double x, double * a, double * b) {
+    double      scale = max(1.0, fabs(x));
+    double      fx = _evaluateDouble(f, x);
+    double      left = x;
+    double      right = x;
+    double      fLeft = fx;
+    double      fRight = fx;
+
+    for (double dx = 0.01 * scale;dx <= SOLVE_MAX_BRACKET_WIDTH * scale;dx *= 2.0) {
+        double fl = _evaluateDouble(f, x - dx);
+        double fr = _evaluateDouble(f, x + dx);
+
+        if (isfinite(fr) && isfinite(fRight) && (_isOppositeSign(fRight, fr) || fr == 0.0)) {
+            *a = right;
+            *b = x + dx;
+            return true;
+        }
+
+        if (isfinite(fl) && isfinite(fLeft) && (_isOppositeSign(fLeft, fl) || fl == 0.0)) {
+            *a = x - dx;
+            *b = left;
+            return true;
+        }
+
+        left = x - dx;
+        right = x + dx;
+        fLeft = fl;
+        fRight = fr;
+    }
+
+    return false;
+}
+
+/*
+** Brent's method with doubles, a and b must bracket the root...
+*/
+static void _brent(const equation_t * f, double a, double b, double * root) {
+    double      fa = _evaluateDouble(f, a);
+    double      fb = _evaluateDouble(f, b);
+    double      c = b;
+    double      fc = fb;
+    double      d = b - a;
+    double      e = d;
+
+    if (!_isOppositeSign(fa, fb) && fa != 0.0 && fb != 0.0) {
+        throw calc_error("The calculation must change sign between the two limits");
+    }
+
+    for (int i = 0;i < SOLVE_MAX_ITERATIONS;i++) {
+        if (_isOppositeSign(fb, fc) == false) {
+            c = a;
+            fc = fa;
+            d = b - a;
+            e = d;
+        }
+
+        if (fabs(fc) < fabs(fb)) {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+
+        double tolerance = 2.0 * DBL_EPSILON * fabs(b) + DBL_MIN;
+        double m = 0.5 * (c - b);
+
+        if (fabs(m) <= tolerance || fb == 0.0) {
+            break;
+        }
+
+        if (fabs(e) >= tolerance && fabs(fa) > fabs(fb)) {
+            double s = fb / fa;
+            double p;
+            double q;
+
+            if (a == c) {
+                p = 2.0 * m * s;
+                q = 1.0 - s;
+            }
+            else {
+                double r = fb / fc;
+
+                q = fa / fc;
+                p = s * (2.0 * m * q * (q - r) - (b - a) * (r - 1.0));
+                q = (q - 1.0) * (r - 1.0) * (s - 1.0);
+            }
+
+            if (p > 0.0) {
+                q = -q;
+            }
+            else {
+                p = -p;
+            }
+
+            if (2.0 * p < min(3.0 * m * q - fabs(tolerance * q), fabs(e * q))) {
+                e = d;
+                d = p / q;
+            }
+            else {
+                d = m;
+                e = m;
+            }
+        }
+        else {
+            d = m;
+            e = m;
+        }
+
+        a = b;
+        fa = fb;
+        b += (fabs(d) > tolerance ? d : (m > 0.0 ? tolerance : -tolerance));
+        fb = _evaluateDouble(f, b);
+    }
+
+    *root = b;
+}
+
+static bool _isBetween(mpfr_t x, mpfr_t a, mpfr_t b) {
+    if (mpfr_lessequal_p(a, b)) {
+        return (mpfr_greaterequal_p(x, a) && mpfr_lessequal_p(x, b));
+    }
+
+    return (mpfr_greaterequal_p(x, b) && mpfr_lessequal_p(x, a));
+}
+
+/*
+** f(x) and the step to the root at the working precision. Without exact
+** derivatives the derivative is a central difference with a step of a
+** third of the bits, good to about two thirds of them, which is plenty
+** for a Newton step to still square the error...
+*/
+static void _step(const equation_t * f, mpfr_t x, mpfr_t fx, mpfr_t step) {
+    if (f->order > 0) {
+        vector<value_t>     c;
+
+        derTaylor(c, f->order, f->program, *f->variable, x);
+
+        mpfr_set(fx, c[0]->v, MPFR_RNDN);
+
+        if (!mpfr_number_p(fx) || mpfr_zero_p(fx)) {
+            return;
+        }
+
+        if (f->order > 1) {
+            mpfr_t  d;
+            bool    isHalley;
+
+            mpfr_init2(d, mpfr_get_prec(x));
+
+            mpfr_sqr(d, c[1]->v, MPFR_RNDN);
+            mpfr_mul(step, c[0]->v, c[2]->v, MPFR_RNDN);
+            mpfr_mul_2ui(step, step, 1, MPFR_RNDN);
+
+            isHalley = (mpfr_cmpabs(step, d) < 0);
+
+            if (isHalley) {
+                mpfr_div_2ui(step, step, 1, MPFR_RNDN);
+                mpfr_sub(d, d, step, MPFR_RNDN);
+                mpfr_mul(step, c[0]->v, c[1]->v, MPFR_RNDN);
+                mpfr_div(step, step, d, MPFR_RNDN);
+            }
+
+            mpfr_clear(d);
+
+            if (isHalley) {
+                return;
+            }
+        }
+
+        mpfr_div(step, c[0]->v, c[1]->v, MPFR_RNDN);
+        return;
+    }
+
+    mpfr_t      h;
+    mpfr_t      xh;
+    mpfr_t      df;
+
+    executeAt(fx, f->program, *f->variable, x);
+
+    if (!mpfr_number_p(fx) || mpfr_zero_p(fx)) {
+        return;
+    }
+
+    mpfr_inits2(mpfr_get_prec(x), h, xh, df, (mpfr_ptr)0);
+
+    mpfr_abs(h, x, MPFR_RNDN);
+
+    if (mpfr_cmp_ui(h, 1) < 0) {
+        mpfr_set_ui(h, 1, MPFR_RNDN);
+    }
+
+    mpfr_div_2si(h, h, getBasePrecision() / 3, MPFR_RNDN);
+
+    mpfr_add(xh, x, h, MPFR_RNDN);
+    executeAt(df, f->program, *f->variable, xh);
+    mpfr_sub(xh, x, h, MPFR_RNDN);
+    executeAt(xh, f->program, *f->variable, xh);
+
+    mpfr_sub(df, df, xh, MPFR_RNDN);
+    mpfr_div(df, df, h, MPFR_RNDN);
+    mpfr_div_2ui(df, df, 1, MPFR_RNDN);
+
+    mpfr_div(step, fx, df, MPFR_RNDN);
+
+    mpfr_clears(h, xh, df, (mpfr_ptr)0);
+}
+
+/*
+** One step at the working precision, kept within the bracket lo to hi,
+** if there is one, by bisecting. Returns true, and leaves the step as it
+** was, if x is already exactly a root...
+*/
+static bool _newtonStep(const equation_t * f, mpfr_t x, mpfr_t step, mpfr_t lo, mpfr_t hi, int signLo) {
+    mpfr_t          fx;
+    mpfr_t          xh;
+    mpfr_t          s;
+
+    mpfr_inits2(mpfr_get_prec(x), fx, xh, s, (mpfr_ptr)0);
+
+    _step(f, x, fx, s);
+
+    if (!mpfr_number_p(fx)) {
+        mpfr_clears(fx, xh, s, (mpfr_ptr)0);
+        throw calc_error("The calculation is not finite near the root");
+    }
+
+    if (lo != NULL) {
+        if (mpfr_sgn(fx) == signLo) {
+            mpfr_set(lo, x, MPFR_RNDN);
+        }
+        else {
+            mpfr_set(hi, x, MPFR_RNDN);
+        }
+    }
+
+    if (mpfr_zero_p(fx)) {
+        mpfr_clears(fx, xh, s, (mpfr_ptr)0);
+        return true;
+    }
+
+    if (!mpfr_number_p(s)) {
+        mpfr_clears(fx, xh, s, (mpfr_ptr)0);
+        throw calc_error("The derivative is zero or not finite near the root");
+    }
+
+    mpfr_set(step, s, MPFR_RNDN);
+    mpfr_sub(xh, x, step, MPFR_RNDN);
+
+    if (lo != NULL && !_isBetween(xh, lo, hi)) {
+        mpfr_add(xh, lo, hi, MPFR_RNDN);
+        mpfr_div_2ui(xh, xh, 1, MPFR_RNDN);
+        mpfr_sub(step, x, xh, MPFR_RNDN);
+    }
+
+    mpfr_set(x, xh, MPFR_RNDN);
+
+    mpfr_clears(fx, xh, s, (mpfr_ptr)0);
+
+    return false;
+}
+
+static bool _isConverged(mpfr_t x, mpfr_t step) {
+    mpfr_t      scale;
+    bool        isConverged;
+
+    if (mpfr_zero_p(step)) {
+        return true;
+    }
+
+    mpfr_init2(scale, mpfr_get_prec(x));
+    mpfr_abs(scale, x, MPFR_RNDN);
+
+    if (mpfr_cmp_ui(scale, 1) < 0) {
+        mpfr_set_ui(scale, 1, MPFR_RNDN);
+    }
+
+    mpfr_div_2si(scale, scale, getBasePrecision() - SOLVE_GUARD_BITS, MPFR_RNDN);
+
+    isConverged = (mpfr_cmpabs(step, scale) <= 0);
+
+    mpfr_clear(scale);
+
+    return isConverged;
+}
+
+/*
+** Halley's or Newton's method from the double root, each step at least
+** doubles the correct digits, so the precision is doubled a step at a time up to
+** the digits wanted, rather than every step being at full precision...
+*/
+static void _refine(mpfr_t root, mpfr_t error, const equation_t * f, double x, mpfr_t lo, mpfr_t hi, int signLo) {
+    precision_guard_t       guard;
+    mpfr_prec_t             digits = getPrecision();
+    vector<mpfr_prec_t>     levels;
+
+    for (mpfr_prec_t d = digits;;d = d / 2 + 1) {
+        levels.push_back(d);
+
+        if ((mpfr_prec_t)ceil((double)d * LOG2_10) + PRECISION_GUARD_BITS <= MIN_BASE_PRECISION || d <= 2) {
+            break;
+        }
+    }
+
+    reverse(levels.begin(), levels.end());
+
+    mpfr_set_d(root, x, MPFR_RNDN);
+    mpfr_set_zero(error, 1);
+
+    for (size_t i = 0;i < levels.size();i++) {
+        bool isLast = (i == 0 || i == levels.size() - 1);
+
+        setPrecision(levels[i]);
+
+        for (int j = 0;j < SOLVE_MAX_ITERATIONS;j++) {
+            bool isRoot = _newtonStep(f, root, error, lo, hi, signLo);
+
+            lgLogDebug("Solve: %ld digits, step %g", (long)levels[i], mpfr_get_d(error, MPFR_RNDN));
+
+            if (isRoot || !isLast || _isConverged(root, error)) {
+                break;
+            }
+
+            if (j == SOLVE_MAX_ITERATIONS - 1) {
+                throw calc_error("The root could not be found to the precision wanted");
+            }
+        }
+    }
+
+    mpfr_abs(error, error, MPFR_RNDN);
+}
+
+/*
+** Some calculations have no second derivative (e.g. gamma) or none at all
+** (e.g. the bitwise operators)...
+*/
+static int _findOrder(const program_t * program, const string & variable, double x) {
+    double      c[3];
+
+    for (int order = 2;order > 0;order--) {
+        try {
+            derTaylorDouble(c, order, program, variable, x);
+
+            return order;
+        }
+        catch (derivative_error & e) {
+            lgLogDebug("Solve: %s", e.what());
+        }
+    }
+
+    return 0;
+}
+
+void solFindRoot(
+            mpfr_t root,
+            mpfr_t error,
+            const program_t * program,
+            const string & variable,
+            mpfr_t a,
+            mpfr_t b)
+{
+    double          x = mpfr_get_d(a, MPFR_RNDN);
+    equation_t      f = { program, &variable, _findOrder(program, variable, x) };
+    double          lo;
+    double          hi;
+    bool            isBracketed;
+
+    if (b != NULL) {
+        lo = x;
+        hi = mpfr_get_d(b, MPFR_RNDN);
+        isBracketed = true;
+    }
+    else if (_newtonDouble(&f, &x)) {
+        isBracketed = false;
+    }
+    else if (_findBracket(&f, x, &lo, &hi)) {
+        isBracketed = true;
+    }
+    else {
+        throw calc_error("No root found near the guess, try giving two limits either side of it");
+    }
+
+    if (!isBracketed) {
+        _refine(root, error, &f, x, NULL, NULL, 0);
+        return;
+    }
+
+    mpfr_t      mlo;
+    mpfr_t      mhi;
+    int         signLo;
+
+    _brent(&f, lo, hi, &x);
+
+    mpfr_inits2(mpfr_get_prec(root), mlo, mhi, (mpfr_ptr)0);
+    mpfr_set_d(mlo, lo, MPFR_RNDN);
+    mpfr_set_d(mhi, hi, MPFR_RNDN);
+
+    executeAt(error, program, variable, mlo);
+    signLo = mpfr_sgn(error);
+
+    try {
+        _refine(root, error, &f, x, (signLo != 0 ? mlo : NULL), mhi, signLo);
+    }
+    catch (calc_error & e) {
+        mpfr_clears(mlo, mhi, (mpfr_ptr)0);
+        throw;
+    }
+
+    mpfr_clears(mlo, mhi, (mpfr_ptr)0);
+}
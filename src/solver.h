@@ -0,0 +1,38 @@
+#include <string>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "calculator.h"
+
+using namespace std;
+
+#ifndef __INCL_SOLVER
+#define __INCL_SOLVER
+
+/*
+** Newton's method or Brent's method give up after this many steps at
+** any one precision...
+*/
+#define SOLVE_MAX_ITERATIONS                    100
+
+/*
+** How far out from the guess to look for a change of sign, as a
+** multiple of the guess (or of 1 if the guess is smaller)...
+*/
+#define SOLVE_MAX_BRACKET_WIDTH                 1.0e6
+
+/*
+** Find x where the program is 0, starting from a guess, or between a and
+** b if b is not NULL, in which case the program must change sign between
+** them. The error is the size of the last step...
+*/
+void        solFindRoot(
+                    mpfr_t root,
+                    mpfr_t error,
+                    const program_t * program,
+                    const string & variable,
+                    mpfr_t a,
+                    mpfr_t b);
+
+#endif
@@ -0,0 +1,439 @@
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "calc_error.h"
+#include "system.h"
+#include "statistics.h"
+
+static void _checkNotEmpty(stats_t * s) {
+    if (s->count == 0) {
+        throw calc_error("No data stored for statistic function");
+    }
+}
+
+/*
+** Add to the sum without rounding, widening it whenever the result
+** would not fit...
+*/
+static void _addExact(mpfr_t sum, mpfr_t value) {
+    mpfr_t          total;
+    mpfr_prec_t     p = mpfr_get_prec(sum);
+
+    mpfr_init2(total, p);
+
+    while (mpfr_add(total, sum, value, MPFR_RNDN) != 0 && p < STAT_MAX_SUM_PRECISION) {
+        p = (p << 1 < STAT_MAX_SUM_PRECISION ? p << 1 : STAT_MAX_SUM_PRECISION);
+        mpfr_set_prec(total, p);
+    }
+
+    mpfr_swap(sum, total);
+    mpfr_clear(total);
+}
+
+/*
+** Keep the value for the order statistics, switching over to the
+** sketch once there are too many to keep...
+*/
+static void _store(stats_t * s, double value) {
+    if (s->isSketched) {
+        skAdd(&s->sketch, value);
+        return;
+    }
+
+    s->values.push_back(value);
+
+    if (s->values.size() > STAT_MAX_STORED_VALUES) {
+        for (double v : s->values) {
+            skAdd(&s->sketch, v);
+        }
+
+        s->values.clear();
+        s->values.shrink_to_fit();
+        s->isSketched = true;
+    }
+}
+
+static void _clearPrecise(vector<__mpfr_struct> & values) {
+    for (__mpfr_struct & v : values) {
+        mpfr_clear(&v);
+    }
+
+    values.clear();
+    values.shrink_to_fit();
+}
+
+static void _storePrecise(vector<__mpfr_struct> & values, mpfr_t value) {
+    __mpfr_struct v;
+
+    mpfr_init2(&v, getBasePrecision());
+    mpfr_set(&v, value, MPFR_RNDN);
+
+    values.push_back(v);
+}
+
+void statInit(stats_t * s) {
+    mpfr_init2(s->sum, getBasePrecision());
+    mpfr_init2(s->mean, getBasePrecision());
+    mpfr_init2(s->m2, getBasePrecision());
+    mpfr_init2(s->min, getBasePrecision());
+    mpfr_init2(s->max, getBasePrecision());
+
+    statClear(s);
+}
+
+void statFree(stats_t * s) {
+    _clearPrecise(s->preciseXs);
+    _clearPrecise(s->preciseYs);
+
+    mpfr_clear(s->max);
+    mpfr_clear(s->min);
+    mpfr_clear(s->m2);
+    mpfr_clear(s->mean);
+    mpfr_clear(s->sum);
+}
+
+void statClear(stats_t * s) {
+    s->count = 0;
+
+    mpfr_set_prec(s->sum, getBasePrecision());
+    mpfr_set_zero(s->sum, 1);
+    mpfr_set_zero(s->mean, 1);
+    mpfr_set_zero(s->m2, 1);
+    mpfr_set_zero(s->min, 1);
+    mpfr_set_zero(s->max, 1);
+
+    s->values.clear();
+    s->values.shrink_to_fit();
+    s->isSketched = false;
+
+    skInit(&s->sketch);
+
+    s->xs.clear();
+    s->xs.shrink_to_fit();
+    s->ys.clear();
+    s->ys.shrink_to_fit();
+
+    _clearPrecise(s->preciseXs);
+    _clearPrecise(s->preciseYs);
+}
+
+/*
+** Welford's method for the mean and the sum of squared differences
+** from the mean, which does not suffer the cancellation of summing
+** the squares...
+*/
+void statAdd(stats_t * s, mpfr_t value) {
+    mpfr_t          delta;
+    mpfr_t          step;
+
+    s->count++;
+
+    _addExact(s->sum, value);
+
+    if (s->count == 1) {
+        mpfr_set(s->min, value, MPFR_RNDN);
+        mpfr_set(s->max, value, MPFR_RNDN);
+    }
+    else {
+        if (mpfr_less_p(value, s->min)) {
+            mpfr_set(s->min, value, MPFR_RNDN);
+        }
+        if (mpfr_greater_p(value, s->max)) {
+            mpfr_set(s->max, value, MPFR_RNDN);
+        }
+    }
+
+    _store(s, mpfr_get_d(value, MPFR_RNDN));
+
+    mpfr_init2(delta, getBasePrecision());
+    mpfr_init2(step, getBasePrecision());
+
+    mpfr_sub(delta, value, s->mean, MPFR_RNDN);
+    mpfr_div_ui(step, delta, s->count, MPFR_RNDN);
+    mpfr_add(s->mean, s->mean, step, MPFR_RNDN);
+
+    mpfr_sub(step, value, s->mean, MPFR_RNDN);
+    mpfr_mul(step, step, delta, MPFR_RNDN);
+    mpfr_add(s->m2, s->m2, step, MPFR_RNDN);
+
+    mpfr_clear(step);
+    mpfr_clear(delta);
+}
+
+/*
+** Combine the statistics of two separate sets of values, as if every
+** value in other had been added to s (Chan, Golub & LeVeque)...
+*/
+void statMerge(stats_t * s, stats_t * other) {
+    mpfr_t          delta;
+    mpfr_t          step;
+    uint64_t        n;
+
+    s->xs.insert(s->xs.end(), other->xs.begin(), other->xs.end());
+    s->ys.insert(s->ys.end(), other->ys.begin(), other->ys.end());
+
+    /*
+    ** The precise pairs are moved rather than copied, other keeps none...
+    */
+    s->preciseXs.insert(s->preciseXs.end(), other->preciseXs.begin(), other->preciseXs.end());
+    s->preciseYs.insert(s->preciseYs.end(), other->preciseYs.begin(), other->preciseYs.end());
+
+    other->preciseXs.clear();
+    other->preciseYs.clear();
+
+    if (other->count == 0) {
+        return;
+    }
+
+    if (s->count == 0) {
+        mpfr_set(s->min, other->min, MPFR_RNDN);
+        mpfr_set(s->max, other->max, MPFR_RNDN);
+    }
+    else {
+        if (mpfr_less_p(other->min, s->min)) {
+            mpfr_set(s->min, other->min, MPFR_RNDN);
+        }
+        if (mpfr_greater_p(other->max, s->max)) {
+            mpfr_set(s->max, other->max, MPFR_RNDN);
+        }
+    }
+
+    _addExact(s->sum, other->sum);
+
+    n = s->count + other->count;
+
+    mpfr_init2(delta, getBasePrecision());
+    mpfr_init2(step, getBasePrecision());
+
+    /*
+    ** mean = mean_a + delta * n_b / n
+    ** m2 = m2_a + m2_b + delta^2 * n_a * n_b / n
+    */
+    mpfr_sub(delta, other->mean, s->mean, MPFR_RNDN);
+
+    mpfr_mul_ui(step, delta, other->count, MPFR_RNDN);
+    mpfr_div_ui(step, step, n, MPFR_RNDN);
+    mpfr_add(s->mean, s->mean, step, MPFR_RNDN);
+
+    mpfr_sqr(step, delta, MPFR_RNDN);
+    mpfr_mul_ui(step, step, s->count, MPFR_RNDN);
+    mpfr_mul_ui(step, step, other->count, MPFR_RNDN);
+    mpfr_div_ui(step, step, n, MPFR_RNDN);
+    mpfr_add(s->m2, s->m2, other->m2, MPFR_RNDN);
+    mpfr_add(s->m2, s->m2, step, MPFR_RNDN);
+
+    mpfr_clear(step);
+    mpfr_clear(delta);
+
+    s->count = n;
+
+    if (other->isSketched) {
+        if (!s->isSketched) {
+            for (double v : s->values) {
+                skAdd(&s->sketch, v);
+            }
+
+            s->values.clear();
+            s->values.shrink_to_fit();
+            s->isSketched = true;
+        }
+
+        skMerge(&s->sketch, &other->sketch);
+    }
+    else {
+        for (double v : other->values) {
+            _store(s, v);
+        }
+    }
+}
+
+void statAddPair(stats_t * s, mpfr_t x, mpfr_t y) {
+    s->xs.push_back(mpfr_get_d(x, MPFR_RNDN));
+    s->ys.push_back(mpfr_get_d(y, MPFR_RNDN));
+
+    _storePrecise(s->preciseXs, x);
+    _storePrecise(s->preciseYs, y);
+}
+
+uint64_t statPairCount(stats_t * s) {
+    return s->xs.size();
+}
+
+uint64_t statCount(stats_t * s) {
+    return s->count;
+}
+
+void statSum(mpfr_t result, stats_t * s) {
+    _checkNotEmpty(s);
+
+    mpfr_set(result, s->sum, MPFR_RNDN);
+}
+
+/*
+** The exact sum divided once is more accurate than the running mean...
+*/
+void statMean(mpfr_t result, stats_t * s) {
+    _checkNotEmpty(s);
+
+    mpfr_div_ui(result, s->sum, s->count, MPFR_RNDN);
+}
+
+/*
+** The sample variance, i.e. divided by n - 1...
+*/
+void statVariance(mpfr_t result, stats_t * s) {
+    if (s->count < 2) {
+        throw calc_error("At least 2 values are needed for the variance");
+    }
+
+    mpfr_div_ui(result, s->m2, s->count - 1, MPFR_RNDN);
+}
+
+void statStdDev(mpfr_t result, stats_t * s) {
+    statVariance(result, s);
+
+    mpfr_sqrt(result, result, MPFR_RNDN);
+}
+
+void statMin(mpfr_t result, stats_t * s) {
+    _checkNotEmpty(s);
+
+    mpfr_set(result, s->min, MPFR_RNDN);
+}
+
+void statMax(mpfr_t result, stats_t * s) {
+    _checkNotEmpty(s);
+
+    mpfr_set(result, s->max, MPFR_RNDN);
+}
+
+/*
+** Whether the order statistics are exact, or estimated from the sketch
+** to within SKETCH_RANK_ERROR...
+*/
+bool statIsExact(stats_t * s) {
+    return !s->isSketched;
+}
+
+/*
+** The value at fraction q (0 - 1) of the way through the sorted data,
+** interpolating between the two nearest values. Selection only needs a
+** partial sort, so this is O(n) rather than O(n log n)...
+*/
+void statQuantile(mpfr_t result, stats_t * s, double q) {
+    _checkNotEmpty(s);
+
+    if (q < 0.0 || q > 1.0) {
+        throw calc_error("Percentile must be between 0 and 100");
+    }
+
+    if (s->isSketched) {
+        mpfr_set_d(result, skQuantile(&s->sketch, q), MPFR_RNDN);
+        return;
+    }
+
+    vector<double> & v = s->values;
+
+    double position = q * (double)(v.size() - 1);
+    size_t lower = (size_t)floor(position);
+
+    nth_element(v.begin(), v.begin() + lower, v.end());
+
+    double value = v[lower];
+
+    if (position > (double)lower && lower + 1 < v.size()) {
+        double next = *min_element(v.begin() + lower + 1, v.end());
+
+        value += (position - (double)lower) * (next - value);
+    }
+
+    mpfr_set_d(result, value, MPFR_RNDN);
+}
+
+/*
+** The most frequent value (the smallest of any tie), returning how
+** many times it occurs...
+*/
+uint64_t statMode(mpfr_t result, stats_t * s) {
+    _checkNotEmpty(s);
+
+    if (s->isSketched) {
+        throw calc_error("The mode is not available for this many values");
+    }
+
+    vector<double> & v = s->values;
+
+    sort(v.begin(), v.end());
+
+    double      mode = v[0];
+    uint64_t    modeCount = 0;
+    size_t      start = 0;
+
+    for (size_t i = 1;i <= v.size();i++) {
+        if (i == v.size() || v[i] != v[start]) {
+            if (i - start > modeCount) {
+                mode = v[start];
+                modeCount = i - start;
+            }
+
+            start = i;
+        }
+    }
+
+    mpfr_set_d(result, mode, MPFR_RNDN);
+
+    return modeCount;
+}
+
+/*
+** Count the values in numBins equal width bins from the minimum to the
+** maximum value...
+*/
+void statHistogram(stats_t * s, int numBins, vector<uint64_t> & counts, double * pLow, double * pWidth) {
+    _checkNotEmpty(s);
+
+    if (numBins < 1 || numBins > STAT_MAX_HISTOGRAM_BINS) {
+        throw calc_error(calc_error::buildMsg("The number of bins must be between 1 and %d", STAT_MAX_HISTOGRAM_BINS));
+    }
+
+    double low = mpfr_get_d(s->min, MPFR_RNDN);
+    double high = mpfr_get_d(s->max, MPFR_RNDN);
+    double width = (high > low ? (high - low) / numBins : 1.0);
+
+    counts.assign(numBins, 0);
+
+    if (s->isSketched) {
+        uint64_t previous = 0;
+
+        for (int b = 0;b < numBins;b++) {
+            uint64_t upTo;
+
+            if (b == numBins - 1) {
+                upTo = s->count;
+            }
+            else {
+                upTo = (uint64_t)llround(skRank(&s->sketch, low + (b + 1) * width) * (double)s->count);
+            }
+
+            counts[b] = (upTo > previous ? upTo - previous : 0);
+            previous = (upTo > previous ? upTo : previous);
+        }
+    }
+    else {
+        for (double v : s->values) {
+            int b = (int)((v - low) / width);
+
+            counts[b < numBins ? (b < 0 ? 0 : b) : numBins - 1]++;
+        }
+    }
+
+    *pLow = low;
+    *pWidth = width;
+}
@@ -0,0 +1,79 @@
+#include <vector>
+#include <stdint.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "sketch.h"
+
+using namespace std;
+
+#ifndef __INCL_STATISTICS
+#define __INCL_STATISTICS
+
+/*
+** The largest the exact sum is allowed to grow to, in bits, before it
+** is rounded like any other value...
+*/
+#define STAT_MAX_SUM_PRECISION                  (1L << 20)
+
+/*
+** Up to this many values are kept (as doubles) for exact order
+** statistics, beyond it they are summarised by a quantile sketch...
+*/
+#define STAT_MAX_STORED_VALUES                  (1UL << 24)
+
+#define STAT_DEFAULT_HISTOGRAM_BINS             10
+#define STAT_MAX_HISTOGRAM_BINS                 100
+
+/*
+** Running statistics over every value added so far, each value is
+** folded in as it arrives so none of the results needs another pass
+** over the data...
+*/
+typedef struct {
+    uint64_t        count;
+
+    mpfr_t          sum;
+    mpfr_t          mean;
+    mpfr_t          m2;
+    mpfr_t          min;
+    mpfr_t          max;
+
+    vector<double>  values;
+    bool            isSketched;
+    sketch_t        sketch;
+
+    /*
+    ** (x, y) pairs are a separate data set, used for the covariance,
+    ** correlation and regression. They are kept as doubles for the fast
+    ** path and at the working precision for the precise one...
+    */
+    vector<double>  xs;
+    vector<double>  ys;
+
+    vector<__mpfr_struct>   preciseXs;
+    vector<__mpfr_struct>   preciseYs;
+}
+stats_t;
+
+void        statInit(stats_t * s);
+void        statFree(stats_t * s);
+void        statClear(stats_t * s);
+void        statAdd(stats_t * s, mpfr_t value);
+void        statMerge(stats_t * s, stats_t * other);
+void        statAddPair(stats_t * s, mpfr_t x, mpfr_t y);
+uint64_t    statPairCount(stats_t * s);
+uint64_t    statCount(stats_t * s);
+void        statSum(mpfr_t result, stats_t * s);
+void        statMean(mpfr_t result, stats_t * s);
+void        statVariance(mpfr_t result, stats_t * s);
+void        statStdDev(mpfr_t result, stats_t * s);
+void        statMin(mpfr_t result, stats_t * s);
+void        statMax(mpfr_t result, stats_t * s);
+bool        statIsExact(stats_t * s);
+void        statQuantile(mpfr_t result, stats_t * s, double q);
+uint64_t    statMode(mpfr_t result, stats_t * s);
+void        statHistogram(stats_t * s, int numBins, vector<uint64_t> & counts, double * pLow, double * pWidth);
+
+#endif
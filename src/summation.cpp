@@ -0,0 +1,399 @@
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "logger.h"
+#include "calc_error.h"
+#include "system.h"
+#include "threadpool.h"
+#include "operator.h"
+#include "calculator.h"
+#include "summation.h"
+
+using namespace std;
+
+/*
+** Richardson's weights for n partial sums grow to about (2e)^(n / 2), so
+** about 0.37 digits are lost to cancellation for each term, and Levin's
+** lose no more. The terms are worked out to that many more digits...
+*/
+#define SUM_DIGITS_LOST_PER_TERM                0.5
+#define SUM_GUARD_DIGITS                        20
+
+typedef struct {
+    const program_t *   program;
+    const string *      index;
+    bool                isProduct;
+    const bindings_t *  bindings;
+}
+summand_t;
+
+static const string     _add("+");
+static const string     _mul("*");
+
+static value_t _term(const summand_t * s, long i) {
+    bindings_t      bindings;
+
+    if (s->bindings != NULL) {
+        bindings = *s->bindings;
+    }
+
+    bindings[*s->index] = newSmall(i);
+
+    return execute(s->program, &bindings);
+}
+
+static value_t _combine(const summand_t * s, const value_t & a, const value_t & b) {
+    return Operator::evaluate((s->isProduct ? _mul : _add), s->program->radix, a, b);
+}
+
+static int _threadDepth(void) {
+    int     numThreads = ThreadPool::getDefaultSize();
+    int     depth = 0;
+
+    while ((1 << depth) < numThreads && depth < SUM_MAX_THREAD_DEPTH) {
+        depth++;
+    }
+
+    return depth;
+}
+
+/*
+** The terms a to b - 1 combined in order up to a block, otherwise the two
+** halves combined...
+*/
+static value_t _reduce(const summand_t * s, long a, long b) {
+    if (b - a <= SUM_BLOCK_TERMS) {
+        value_t r = _term(s, a);
+
+        for (long i = a + 1;i < b;i++) {
+            r = _combine(s, r, _term(s, i));
+        }
+
+        return r;
+    }
+
+    long m = a + (b - a) / 2;
+
+    return _combine(s, _reduce(s, a, m), _reduce(s, m, b));
+}
+
+/*
+** Whether the terms a to b - 1 are reduced as one part, or halved again
+** to share them between more threads...
+*/
+static bool _isPart(long a, long b, int depth) {
+    return (depth <= 0 || b - a < 2 * SUM_MIN_TERMS_PER_THREAD);
+}
+
+static void _split(long a, long b, int depth, vector<pair<long, long>> & parts) {
+    if (_isPart(a, b, depth)) {
+        parts.push_back(make_pair(a, b));
+        return;
+    }
+
+    long m = a + (b - a) / 2;
+
+    _split(a, m, depth - 1, parts);
+    _split(m, b, depth - 1, parts);
+}
+
+/*
+** Combine the results of the parts just as they were split, so the
+** result is the same as _reduce() would give on its own...
+*/
+static value_t _join(const summand_t * s, long a, long b, int depth, const vector<value_t> & results, size_t * next) {
+    if (_isPart(a, b, depth)) {
+        return results[(*next)++];
+    }
+
+    long        m = a + (b - a) / 2;
+    value_t     left = _join(s, a, m, depth - 1, results, next);
+    value_t     right = _join(s, m, b, depth - 1, results, next);
+
+    return _combine(s, left, right);
+}
+
+value_t sumFinite(
+            const program_t * program,
+            const string & index,
+            long lo,
+            long hi,
+            bool isProduct,
+            const bindings_t * bindings)
+{
+    summand_t                   s = { program, &index, isProduct, bindings };
+    int                         depth = _threadDepth();
+    vector<pair<long, long>>    parts;
+    vector<value_t>             results;
+    size_t                      next = 0;
+    long                        n;
+
+    if (hi < lo) {
+        return newSmall(isProduct ? 1 : 0);
+    }
+
+    if (__builtin_sub_overflow(hi, lo, &n) || n == LONG_MAX) {
+        throw calc_error("Too many terms");
+    }
+
+    _split(lo, hi + 1, depth, parts);
+
+    results.resize(parts.size());
+
+    runParallel(parts.size(), [&](size_t i) {
+        results[i] = _reduce(&s, parts[i].first, parts[i].second);
+    });
+
+    return _join(&s, lo, hi + 1, depth, results, &next);
+}
+
+/*
+** The terms lo to lo + n - 1 as real numbers, a block at a time...
+*/
+static void _terms(const summand_t * s, vector<value_t> & terms, long lo) {
+    size_t numBlocks = (terms.size() + SUM_BLOCK_TERMS - 1) / SUM_BLOCK_TERMS;
+
+    runParallel(numBlocks, [&](size_t block) {
+        size_t end = min(terms.size(), (block + 1) * SUM_BLOCK_TERMS);
+
+        for (size_t i = block * SUM_BLOCK_TERMS;i < end;i++) {
+            terms[i] = toReal(_term(s, lo + (long)i));
+        }
+    });
+}
+
+/*
+** Richardson's extrapolation of the partial sums to infinity, assuming
+** the error is a series in 1 / n, which suits series that converge
+** slowly without changing sign. The weights are
+**
+**      (N + k)^N (-1)^(k + N) / (k! (N - k)!)
+**
+** applied to the last N + 1 of 2N + 2 partial sums...
+*/
+static value_t _richardson(const vector<value_t> & partials) {
+    long        N = (long)partials.size() / 2 - 1;
+    value_t     sum = newValue();
+    mpfr_t      c;
+    mpfr_t      t;
+
+    mpfr_inits2(getBasePrecision(), c, t, (mpfr_ptr)0);
+
+    mpfr_ui_pow_ui(c, (unsigned long)N, (unsigned long)N, MPFR_RNDN);
+    mpfr_fac_ui(t, (unsigned long)N, MPFR_RNDN);
+    mpfr_div(c, c, t, MPFR_RNDN);
+
+    if (N & 1) {
+        mpfr_neg(c, c, MPFR_RNDN);
+    }
+
+    mpfr_set_zero(sum->v, 1);
+
+    for (long k = 0;k <= N;k++) {
+        mpfr_fma(sum->v, c, partials[N + k]->v, sum->v, MPFR_RNDN);
+
+        /*
+        ** c(k + 1) / c(k) = (k - N) ((k + N + 1) / (k + N))^N / (k + 1)...
+        */
+        mpfr_set_ui(t, (unsigned long)(k + N + 1), MPFR_RNDN);
+        mpfr_div_ui(t, t, (unsigned long)(k + N), MPFR_RNDN);
+        mpfr_pow_ui(t, t, (unsigned long)N, MPFR_RNDN);
+        mpfr_mul(c, c, t, MPFR_RNDN);
+        mpfr_mul_si(c, c, k - N, MPFR_RNDN);
+        mpfr_div_ui(c, c, (unsigned long)(k + 1), MPFR_RNDN);
+    }
+
+    mpfr_clears(c, t, (mpfr_ptr)0);
+
+    return sum;
+}
+
+/*
+** Levin's u transform of the last half of the partial sums, with the
+** remainder after term m estimated as (m + 1) times the term, which
+** suits alternating series as well as slowly converging ones. Empty if
+** a term is 0...
+*/
+static value_t _levin(const vector<value_t> & partials, const vector<value_t> & deltas) {
+    long        k = (long)partials.size() / 2;
+    long        n = (long)partials.size() - 1 - k;
+    value_t     result = newValue();
+    mpfr_t      numerator;
+    mpfr_t      denominator;
+    mpfr_t      binomial;
+    mpfr_t      w;
+
+    for (long j = 0;j <= k;j++) {
+        if (mpfr_zero_p(deltas[n + j]->v)) {
+            return value_t();
+        }
+    }
+
+    mpfr_inits2(getBasePrecision(), numerator, denominator, binomial, w, (mpfr_ptr)0);
+
+    mpfr_set_zero(numerator, 1);
+    mpfr_set_zero(denominator, 1);
+    mpfr_set_ui(binomial, 1, MPFR_RNDN);
+
+    for (long j = 0;j <= k;j++) {
+        /*
+        ** (-1)^j C(k, j) ((n + j + 1) / (n + k + 1))^(k - 1) / w(n + j),
+        ** where w(m) = (m + 1) delta(m)...
+        */
+        mpfr_set_ui(w, (unsigned long)(n + j + 1), MPFR_RNDN);
+        mpfr_div_ui(w, w, (unsigned long)(n + k + 1), MPFR_RNDN);
+        mpfr_pow_ui(w, w, (unsigned long)(k - 1), MPFR_RNDN);
+        mpfr_mul(w, w, binomial, MPFR_RNDN);
+        mpfr_div_ui(w, w, (unsigned long)(n + j + 1), MPFR_RNDN);
+        mpfr_div(w, w, deltas[n + j]->v, MPFR_RNDN);
+
+        if (j & 1) {
+            mpfr_neg(w, w, MPFR_RNDN);
+        }
+
+        mpfr_fma(numerator, w, partials[n + j]->v, numerator, MPFR_RNDN);
+        mpfr_add(denominator, denominator, w, MPFR_RNDN);
+
+        mpfr_mul_ui(binomial, binomial, (unsigned long)(k - j), MPFR_RNDN);
+        mpfr_div_ui(binomial, binomial, (unsigned long)(j + 1), MPFR_RNDN);
+    }
+
+    mpfr_div(result->v, numerator, denominator, MPFR_RNDN);
+
+    mpfr_clears(numerator, denominator, binomial, w, (mpfr_ptr)0);
+
+    return result;
+}
+
+/*
+** The terms are doubled until one of the estimates (the partial sum
+** itself, Richardson's or Levin's) changes by less than the digits
+** wanted from the last time...
+*/
+static void _extrapolate(mpfr_t result, mpfr_t error, const summand_t * s, long lo, mpfr_prec_t digits) {
+    vector<value_t>     terms;
+    vector<value_t>     partials;
+    vector<value_t>     deltas;
+    value_t             last[3];
+    mpfr_t              tolerance;
+    mpfr_t              difference;
+    mpfr_t              scale;
+
+    mpfr_inits2(getBasePrecision(), tolerance, difference, scale, (mpfr_ptr)0);
+
+    mpfr_set_ui(tolerance, 10, MPFR_RNDN);
+    mpfr_pow_si(tolerance, tolerance, -(long)(digits + 1), MPFR_RNDN);
+
+    for (long numTerms = SUM_MIN_TERMS;;numTerms *= 2) {
+        if (lo > LONG_MAX - numTerms) {
+            mpfr_clears(tolerance, difference, scale, (mpfr_ptr)0);
+            throw calc_error("Too many terms");
+        }
+
+        /*
+        ** The terms are all worked out again, to the digits needed for
+        ** this many...
+        */
+        setPrecision(digits + SUM_GUARD_DIGITS + (mpfr_prec_t)ceil((double)numTerms * SUM_DIGITS_LOST_PER_TERM));
+
+        terms.assign(numTerms, value_t());
+        partials.clear();
+        deltas.clear();
+
+        _terms(s, terms, lo);
+
+        for (long i = 0;i < numTerms;i++) {
+            value_t partial = newValue();
+            value_t delta = newValue();
+
+            if (i == 0) {
+                mpfr_set(partial->v, terms[i]->v, MPFR_RNDN);
+                mpfr_sub_ui(delta->v, partial->v, (s->isProduct ? 1 : 0), MPFR_RNDN);
+            }
+            else {
+                if (s->isProduct) {
+                    mpfr_mul(partial->v, partials[i - 1]->v, terms[i]->v, MPFR_RNDN);
+                }
+                else {
+                    mpfr_add(partial->v, partials[i - 1]->v, terms[i]->v, MPFR_RNDN);
+                }
+
+                mpfr_sub(delta->v, partial->v, partials[i - 1]->v, MPFR_RNDN);
+            }
+
+            partials.push_back(partial);
+            deltas.push_back(delta);
+        }
+
+        value_t estimates[3] = { partials.back(), _richardson(partials), _levin(partials, deltas) };
+        int     best = -1;
+
+        for (int m = 0;m < 3;m++) {
+            if (estimates[m] && last[m] && mpfr_number_p(estimates[m]->v) && mpfr_number_p(last[m]->v)) {
+                mpfr_sub(difference, estimates[m]->v, last[m]->v, MPFR_RNDN);
+                mpfr_abs(difference, difference, MPFR_RNDU);
+
+                if (best < 0 || mpfr_less_p(difference, error)) {
+                    mpfr_set(error, difference, MPFR_RNDU);
+                    best = m;
+                }
+            }
+
+            last[m] = estimates[m];
+        }
+
+        lgLogDebug("Sum: %ld terms, best estimate %d, difference %g", numTerms, best, (best >= 0 ? mpfr_get_d(error, MPFR_RNDN) : 0.0));
+
+        if (best >= 0) {
+            mpfr_abs(scale, estimates[best]->v, MPFR_RNDN);
+
+            if (mpfr_cmp_ui(scale, 1) < 0) {
+                mpfr_set_ui(scale, 1, MPFR_RNDN);
+            }
+
+            mpfr_mul(scale, scale, tolerance, MPFR_RNDN);
+
+            if (mpfr_lessequal_p(error, scale)) {
+                mpfr_set(result, estimates[best]->v, MPFR_RNDN);
+                break;
+            }
+        }
+
+        if (numTerms >= SUM_MAX_TERMS) {
+            mpfr_clears(tolerance, difference, scale, (mpfr_ptr)0);
+
+            throw calc_error(
+                    calc_error::buildMsg(
+                        "The %s did not converge to %ld digits in %ld terms",
+                        (s->isProduct ? "product" : "sum"),
+                        (long)digits,
+                        numTerms));
+        }
+    }
+
+    mpfr_clears(tolerance, difference, scale, (mpfr_ptr)0);
+}
+
+void sumInfinite(
+            mpfr_t result,
+            mpfr_t error,
+            const program_t * program,
+            const string & index,
+            long lo,
+            bool isProduct,
+            const bindings_t * bindings)
+{
+    summand_t           s = { program, &index, isProduct, bindings };
+    precision_guard_t   guard;
+
+    _extrapolate(result, error, &s, lo, getPrecision());
+}
@@ -0,0 +1,66 @@
+#include <string>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "system.h"
+#include "calculator.h"
+
+using namespace std;
+
+#ifndef __INCL_SUMMATION
+#define __INCL_SUMMATION
+
+/*
+** Runs of up to this many terms are added (or multiplied) in order, longer
+** ones are halved and the halves added, so the result does not depend on
+** the number of threads...
+*/
+#define SUM_BLOCK_TERMS                         64
+
+/*
+** Halves of fewer terms than this are not given a thread of their own...
+*/
+#define SUM_MIN_TERMS_PER_THREAD                256
+
+/*
+** Halves are split between threads down to this depth, 2^depth parts...
+*/
+#define SUM_MAX_THREAD_DEPTH                    6
+
+/*
+** An infinite series starts with this many terms, doubled until the
+** extrapolations agree, up to the maximum...
+*/
+#define SUM_MIN_TERMS                           16
+#define SUM_MAX_TERMS                           (1L << 12)
+
+/*
+** The sum (or product) of the program over the named index from lo to
+** hi. Each term is worked out just as a calculation would, so the result
+** is exact in the integer modes, or if the terms are exact. Any other
+** variables are taken from the bindings or the registers...
+*/
+value_t     sumFinite(
+                    const program_t * program,
+                    const string & index,
+                    long lo,
+                    long hi,
+                    bool isProduct,
+                    const bindings_t * bindings = NULL);
+
+/*
+** The same from lo to infinity, the partial sums (or products) are
+** extrapolated with Richardson's method and Levin's u transform, and the
+** result is the one whose estimates agree best...
+*/
+void        sumInfinite(
+                    mpfr_t result,
+                    mpfr_t error,
+                    const program_t * program,
+                    const string & index,
+                    long lo,
+                    bool isProduct,
+                    const bindings_t * bindings = NULL);
+
+#endif
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <math.h>
 #include <ctype.h>
 
 #include <gmp.h>
@@ -18,140 +19,847 @@
 
 using namespace std;
 
-static mpfr_prec_t  precision;
-static string       memory[NUM_MEMORY_LOCATIONS];
+static system_state_t                   defaultState;
+static thread_local system_state_t *    state = &defaultState;
+
+static value_t _zero(void) {
+    value_t zero = newValue();
+
+    mpfr_set_zero(zero->v, 1);
+
+    return zero;
+}
+
+static void _clearMemory(system_state_t * s) {
+    value_t zero = _zero();
+
+    for (int m = 0;m < NUM_MEMORY_LOCATIONS;m++) {
+        s->memory[m] = zero;
+    }
+
+    s->registers.clear();
+}
+
+/*
+** Set up the state of a new session or thread...
+*/
+void sysInitState(system_state_t * s) {
+    s->precision = DEFAULT_PRECISION;
+    s->wordSize = 0;
+    s->isWordSigned = false;
+    s->isExact = false;
+
+    _clearMemory(s);
+}
+
+/*
+** Attach the calling thread to the supplied state, or back to the
+** default state if s is NULL...
+*/
+void sysSetState(system_state_t * s) {
+    state = (s != NULL ? s : &defaultState);
+}
+
+system_state_t * sysGetState(void) {
+    return state;
+}
 
 void setPrecision(mpfr_prec_t p) {
-    precision = p;
+    state->precision = p;
 }
 
 mpfr_prec_t getPrecision(void) {
-    return precision;
+    return state->precision;
 }
 
-void memInit(void) {
-    for (int m = 0;m < NUM_MEMORY_LOCATIONS;m++) {
-        memory[m].assign("0.00");
+mpfr_prec_t getBasePrecision(void) {
+    mpfr_prec_t bits = (mpfr_prec_t)ceil((double)state->precision * LOG2_10) + PRECISION_GUARD_BITS;
+
+    return (bits > MIN_BASE_PRECISION ? bits : MIN_BASE_PRECISION);
+}
+
+/*
+** Sizes other than 8, 16, 32, 64 and 128 bits are allowed, and 0 turns
+** words off...
+*/
+void setWordSize(int bits, bool isSigned) {
+    if (bits < 0 || bits > MAX_WORD_SIZE) {
+        throw calc_error(calc_error::buildMsg("Word size must be between 0 and %d bits", MAX_WORD_SIZE));
     }
+
+    state->wordSize = bits;
+    state->isWordSigned = isSigned;
 }
 
-string memRetrieve(int location) {
-    if (location < 0 || location > NUM_MEMORY_LOCATIONS - 1) {
-        throw calc_error("Memory location out of range. Must be between 0 and 9");
+int getWordSize(void) {
+    return state->wordSize;
+}
+
+bool getWordSigned(void) {
+    return state->isWordSigned;
+}
+
+/*
+** Exact mode only applies to calculations compiled after it is set...
+*/
+void setExact(bool isExact) {
+    state->isExact = isExact;
+}
+
+bool getExact(void) {
+    return state->isExact;
+}
+
+/*
+** Parse the base of a 'basen' command or the --base option...
+*/
+int parseRadix(const char * pszRadix) {
+    char *      pszEnd;
+    long        radix = strtol(pszRadix, &pszEnd, BASE_10);
+
+    if (pszEnd == pszRadix || *pszEnd != 0 || radix < MIN_BASE || radix > MAX_BASE) {
+        throw calc_error(calc_error::buildMsg("Base must be between %d and %d", MIN_BASE, MAX_BASE));
     }
 
-    return memory[location];
+    return (int)radix;
 }
 
-void memStore(string r, int location) {
-    if (location < 0 || location > NUM_MEMORY_LOCATIONS - 1) {
-        throw calc_error("Memory location out of range. Must be between 0 and 9");
+static word_t _wordMask(int bits) {
+    return (bits >= MAX_WORD_SIZE ? ~(word_t)0 : (((word_t)1 << bits) - 1));
+}
+
+/*
+** Cut a word down to the current word size, sign extending it if words
+** are signed...
+*/
+static word_t _wrap(word_t w) {
+    int     bits = (state->wordSize > 0 ? state->wordSize : MAX_WORD_SIZE);
+    word_t  mask = _wordMask(bits);
+
+    w &= mask;
+
+    if (state->isWordSigned && bits < MAX_WORD_SIZE && ((w >> (bits - 1)) & 1)) {
+        w |= ~mask;
+    }
+
+    return w;
+}
+
+value_t newWord(word_t w) {
+    value_t value = make_shared<number_t>(VALUE_WORD);
+
+    value->w = _wrap(w);
+    value->isSigned = state->isWordSigned;
+
+    return value;
+}
+
+static void _wordToInteger(mpz_t z, word_t w, bool isSigned) {
+    bool        isNegative = (isSigned && (sword_t)w < 0);
+    uint64_t    halves[2];
+
+    if (isNegative) {
+        w = -w;
+    }
+
+    halves[0] = (uint64_t)w;
+    halves[1] = (uint64_t)(w >> 64);
+
+    mpz_import(z, 2, -1, sizeof(uint64_t), 0, 0, halves);
+
+    if (isNegative) {
+        mpz_neg(z, z);
+    }
+}
+
+static word_t _integerToWord(mpz_t z) {
+    mpz_t       low;
+    uint64_t    halves[2] = {0, 0};
+
+    /*
+    ** The low 128 bits, in two's complement...
+    */
+    mpz_init(low);
+    mpz_fdiv_r_2exp(low, z, MAX_WORD_SIZE);
+    mpz_export(halves, NULL, -1, sizeof(uint64_t), 0, 0, low);
+    mpz_clear(low);
+
+    return ((word_t)halves[1] << 64) | halves[0];
+}
+
+value_t newValue(void) {
+    return make_shared<number_t>(VALUE_REAL);
+}
+
+value_t newInteger(void) {
+    return make_shared<number_t>(VALUE_INTEGER);
+}
+
+value_t newSmall(int64_t i) {
+    value_t value = make_shared<number_t>(VALUE_SMALL);
+
+    value->i = i;
+
+    return value;
+}
+
+value_t newRational(void) {
+    return make_shared<number_t>(VALUE_RATIONAL);
+}
+
+/*
+** Read a number as the fraction it is written as, e.g. 1.25 is 125/100
+** (or 5/4), an empty value if it is not a plain number...
+*/
+static value_t _parseRational(const char * pszValue, int radix) {
+    string      digits;
+    size_t      numFractionDigits = 0;
+    bool        isFraction = false;
+
+    for (const char * p = pszValue;*p;p++) {
+        if (*p == '.') {
+            if (isFraction) {
+                return value_t();
+            }
+
+            isFraction = true;
+        }
+        else {
+            digits.append(1, *p);
+
+            if (isFraction) {
+                numFractionDigits++;
+            }
+        }
+    }
+
+    value_t value = newRational();
+
+    if (mpz_set_str(mpq_numref(value->q), digits.c_str(), radix) != 0) {
+        return value_t();
     }
-    
-    memory[location].assign(r);
+
+    mpz_ui_pow_ui(mpq_denref(value->q), (unsigned long)radix, (unsigned long)numFractionDigits);
+    mpq_canonicalize(value->q);
+
+    return value;
+}
+
+/*
+** Read a whole number as a small integer, false if it is anything else
+** or too big to fit...
+*/
+static bool _parseSmall(const char * pszValue, int radix, int64_t * result) {
+    const char *    p = pszValue;
+    int64_t         i = 0;
+    bool            isNegative = (*p == '-');
+
+    if (isNegative) {
+        p++;
+    }
+
+    if (*p == 0 || radix > 36) {
+        return false;
+    }
+
+    for (;*p;p++) {
+        int digit;
+
+        if (isdigit(*p)) {
+            digit = *p - '0';
+        }
+        else if (isalpha(*p)) {
+            digit = tolower(*p) - 'a' + 10;
+        }
+        else {
+            return false;
+        }
+
+        if (digit >= radix) {
+            return false;
+        }
+
+        if (__builtin_mul_overflow(i, (int64_t)radix, &i) || __builtin_add_overflow(i, (int64_t)digit, &i)) {
+            return false;
+        }
+    }
+
+    *result = (isNegative ? -i : i);
+
+    return true;
 }
 
-void memClear(int location) {
+/*
+** Numbers are read as exact integers in the integer modes, a number
+** with a fractional part is rounded away from zero. Whole numbers that
+** fit in 64 bits are read as small integers unless there is a word size...
+*/
+value_t parseValue(const char * pszValue, int radix) {
+    if (isIntegerMode(radix) && state->wordSize > 0 && strchr(pszValue, '.') == NULL) {
+        const char *    p = pszValue;
+        word_t          w = 0;
+        bool            isNegative = (*p == '-');
+
+        if (isNegative) {
+            p++;
+        }
+
+        for (;*p;p++) {
+            int digit = (isdigit(*p) ? *p - '0' : tolower(*p) - 'a' + 10);
+
+            if (digit < 0 || digit >= radix) {
+                break;
+            }
+
+            w = w * (word_t)radix + (word_t)digit;
+        }
+
+        return newWord(isNegative ? -w : w);
+    }
+
+    int64_t     i;
+
+    if (_parseSmall(pszValue, radix, &i)) {
+        return newSmall(i);
+    }
+
+    if (!isIntegerMode(radix) && state->isExact) {
+        value_t value = _parseRational(pszValue, radix);
+
+        if (value) {
+            return value;
+        }
+    }
+
+    if (!isIntegerMode(radix)) {
+        value_t value = newValue();
+
+        mpfr_strtofr(value->v, pszValue, NULL, radix, MPFR_RNDA);
+
+        return value;
+    }
+
+    value_t value = newInteger();
+
+    if (strchr(pszValue, '.') != NULL || mpz_set_str(value->z, pszValue, radix) != 0) {
+        mpfr_t      r;
+
+        /*
+        ** Enough bits for every digit...
+        */
+        mpfr_init2(r, getBasePrecision() + (mpfr_prec_t)strlen(pszValue) * 6);
+
+        mpfr_strtofr(r, pszValue, NULL, radix, MPFR_RNDA);
+        mpfr_get_z(value->z, r, MPFR_RNDA);
+
+        mpfr_clear(r);
+    }
+
+    return value;
+}
+
+value_t toReal(const value_t & value) {
+    if (value->type == VALUE_REAL) {
+        return value;
+    }
+
+    if (value->type == VALUE_WORD) {
+        return toReal(toInteger(value));
+    }
+
+    value_t real = newValue();
+
+    if (value->type == VALUE_SMALL) {
+        mpfr_set_si(real->v, (long)value->i, MPFR_RNDA);
+        return real;
+    }
+
+    /*
+    ** The one place a fraction is rounded, to the nearest...
+    */
+    if (value->type == VALUE_RATIONAL) {
+        mpfr_set_q(real->v, value->q, MPFR_RNDN);
+        return real;
+    }
+
+    size_t  bits = mpz_sizeinbase(value->z, 2);
+
+    if ((long)bits > getBasePrecision()) {
+        mpfr_set_prec(real->v, (mpfr_prec_t)bits);
+    }
+
+    mpfr_set_z(real->v, value->z, MPFR_RNDA);
+
+    return real;
+}
+
+/*
+** Anything else becomes a word by keeping its low bits...
+*/
+value_t toWord(const value_t & value) {
+    if (value->type == VALUE_WORD && value->isSigned == state->isWordSigned) {
+        return value;
+    }
+
+    if (value->type == VALUE_WORD) {
+        return newWord(value->w);
+    }
+
+    if (value->type == VALUE_SMALL) {
+        return newWord((word_t)(sword_t)value->i);
+    }
+
+    value_t integer = toInteger(value);
+
+    return newWord(_integerToWord(integer->z));
+}
+
+/*
+** A real number becomes an integer by rounding away from zero, as it
+** always has in the integer modes...
+*/
+value_t toInteger(const value_t & value) {
+    if (value->type == VALUE_INTEGER) {
+        return value;
+    }
+
+    value_t integer = newInteger();
+
+    if (value->type == VALUE_WORD) {
+        _wordToInteger(integer->z, value->w, value->isSigned);
+    }
+    else if (value->type == VALUE_SMALL) {
+        mpz_set_si(integer->z, (long)value->i);
+    }
+    else if (value->type == VALUE_RATIONAL) {
+        if (mpq_sgn(value->q) >= 0) {
+            mpz_cdiv_q(integer->z, mpq_numref(value->q), mpq_denref(value->q));
+        }
+        else {
+            mpz_fdiv_q(integer->z, mpq_numref(value->q), mpq_denref(value->q));
+        }
+    }
+    else if (mpfr_number_p(value->v)) {
+        mpfr_get_z(integer->z, value->v, MPFR_RNDA);
+    }
+
+    return integer;
+}
+
+/*
+** Any finite number is a fraction, integers and real numbers are made
+** into one exactly...
+*/
+value_t toRational(const value_t & value) {
+    if (value->type == VALUE_RATIONAL) {
+        return value;
+    }
+
+    value_t rational = newRational();
+
+    if (value->type == VALUE_SMALL) {
+        mpq_set_si(rational->q, (long)value->i, 1UL);
+    }
+    else if (value->type == VALUE_REAL) {
+        if (mpfr_number_p(value->v)) {
+            mpfr_get_q(rational->q, value->v);
+        }
+    }
+    else {
+        mpq_set_z(rational->q, toInteger(value)->z);
+    }
+
+    return rational;
+}
+
+/*
+** Clear the memory and the named registers, the rest of the state
+** (precision, word size, exact mode) is left as it is...
+*/
+void memInit(void) {
+    _clearMemory(state);
+}
+
+value_t memRetrieve(int location) {
     if (location < 0 || location > NUM_MEMORY_LOCATIONS - 1) {
         throw calc_error("Memory location out of range. Must be between 0 and 9");
     }
-    
-    memory[location].assign("0.00");
+
+    if (!state->memory[location]) {
+        state->memory[location] = _zero();
+    }
+
+    return state->memory[location];
 }
 
-string toString(mpfr_t value, int radix, long precision) {
-    static char     szOutputString[OUTPUT_MAX_STRING_LENGTH];
-    char            szFormatString[FORMAT_STRING_LENGTH];
-    string          outputStr;
+/*
+** The named register, or NULL if nothing has been stored under the name...
+*/
+value_t memFind(const string & name) {
+    auto r = state->registers.find(name);
 
-    switch (radix) {
-        case DECIMAL:
-            snprintf(szFormatString, FORMAT_STRING_LENGTH, "%%.%ldRf", precision);
-            mpfr_snprintf(szOutputString, OUTPUT_MAX_STRING_LENGTH, szFormatString, value);
-            break;
+    return (r != state->registers.end() ? r->second : value_t());
+}
 
-        case HEXADECIMAL:
-            snprintf(szOutputString, OUTPUT_MAX_STRING_LENGTH, "%016lX", mpfr_get_ui(value, MPFR_RNDA));
-            break;
+/*
+** A location is either a register number 0 - 9 or a name, which must
+** not be something the calculator would read as a number...
+*/
+static int _getLocation(const char * pszLocation, string & name) {
+    while (isspace(*pszLocation)) {
+        pszLocation++;
+    }
 
-        case OCTAL:
-            snprintf(szOutputString, OUTPUT_MAX_STRING_LENGTH, "%lo", mpfr_get_ui(value, MPFR_RNDA));
-            break;
+    name.assign(pszLocation);
 
-        case BINARY:
-            char * binaryStr = Utils::getBase2String(mpfr_get_ui(value, MPFR_RNDA));
-            snprintf(szOutputString, OUTPUT_MAX_STRING_LENGTH, "%s", binaryStr);
-            free(binaryStr);
-            break;
+    while (!name.empty() && isspace(name.back())) {
+        name.pop_back();
     }
 
-    outputStr.assign(szOutputString);
+    if (name.length() == 1 && isdigit(name[0])) {
+        return name[0] - '0';
+    }
 
-    lgLogDebug(
-        "Output string = '%s', radix = %d, precision = %ld", 
-        outputStr.c_str(), 
-        radix, 
-        getPrecision());
+    if (!Utils::isVariable(name) || Utils::isOperand(name)) {
+        throw calc_error(
+                calc_error::buildMsg(
+                    "Invalid memory location '%s', use 0 - 9 or a name that is not a number", 
+                    name.c_str()));
+    }
 
-    return outputStr;
+    return -1;
 }
 
-string toFormattedString(mpfr_t value, int radix, long precision) {
-    int     i;
-    int     j;
-    int     k;
-    int     numDigits = 0;
-    char    seperator = ' ';
-    string  s = toString(value, radix, precision);
-    string  out(s.length() * 3, '0');
+void memStore(const value_t & value, const char * pszLocation) {
+    string      name;
+    int         location = _getLocation(pszLocation, name);
+
+    if (location >= 0) {
+        state->memory[location] = value;
+    }
+    else {
+        state->registers[name] = value;
+    }
+}
+
+void memClear(const char * pszLocation) {
+    string      name;
+    int         location = _getLocation(pszLocation, name);
+
+    if (location >= 0) {
+        state->memory[location] = _zero();
+    }
+    else {
+        state->registers.erase(name);
+    }
+}
+
+const unordered_map<string, value_t> & memRegisters(void) {
+    return state->registers;
+}
+
+/*
+** Scratch numbers for the conversions, kept per thread so that once they
+** have grown to the size of the results, formatting allocates nothing
+** but the caller's buffer...
+*/
+typedef struct _format_scratch_t {
+    mpfr_t          scaled;
+    mpz_t           z;
+
+    _format_scratch_t() {
+        mpfr_init2(scaled, MPFR_PREC_MIN);
+        mpz_init(z);
+    }
+
+    ~_format_scratch_t() {
+        mpfr_clear(scaled);
+        mpz_clear(z);
+    }
+}
+format_scratch_t;
+
+static thread_local format_scratch_t    scratch;
+
+/*
+** Append the digits of an integer, GMP writes them straight into the
+** buffer...
+*/
+static void _appendInteger(string & out, mpz_t value, int radix) {
+    size_t      start = out.length();
+
+    /*
+    ** mpz_sizeinbase() may be one too big, and we need room for the
+    ** sign and the terminator...
+    */
+    out.resize(start + mpz_sizeinbase(value, radix) + 2);
+
+    mpz_get_str(&out[start], (radix <= 36 ? -radix : radix), value);
+
+    out.resize(start + strlen(&out[start]));
+
+    if (radix == HEXADECIMAL) {
+        size_t  digitsStart = start + (mpz_sgn(value) < 0 ? 1 : 0);
+        size_t  numDigits = out.length() - digitsStart;
+
+        if (numDigits < HEX_MIN_DIGITS) {
+            out.insert(digitsStart, HEX_MIN_DIGITS - numDigits, '0');
+        }
+    }
+}
+
+/*
+** The digits of a real are those of value * radix^precision rounded to an
+** integer. The product is exact, so the digits are those of the value
+** correctly rounded...
+*/
+void toScaledInteger(mpz_t result, mpfr_t value, int radix, long precision) {
+    mpfr_set_prec(
+            scratch.scaled,
+            mpfr_get_prec(value) + precision * (long)ceil(log2((double)radix)) + 64L);
+
+    mpfr_ui_pow_ui(scratch.scaled, (unsigned long)radix, (unsigned long)precision, MPFR_RNDN);
+    mpfr_mul(scratch.scaled, scratch.scaled, value, MPFR_RNDN);
+    mpfr_get_z(result, scratch.scaled, MPFR_RNDN);
+}
+
+/*
+** GMP's conversion of big numbers is divide and conquer, so millions of
+** digits do not take quadratic time...
+*/
+static void _appendReal(string & out, mpfr_t value, int radix, long precision) {
+    size_t          digitsStart;
+    size_t          numDigits;
+
+    if (mpfr_nan_p(value)) {
+        out.append("nan");
+        return;
+    }
+    if (mpfr_inf_p(value)) {
+        out.append(mpfr_sgn(value) < 0 ? "-inf" : "inf");
+        return;
+    }
+
+    toScaledInteger(scratch.z, value, radix, precision);
+    mpz_abs(scratch.z, scratch.z);
+
+    out.reserve(out.length() + mpz_sizeinbase(scratch.z, radix) + (size_t)precision + 4);
+
+    if (mpfr_signbit(value)) {
+        out.append(1, '-');
+    }
+
+    digitsStart = out.length();
 
-    i = s.length() - 1;
-    j = out.length() - 1;
+    _appendInteger(out, scratch.z, radix);
 
-    lgLogDebug("toFormattedString: inputLen: %d, outputLength: %d", i, j);
+    numDigits = out.length() - digitsStart;
+
+    if (precision > 0) {
+        if (numDigits <= (size_t)precision) {
+            out.insert(digitsStart, (size_t)precision + 1 - numDigits, '0');
+        }
+
+        out.insert(out.length() - (size_t)precision, 1, '.');
+    }
+}
+
+/*
+** Words are printed without going near GMP, in hex and binary they are
+** padded to the word size...
+*/
+static void _appendWord(string & out, const value_t & value, int radix) {
+    char            szDigits[MAX_WORD_SIZE + 2];
+    char *          p = &szDigits[MAX_WORD_SIZE + 1];
+    word_t          w = value->w;
+    bool            isNegative = false;
+    int             numDigits = 0;
+    int             minDigits = 1;
+
+    *p = 0;
+
+    if (!isIntegerMode(radix)) {
+        if (value->isSigned && (sword_t)w < 0) {
+            isNegative = true;
+            w = -w;
+        }
+    }
+    else {
+        int bits = (state->wordSize > 0 ? state->wordSize : MAX_WORD_SIZE);
+
+        w &= _wordMask(bits);
+
+        if (radix == HEXADECIMAL) {
+            minDigits = (bits + 3) / 4;
+        }
+        else if (radix == BINARY) {
+            minDigits = bits;
+        }
+    }
+
+    do {
+        *--p = BASE_DIGITS[(int)(w % (word_t)radix)];
+        w /= (word_t)radix;
+        numDigits++;
+    }
+    while (w > 0 || numDigits < minDigits);
+
+    if (isNegative) {
+        *--p = '-';
+    }
+
+    out.append(p);
+}
+
+/*
+** Group the digits of the number at the end of the buffer in a single
+** pass, in place, working back from the point...
+*/
+static void _group(string & out, size_t start, int radix) {
+    size_t      begin = start + (out[start] == '-' ? 1 : 0);
+    size_t      end;
+    size_t      oldLength = out.length();
+    size_t      numSeparators;
+    size_t      src;
+    size_t      dst;
+    size_t      groupSize;
+    char        separator;
+    size_t      k = 0;
 
     switch (radix) {
         case DECIMAL:
-            numDigits = 3;
-            seperator = ',';
-
-            if (s.find_last_of('.') != string::npos) {
-                while (s[i] != '.') {
-                    out[j--] = s[i--];
-                }
-                out[j--] = s[i--];          // Copy the decimal point...
-            }
+            groupSize = 3;
+            separator = ',';
             break;
 
         case HEXADECIMAL:
         case OCTAL:
         case BINARY:
-            numDigits = 4;
-            seperator = ' ';
+            groupSize = 4;
+            separator = ' ';
             break;
+
+        default:
+            return;
+    }
+
+    end = out.find('.', begin);
+
+    if (end == string::npos) {
+        end = oldLength;
     }
 
-    k = 0;
+    if (end - begin <= groupSize) {
+        return;
+    }
 
-    while (i >= 0) {
-        out[j--] = s[i--];
-        k++;
+    numSeparators = (end - begin - 1) / groupSize;
 
-        lgLogDebug("toFormattedString: i:%d, j:%d, k:%d", i, j, k);
+    out.resize(oldLength + numSeparators);
 
-        /*
-        ** Add the seperator char...
-        */
-        if (k == numDigits && i >= 0) {
-            out[j--] = seperator;
+    /*
+    ** Shift the fraction along, then the integer digits, adding the
+    ** separators as they go...
+    */
+    memmove(&out[end + numSeparators], &out[end], oldLength - end);
+
+    src = end;
+    dst = end + numSeparators;
+
+    while (src > begin) {
+        out[--dst] = out[--src];
+
+        if (++k == groupSize && src > begin) {
+            out[--dst] = separator;
             k = 0;
         }
     }
+}
 
-    /*
-    ** Trim the output string...
-    */
-    out = out.substr(j + 1, out.length());
+void appendString(string & out, mpfr_t value, int radix, long precision, bool doFormat) {
+    size_t          start = out.length();
+
+    if (!isIntegerMode(radix)) {
+        _appendReal(out, value, radix, precision);
+    }
+    else {
+        if (mpfr_number_p(value)) {
+            mpfr_get_z(scratch.z, value, MPFR_RNDA);
+        }
+        else {
+            mpz_set_ui(scratch.z, 0);
+        }
+
+        _appendInteger(out, scratch.z, radix);
+    }
+
+    if (doFormat) {
+        _group(out, start, radix);
+    }
+}
+
+void appendString(string & out, const value_t & value, int radix, long precision, bool doFormat) {
+    size_t          start = out.length();
+
+    if (value->type == VALUE_REAL) {
+        appendString(out, value->v, radix, precision, doFormat);
+        return;
+    }
+
+    if (value->type == VALUE_RATIONAL) {
+        appendString(out, toReal(value)->v, radix, precision, doFormat);
+        return;
+    }
+
+    if (value->type == VALUE_WORD) {
+        _appendWord(out, value, radix);
+    }
+    else if (value->type == VALUE_SMALL) {
+        mpz_set_si(scratch.z, (long)value->i);
+        _appendInteger(out, scratch.z, radix);
+    }
+    else {
+        _appendInteger(out, value->z, radix);
+    }
+
+    if (!isIntegerMode(radix) && precision > 0) {
+        out.append(1, '.');
+        out.append((size_t)precision, '0');
+    }
+
+    if (doFormat) {
+        _group(out, start, radix);
+    }
+}
+
+string toString(mpfr_t value, int radix, long precision) {
+    string          out;
+
+    appendString(out, value, radix, precision, false);
+
+    return out;
+}
+
+string toString(const value_t & value, int radix, long precision) {
+    string          out;
+
+    appendString(out, value, radix, precision, false);
+
+    return out;
+}
+
+string toFormattedString(mpfr_t value, int radix, long precision) {
+    string          out;
+
+    appendString(out, value, radix, precision, true);
+
+    return out;
+}
+
+string toFormattedString(const value_t & value, int radix, long precision) {
+    string          out;
+
+    appendString(out, value, radix, precision, true);
 
     return out;
 }
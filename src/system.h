@@ -1,4 +1,7 @@
 #include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
 #include <gmp.h>
 #include <mpfr.h>
 
@@ -7,18 +10,40 @@ using namespace std;
 #ifndef __INCL_SYSTEM
 #define __INCL_SYSTEM
 
-#define getBasePrecision()                      1024L
-
 #define DEFAULT_PRECISION                        2
-#define MAX_PRECISION                           80
+#define MAX_PRECISION                      1000000
 
-#define FORMAT_STRING_LENGTH             32
-#define OUTPUT_MAX_STRING_LENGTH       4096
+/*
+** The working precision in bits is enough for the digits being displayed
+** plus some guard bits, but never less than this...
+*/
+#define MIN_BASE_PRECISION                    1024L
+#define PRECISION_GUARD_BITS                    64L
+#define LOG2_10                         3.321928094887362
 
 #define NUM_MEMORY_LOCATIONS             10
 
+#define MAX_WORD_SIZE                   128
+
+/*
+** The largest an exact integer may grow to, in bits (8MB)...
+*/
+#define INTEGER_MAX_BITS                (1L << 26)
+
+/*
+** Hex results are padded with zeros to at least this many digits...
+*/
+#define HEX_MIN_DIGITS                   16
+
+#define MIN_BASE                          2
 #define MAX_BASE                         62
 
+/*
+** Digit characters for all bases, as used by GMP and MPFR, letters are
+** case sensitive in bases above 36...
+*/
+#define BASE_DIGITS                     "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+
 #define BASE_10                          10
 #define BASE_16                          16
 #define BASE_8                            8
@@ -30,13 +55,163 @@ using namespace std;
 #define BINARY                          BASE_2
 #define STATISTIC                       1
 
+/*
+** Hex, octal and binary are the integer modes, numbers in any other
+** base (up to 62) are real numbers...
+*/
+#define isIntegerMode(radix)            ((radix) == BINARY || (radix) == OCTAL || (radix) == HEXADECIMAL)
+
+/*
+** A number as it is passed around the calculator, either a real number
+** or, in the integer (hex, octal and binary) modes, an exact integer of
+** any width or a machine word if a word size has been chosen. A value is
+** never changed once it has been made, so it is shared by pointer rather
+** than copied, e.g. when a memory register is recalled...
+**
+** A whole number that fits in 64 bits is held as a small integer in any
+** mode without a word size, it stands for the same real or integer and
+** becomes one as soon as it is needed (see toReal() and toInteger())...
+**
+** In exact mode the numbers written in a calculation are fractions, and
+** stay that way through +, -, * and / (see setExact())...
+*/
+typedef enum {
+    VALUE_REAL,
+    VALUE_INTEGER,
+    VALUE_WORD,
+    VALUE_SMALL,
+    VALUE_RATIONAL
+}
+value_type_t;
+
+/*
+** A fixed width word, up to 128 bits, held sign extended if the words
+** are signed...
+*/
+__extension__ typedef unsigned __int128     word_t;
+__extension__ typedef __int128              sword_t;
+
+mpfr_prec_t getBasePrecision(void);
+
+typedef struct _number_t {
+    value_type_t    type;
+
+    mpfr_t          v;
+    mpz_t           z;
+    mpq_t           q;
+    word_t          w;
+    bool            isSigned;
+    int64_t         i;
+
+    _number_t(value_type_t t) : type(t) {
+        if (type == VALUE_INTEGER) {
+            mpz_init(z);
+        }
+        else if (type == VALUE_REAL) {
+            mpfr_init2(v, getBasePrecision());
+        }
+        else if (type == VALUE_RATIONAL) {
+            mpq_init(q);
+        }
+    }
+
+    ~_number_t() {
+        if (type == VALUE_INTEGER) {
+            mpz_clear(z);
+        }
+        else if (type == VALUE_REAL) {
+            mpfr_clear(v);
+        }
+        else if (type == VALUE_RATIONAL) {
+            mpq_clear(q);
+        }
+    }
+}
+number_t;
+
+typedef shared_ptr<number_t>                value_t;
+
+/*
+** The settings a calculation depends on. The interactive calculator uses
+** a single default state, the server attaches each worker thread to the
+** state belonging to the connection it is serving...
+*/
+typedef struct {
+    mpfr_prec_t     precision;
+
+    /*
+    ** The word size in bits for the integer modes, 0 for integers of
+    ** any width...
+    */
+    int             wordSize;
+    bool            isWordSigned;
+
+    /*
+    ** Whether the numbers in a calculation are read as exact fractions
+    ** in the modes with fractions...
+    */
+    bool            isExact;
+
+    value_t         memory[NUM_MEMORY_LOCATIONS];
+
+    /*
+    ** Registers stored by name rather than number, as many as you like...
+    */
+    unordered_map<string, value_t>  registers;
+}
+system_state_t;
+
+void        sysInitState(system_state_t * state);
+void        sysSetState(system_state_t * state);
+system_state_t * sysGetState(void);
 void        setPrecision(mpfr_prec_t p);
 mpfr_prec_t getPrecision(void);
+void        setWordSize(int bits, bool isSigned);
+int         getWordSize(void);
+bool        getWordSigned(void);
+void        setExact(bool isExact);
+bool        getExact(void);
+int         parseRadix(const char * pszRadix);
+value_t     newValue(void);
+value_t     newInteger(void);
+value_t     newWord(word_t w);
+value_t     newSmall(int64_t i);
+value_t     newRational(void);
+value_t     parseValue(const char * pszValue, int radix);
+value_t     toReal(const value_t & value);
+value_t     toInteger(const value_t & value);
+value_t     toWord(const value_t & value);
+value_t     toRational(const value_t & value);
 void        memInit(void);
-string      memRetrieve(int location);
-void        memStore(string r, int location);
-void        memClear(int location);
+value_t     memRetrieve(int location);
+value_t     memFind(const string & name);
+void        memStore(const value_t & value, const char * pszLocation);
+void        memClear(const char * pszLocation);
+const unordered_map<string, value_t> & memRegisters(void);
+void        toScaledInteger(mpz_t result, mpfr_t value, int radix, long precision);
+void        appendString(string & out, mpfr_t value, int radix, long precision, bool doFormat);
+void        appendString(string & out, const value_t & value, int radix, long precision, bool doFormat);
 string      toString(mpfr_t value, int radix, long precision);
+string      toString(const value_t & value, int radix, long precision);
 string      toFormattedString(mpfr_t value, int radix, long precision);
+string      toFormattedString(const value_t & value, int radix, long precision);
+
+/*
+** Puts the precision back as it was when the guard goes out of scope, for
+** the commands that change it part way through, however they finish...
+*/
+typedef struct _precision_guard_t {
+    mpfr_prec_t     precision;
+
+    _precision_guard_t() : precision(getPrecision()) {
+    }
+
+    _precision_guard_t(const _precision_guard_t &) = delete;
+
+    ~_precision_guard_t() {
+        setPrecision(precision);
+    }
+}
+precision_guard_t;
 
 #endif
@@ -1,9 +1,14 @@
 #include <string>
+#include <vector>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include <gmp.h>
 #include <mpfr.h>
@@ -13,40 +18,888 @@
 #include "calculator.h"
 #include "utils.h"
 #include "system.h"
+#include "quadrature.h"
+#include "solver.h"
+#include "derivative.h"
+#include "server.h"
+#include "statistics.h"
+#include "sketch.h"
+#include "loader.h"
+#include "bivariate.h"
+#include "rolling.h"
+#include "digits.h"
 
 using namespace std;
 
-static bool testEvaluate(const char * pszCalculation, int radix, const char * pszExpectedResult) {
-    mpfr_t          r;
+static bool checkResult(const char * pszCalculation, const value_t & r, int radix, const char * pszExpectedResult) {
     bool            success;
     string          result;
 
-    mpfr_init2(r, getBasePrecision());
+    result = toString(r, radix, (long)getPrecision());
+
+    if (strncmp(result.c_str(), pszExpectedResult, strlen(pszExpectedResult)) == 0) {
+        printf("**** Success :) - [%s] Expected '%s', got '%s'\n", pszCalculation, pszExpectedResult, result.c_str());
+        success = true;
+    }
+    else {
+        printf("**** Failed :( - [%s] Expected '%s', got '%s'\n", pszCalculation, pszExpectedResult, result.c_str());
+        success = false;
+    }
+
+    return success;
+}
+
+static bool testEvaluate(const char * pszCalculation, int radix, const char * pszExpectedResult) {
+    value_t         r;
 
     try {
-        evaluate(r, pszCalculation, radix);
+        r = evaluate(pszCalculation, radix);
     }
     catch (calc_error & e) {
         printf("**** Failed :( - Evaluate failed for [%s] with error: %s\n", pszCalculation, e.what());
         return false;
     }
 
-    result = toString(r, radix, (long)getPrecision());
+    return checkResult(pszCalculation, r, radix, pszExpectedResult);
+}
 
-    if (strncmp(result.c_str(), pszExpectedResult, strlen(pszExpectedResult)) == 0) {
-        printf("**** Success :) - [%s] Expected '%s', got '%s'\n", pszCalculation, pszExpectedResult, result.c_str());
-        success = true;
+/*
+** A calculation worked out and then refined, as 'more' does, to more
+** digits...
+*/
+static bool testRefine(const char * pszCalculation, int radix, long morePrecision, const char * pszExpectedResult) {
+    program_t       program;
+    subtotals_t     subtotals = { vector<value_t>(), getPrecision() };
+    value_t         r;
+
+    try {
+        compile(&program, pszCalculation, radix);
+        refine(&program, &subtotals);
+
+        setPrecision(morePrecision);
+
+        r = refine(&program, &subtotals);
     }
-    else {
-        printf("**** Failed :( - [%s] Expected '%s', got '%s'\n", pszCalculation, pszExpectedResult, result.c_str());
+    catch (calc_error & e) {
+        printf("**** Failed :( - Refine failed for [%s] with error: %s\n", pszCalculation, e.what());
+        return false;
+    }
+
+    return checkResult(pszCalculation, r, radix, pszExpectedResult);
+}
+
+/*
+** integrate(calculation, variable, from, to), as the command works it
+** out...
+*/
+static bool testIntegrate(const char * pszCalculation, const char * pszVariable, const char * pszFrom, const char * pszTo, const char * pszExpectedResult) {
+    program_t       program;
+    value_t         r = newValue();
+    mpfr_t          error;
+
+    mpfr_init2(error, getBasePrecision());
+
+    try {
+        compile(&program, pszCalculation, DECIMAL);
+
+        value_t a = toReal(evaluate(pszFrom, DECIMAL));
+        value_t b = toReal(evaluate(pszTo, DECIMAL));
+
+        quadIntegrate(r->v, error, &program, pszVariable, a->v, b->v);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Integrate failed for [%s] with error: %s\n", pszCalculation, e.what());
+        mpfr_clear(error);
+        return false;
+    }
+
+    mpfr_clear(error);
+
+    return checkResult(pszCalculation, r, DECIMAL, pszExpectedResult);
+}
+
+/*
+** solve(calculation, variable, guess) or solve(calculation, variable,
+** from, to) if pszTo is not NULL...
+*/
+static bool testSolve(const char * pszCalculation, const char * pszVariable, const char * pszFrom, const char * pszTo, const char * pszExpectedResult) {
+    program_t       program;
+    value_t         r = newValue();
+    mpfr_t          error;
+
+    mpfr_init2(error, getBasePrecision());
+
+    try {
+        compile(&program, pszCalculation, DECIMAL);
+
+        value_t a = toReal(evaluate(pszFrom, DECIMAL));
+        value_t b = (pszTo != NULL ? toReal(evaluate(pszTo, DECIMAL)) : value_t());
+
+        solFindRoot(r->v, error, &program, pszVariable, a->v, (b ? b->v : NULL));
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Solve failed for [%s] with error: %s\n", pszCalculation, e.what());
+        mpfr_clear(error);
+        return false;
+    }
+
+    mpfr_clear(error);
+
+    return checkResult(pszCalculation, r, DECIMAL, pszExpectedResult);
+}
+
+/*
+** diff(calculation, variable, at, order), the Taylor coefficient times
+** order!...
+*/
+static bool testDiff(const char * pszCalculation, const char * pszVariable, const char * pszAt, int order, const char * pszExpectedResult) {
+    program_t           program;
+    vector<value_t>     coefficients;
+    value_t             r = newValue();
+
+    try {
+        compile(&program, pszCalculation, DECIMAL);
+
+        value_t at = toReal(evaluate(pszAt, DECIMAL));
+
+        derTaylor(coefficients, order, &program, pszVariable, at->v);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Diff failed for [%s] with error: %s\n", pszCalculation, e.what());
+        return false;
+    }
+
+    mpfr_fac_ui(r->v, (unsigned long)order, MPFR_RNDN);
+    mpfr_mul(r->v, r->v, coefficients[order]->v, MPFR_RNDN);
+
+    return checkResult(pszCalculation, r, DECIMAL, pszExpectedResult);
+}
+
+/*
+** grad(calculation, x, y, ..., a, b, ...), each partial derivative must
+** be as expected...
+*/
+static bool testGradient(const char * pszCalculation, const vector<string> & variables, const vector<string> & at, const vector<string> & expectedResults) {
+    program_t           program;
+    vector<value_t>     values;
+    vector<value_t>     partials;
+    bool                success = true;
+
+    try {
+        compile(&program, pszCalculation, DECIMAL);
+
+        for (const string & a : at) {
+            values.push_back(toReal(evaluate(a.c_str(), DECIMAL)));
+        }
+
+        derGradient(partials, &program, variables, values);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Grad failed for [%s] with error: %s\n", pszCalculation, e.what());
+        return false;
+    }
+
+    for (size_t i = 0;i < partials.size();i++) {
+        success = checkResult(pszCalculation, partials[i], DECIMAL, expectedResults[i].c_str()) && success;
+    }
+
+    return success;
+}
+
+/*
+** Lines sent to the server by a new connection, through its parsing and
+** dispatch, each line it sends back must start as expected...
+*/
+static bool testServer(const vector<string> & lines, const vector<string> & expectedResponses) {
+    vector<string>      responses;
+    bool                success = true;
+
+    try {
+        srvRespond(lines, responses);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Server failed for [%s] with error: %s\n", lines[0].c_str(), e.what());
+        return false;
+    }
+
+    if (responses.size() != expectedResponses.size()) {
+        printf("**** Failed :( - [%s] Expected %d responses, got %d\n", lines[0].c_str(), (int)expectedResponses.size(), (int)responses.size());
+        return false;
+    }
+
+    for (size_t i = 0;i < responses.size();i++) {
+        const char * pszLine = (i < lines.size() ? lines[i].c_str() : "");
+
+        if (responses[i].compare(0, expectedResponses[i].length(), expectedResponses[i]) == 0) {
+            printf("**** Success :) - [%s] Expected '%s', got '%s'\n", pszLine, expectedResponses[i].c_str(), responses[i].c_str());
+        }
+        else {
+            printf("**** Failed :( - [%s] Expected '%s', got '%s'\n", pszLine, expectedResponses[i].c_str(), responses[i].c_str());
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+/*
+** This program run again with the options, as a script would run it,
+** the output and the exit status must be as expected...
+*/
+static bool testOneShot(const char * pszOptions, const char * pszExpectedOutput, int expectedStatus) {
+    char            szProgram[PATH_MAX];
+    char            szOutput[256];
+    string          command;
+    string          output;
+    FILE *          f;
+    ssize_t         length;
+    int             status;
+
+    /*
+    ** The shell that popen() starts has its own /proc/self/exe...
+    */
+    length = readlink("/proc/self/exe", szProgram, sizeof(szProgram) - 1);
+
+    if (length < 0) {
+        printf("**** Failed :( - Could not find the program to run [%s]\n", pszOptions);
+        return false;
+    }
+
+    szProgram[length] = 0;
+
+    command.append("'").append(szProgram).append("' ").append(pszOptions).append(" 2>/dev/null");
+
+    f = popen(command.c_str(), "r");
+
+    if (f == NULL) {
+        printf("**** Failed :( - Could not run [%s]\n", pszOptions);
+        return false;
+    }
+
+    while (fgets(szOutput, sizeof(szOutput), f) != NULL) {
+        output.append(szOutput);
+    }
+
+    status = pclose(f);
+    status = (WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+
+    if (output.compare(pszExpectedOutput) == 0 && status == expectedStatus) {
+        printf("**** Success :) - [%s] Expected '%s' (%d), got '%s' (%d)\n", pszOptions, pszExpectedOutput, expectedStatus, output.c_str(), status);
+        return true;
+    }
+
+    printf("**** Failed :( - [%s] Expected '%s' (%d), got '%s' (%d)\n", pszOptions, pszExpectedOutput, expectedStatus, output.c_str(), status);
+
+    return false;
+}
+
+/*
+** Each of the values added to a new set of statistics, in order...
+*/
+static void addStatistics(stats_t * s, const vector<string> & values) {
+    mpfr_t          v;
+
+    mpfr_init2(v, getBasePrecision());
+
+    for (const string & value : values) {
+        mpfr_set_str(v, value.c_str(), DECIMAL, MPFR_RNDN);
+        statAdd(s, v);
+    }
+
+    mpfr_clear(v);
+}
+
+static bool checkStatistic(const char * pszName, mpfr_t value, const char * pszExpectedResult) {
+    value_t         r = newValue();
+
+    mpfr_set(r->v, value, MPFR_RNDN);
+
+    return checkResult(pszName, r, DECIMAL, pszExpectedResult);
+}
+
+/*
+** The running statistics of the values, as the commands show them. The
+** expected results are the sum, mean, variance, standard deviation,
+** minimum and maximum...
+*/
+static bool testAccumulators(const vector<string> & values, const vector<string> & expectedResults) {
+    stats_t         s;
+    mpfr_t          r;
+    bool            success = true;
+
+    statInit(&s);
+    mpfr_init2(r, getBasePrecision());
+
+    try {
+        addStatistics(&s, values);
+
+        if (statCount(&s) != values.size()) {
+            printf("**** Failed :( - [count] Expected %d, got %d\n", (int)values.size(), (int)statCount(&s));
+            success = false;
+        }
+
+        statSum(r, &s);
+        success = checkStatistic("sum", r, expectedResults[0].c_str()) && success;
+
+        statMean(r, &s);
+        success = checkStatistic("avg", r, expectedResults[1].c_str()) && success;
+
+        statVariance(r, &s);
+        success = checkStatistic("var", r, expectedResults[2].c_str()) && success;
+
+        statStdDev(r, &s);
+        success = checkStatistic("sd", r, expectedResults[3].c_str()) && success;
+
+        statMin(r, &s);
+        success = checkStatistic("min", r, expectedResults[4].c_str()) && success;
+
+        statMax(r, &s);
+        success = checkStatistic("max", r, expectedResults[5].c_str()) && success;
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Statistics failed with error: %s\n", e.what());
         success = false;
     }
 
     mpfr_clear(r);
+    statFree(&s);
+
+    return success;
+}
+
+/*
+** The median, percentiles and mode of the values, kept as they are so
+** the results are exact. The expected results are the median, the
+** 25th and 90th percentiles and the mode, followed by how often the
+** mode occurs and the counts in each bin of a histogram...
+*/
+static bool testOrderStatistics(const vector<string> & values, const vector<string> & expectedResults, uint64_t expectedModeCount, const vector<uint64_t> & expectedCounts) {
+    stats_t             s;
+    mpfr_t              r;
+    vector<uint64_t>    counts;
+    double              low;
+    double              width;
+    uint64_t            modeCount;
+    bool                success = true;
+
+    statInit(&s);
+    mpfr_init2(r, getBasePrecision());
+
+    try {
+        addStatistics(&s, values);
+
+        statQuantile(r, &s, 0.5);
+        success = checkStatistic("median", r, expectedResults[0].c_str()) && success;
+
+        statQuantile(r, &s, 0.25);
+        success = checkStatistic("pct 25", r, expectedResults[1].c_str()) && success;
+
+        statQuantile(r, &s, 0.9);
+        success = checkStatistic("pct 90", r, expectedResults[2].c_str()) && success;
+
+        modeCount = statMode(r, &s);
+        success = checkStatistic("mode", r, expectedResults[3].c_str()) && success;
+
+        if (modeCount != expectedModeCount) {
+            printf("**** Failed :( - [mode] Expected %d times, got %d\n", (int)expectedModeCount, (int)modeCount);
+            success = false;
+        }
+
+        statHistogram(&s, (int)expectedCounts.size(), counts, &low, &width);
+
+        if (counts == expectedCounts) {
+            printf("**** Success :) - [hist %d] Counts as expected\n", (int)expectedCounts.size());
+        }
+        else {
+            printf("**** Failed :( - [hist %d] Counts are not as expected\n", (int)expectedCounts.size());
+            success = false;
+        }
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Order statistics failed with error: %s\n", e.what());
+        success = false;
+    }
+
+    mpfr_clear(r);
+    statFree(&s);
+
+    return success;
+}
+
+/*
+** The sketch is given 0 to n - 1 in a scrambled order, so the rank of
+** any value it returns is the value itself, it must be within the
+** sketch's error of the rank asked for...
+*/
+static bool testSketch(uint64_t n) {
+    sketch_t        s;
+    double          worst = 0.0;
+
+    skInit(&s);
+
+    for (uint64_t i = 0;i < n;i++) {
+        skAdd(&s, (double)((i * 7919) % n));
+    }
+
+    for (int percentile = 1;percentile < 100;percentile++) {
+        double q = (double)percentile / 100.0;
+        double error = fabs(skQuantile(&s, q) / (double)n - q);
+
+        if (error > worst) {
+            worst = error;
+        }
+    }
+
+    if (worst <= SKETCH_RANK_ERROR) {
+        printf("**** Success :) - [sketch %lu] Expected a rank error up to %g, got %g\n", (unsigned long)n, SKETCH_RANK_ERROR, worst);
+        return true;
+    }
+
+    printf("**** Failed :( - [sketch %lu] Expected a rank error up to %g, got %g\n", (unsigned long)n, SKETCH_RANK_ERROR, worst);
+
+    return false;
+}
+
+/*
+** The statistics of 1 to n, however they were put together, the
+** expected results are the count, sum, mean, variance and median...
+*/
+static bool checkOneToN(const char * pszName, stats_t * s, const vector<string> & expectedResults) {
+    mpfr_t          r;
+    string          name(pszName);
+    bool            success = true;
+
+    mpfr_init2(r, getBasePrecision());
+
+    mpfr_set_ui(r, (unsigned long)statCount(s), MPFR_RNDN);
+    success = checkStatistic((name + " count").c_str(), r, expectedResults[0].c_str()) && success;
+
+    statSum(r, s);
+    success = checkStatistic((name + " sum").c_str(), r, expectedResults[1].c_str()) && success;
+
+    statMean(r, s);
+    success = checkStatistic((name + " avg").c_str(), r, expectedResults[2].c_str()) && success;
+
+    statVariance(r, s);
+    success = checkStatistic((name + " var").c_str(), r, expectedResults[3].c_str()) && success;
+
+    statQuantile(r, s, 0.5);
+    success = checkStatistic((name + " median").c_str(), r, expectedResults[4].c_str()) && success;
+
+    mpfr_clear(r);
+
+    return success;
+}
+
+/*
+** A file of 1 to n, below a header, loaded in chunks (one per thread)
+** and merged...
+*/
+static bool testLoader(uint64_t n, const vector<string> & expectedResults) {
+    stats_t         s;
+    char            szFilename[] = "/tmp/ccalc_test_XXXXXX";
+    uint64_t        numSkipped;
+    FILE *          f;
+    int             fd;
+    bool            success = true;
+
+    fd = mkstemp(szFilename);
+
+    if (fd < 0 || (f = fdopen(fd, "w")) == NULL) {
+        printf("**** Failed :( - Could not create a file to load\n");
+        return false;
+    }
+
+    fprintf(f, "row, value\n");
+
+    for (uint64_t i = 1;i <= n;i++) {
+        fprintf(f, "%lu, %lu\n", (unsigned long)i, (unsigned long)i);
+    }
+
+    fclose(f);
+
+    statInit(&s);
+
+    try {
+        ldrLoad(&s, szFilename, 2, &numSkipped);
+
+        if (numSkipped != 1) {
+            printf("**** Failed :( - [load] Expected 1 line skipped, got %lu\n", (unsigned long)numSkipped);
+            success = false;
+        }
+
+        success = checkOneToN("load", &s, expectedResults) && success;
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Load failed with error: %s\n", e.what());
+        success = false;
+    }
+
+    statFree(&s);
+    unlink(szFilename);
+
+    return success;
+}
+
+/*
+** 1 to n added as two separate sets, split after the given value, then
+** merged as the loader merges its chunks...
+*/
+static bool testMerge(uint64_t n, uint64_t split, const vector<string> & expectedResults) {
+    stats_t         s;
+    stats_t         other;
+    mpfr_t          v;
+    bool            success;
+
+    statInit(&s);
+    statInit(&other);
+    mpfr_init2(v, getBasePrecision());
+
+    for (uint64_t i = 1;i <= n;i++) {
+        mpfr_set_ui(v, (unsigned long)i, MPFR_RNDN);
+        statAdd((i <= split ? &s : &other), v);
+    }
+
+    try {
+        statMerge(&s, &other);
+
+        success = checkOneToN("merge", &s, expectedResults);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Merge failed with error: %s\n", e.what());
+        success = false;
+    }
+
+    mpfr_clear(v);
+    statFree(&other);
+    statFree(&s);
+
+    return success;
+}
+
+/*
+** The pairs (x, 2x + 1) for x = offset + 1 to offset + n, the expected
+** results are the covariance, correlation, slope and intercept...
+*/
+static bool testBivariate(const char * pszOffset, uint64_t n, bool isPrecise, const vector<string> & expectedResults) {
+    stats_t         s;
+    comoments_t     m;
+    mpfr_t          x;
+    mpfr_t          y;
+    mpfr_t          r;
+    mpfr_t          intercept;
+    string          name(isPrecise ? "precise " : "");
+    bool            success = true;
+
+    statInit(&s);
+    bivInit(&m);
+    mpfr_inits2(getBasePrecision(), x, y, r, intercept, (mpfr_ptr)0);
+
+    for (uint64_t i = 1;i <= n;i++) {
+        mpfr_set_str(x, pszOffset, DECIMAL, MPFR_RNDN);
+        mpfr_add_ui(x, x, (unsigned long)i, MPFR_RNDN);
+        mpfr_mul_ui(y, x, 2, MPFR_RNDN);
+        mpfr_add_ui(y, y, 1, MPFR_RNDN);
+
+        statAddPair(&s, x, y);
+    }
+
+    try {
+        bivCompute(&m, &s, isPrecise);
+
+        bivCovariance(r, &m);
+        success = checkStatistic((name + "cov").c_str(), r, expectedResults[0].c_str()) && success;
+
+        bivCorrelation(r, &m);
+        success = checkStatistic((name + "corr").c_str(), r, expectedResults[1].c_str()) && success;
+
+        bivRegression(r, intercept, &m);
+        success = checkStatistic((name + "slope").c_str(), r, expectedResults[2].c_str()) && success;
+        success = checkStatistic((name + "intercept").c_str(), intercept, expectedResults[3].c_str()) && success;
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Bivariate statistics failed with error: %s\n", e.what());
+        success = false;
+    }
+
+    mpfr_clears(x, y, r, intercept, (mpfr_ptr)0);
+    bivFree(&m);
+    statFree(&s);
 
     return success;
 }
 
+/*
+** A stream of n pseudo-random samples, after each one the rolling
+** statistics must match those worked out again from the whole window...
+*/
+static bool testRolling(size_t window, double alpha, uint64_t n) {
+    rolling_t       r;
+    vector<double>  samples;
+    uint64_t        seed = 12345;
+    double          ema = 0.0;
+
+    rolInit(&r, window, alpha);
+
+    for (uint64_t i = 0;i < n;i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        double value = (double)(seed >> 40) / 16777.216;
+
+        rolAdd(&r, value);
+        samples.push_back(value);
+
+        ema = (i == 0 ? value : ema + alpha * (value - ema));
+
+        size_t  size = (samples.size() < window ? samples.size() : window);
+        double  mean = 0.0;
+        double  m2 = 0.0;
+        double  min = samples[samples.size() - size];
+        double  max = min;
+
+        for (size_t j = samples.size() - size;j < samples.size();j++) {
+            mean += samples[j] / (double)size;
+            min = (samples[j] < min ? samples[j] : min);
+            max = (samples[j] > max ? samples[j] : max);
+        }
+
+        for (size_t j = samples.size() - size;j < samples.size();j++) {
+            m2 += (samples[j] - mean) * (samples[j] - mean);
+        }
+
+        double variance = (size > 1 ? m2 / (double)(size - 1) : 0.0);
+
+        if (rolSize(&r) != size ||
+            fabs(rolMean(&r) - mean) > 1e-9 * (fabs(mean) + 1.0) ||
+            fabs(rolVariance(&r) - variance) > 1e-6 * (variance + 1.0) ||
+            rolMin(&r) != min ||
+            rolMax(&r) != max ||
+            fabs(rolEMA(&r) - ema) > 1e-9 * (fabs(ema) + 1.0))
+        {
+            printf(
+                "**** Failed :( - [rolling %lu] At sample %lu expected %g %g %g %g %g, got %g %g %g %g %g\n",
+                (unsigned long)window,
+                (unsigned long)i,
+                mean, variance, min, max, ema,
+                rolMean(&r), rolVariance(&r), rolMin(&r), rolMax(&r), rolEMA(&r));
+
+            return false;
+        }
+    }
+
+    printf("**** Success :) - [rolling %lu] %lu samples as expected\n", (unsigned long)window, (unsigned long)n);
+
+    return true;
+}
+
+/*
+** A result stored in a register and recalled at more digits, in a
+** state of its own so the session's registers are left alone...
+*/
+static bool testMemory(const char * pszCalculation, const char * pszLocation, long morePrecision, const char * pszRecall, const char * pszExpectedResult) {
+    system_state_t      state;
+    system_state_t *    previous = sysGetState();
+    value_t             r;
+    bool                success;
+
+    sysInitState(&state);
+    state.precision = getPrecision();
+
+    sysSetState(&state);
+
+    try {
+        memStore(evaluate(pszCalculation, DECIMAL), pszLocation);
+
+        setPrecision(morePrecision);
+
+        r = evaluate(pszRecall, DECIMAL);
+
+        success = checkResult(pszRecall, r, DECIMAL, pszExpectedResult);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Memory failed for [%s] with error: %s\n", pszRecall, e.what());
+        success = false;
+    }
+
+    sysSetState(previous);
+
+    return success;
+}
+
+/*
+** The result appended to a buffer that already holds a prefix, it must
+** be kept and the result must be written in full, however long...
+*/
+static bool testAppend(const char * pszCalculation, int radix, bool doFormat, size_t expectedLength, const char * pszExpectedResult) {
+    string          out("x = ");
+    value_t         r;
+
+    try {
+        r = evaluate(pszCalculation, radix);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Evaluate failed for [%s] with error: %s\n", pszCalculation, e.what());
+        return false;
+    }
+
+    appendString(out, r, radix, (long)getPrecision(), doFormat);
+
+    if (out.length() == expectedLength && out.compare(0, strlen(pszExpectedResult), pszExpectedResult) == 0) {
+        printf("**** Success :) - [%s] Expected %lu characters from '%s', got %lu\n", pszCalculation, (unsigned long)expectedLength, pszExpectedResult, (unsigned long)out.length());
+        return true;
+    }
+
+    printf("**** Failed :( - [%s] Expected %lu characters from '%s', got %lu from '%.40s'\n", pszCalculation, (unsigned long)expectedLength, pszExpectedResult, (unsigned long)out.length(), out.c_str());
+
+    return false;
+}
+
+/*
+** A result written a chunk of digits at a time must read back the same
+** as the whole of it converted at once...
+*/
+static bool testDigits(const char * pszCalculation, int radix) {
+    string          expected;
+    string          written;
+    char            szBuffer[4096];
+    value_t         r;
+    FILE *          f;
+    size_t          length;
+
+    try {
+        r = evaluate(pszCalculation, radix);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Evaluate failed for [%s] with error: %s\n", pszCalculation, e.what());
+        return false;
+    }
+
+    f = tmpfile();
+
+    if (f == NULL) {
+        printf("**** Failed :( - Could not create a file for [%s]\n", pszCalculation);
+        return false;
+    }
+
+    digWrite(f, r, radix, (long)getPrecision(), false);
+
+    rewind(f);
+
+    while ((length = fread(szBuffer, 1, sizeof(szBuffer), f)) > 0) {
+        written.append(szBuffer, length);
+    }
+
+    fclose(f);
+
+    expected = toString(r, radix, (long)getPrecision()).append(1, '\n');
+
+    if (written.compare(expected) == 0) {
+        printf("**** Success :) - [%s] Expected %lu characters, got them\n", pszCalculation, (unsigned long)expected.length());
+        return true;
+    }
+
+    printf("**** Failed :( - [%s] Expected %lu characters, got %lu\n", pszCalculation, (unsigned long)expected.length(), (unsigned long)written.length());
+
+    return false;
+}
+
+/*
+** A calculation with expensive parts that do not need each other, they
+** are planned as tasks and must come to the same result as the tokens
+** run one after another...
+*/
+static bool testTasks(const char * pszCalculation, int radix) {
+    program_t       program;
+    program_t       serial;
+    value_t         r;
+    value_t         expected;
+    string          result;
+    string          expectedResult;
+
+    try {
+        compile(&program, pszCalculation, radix);
+
+        if (program.tasks.empty()) {
+            printf("**** Failed :( - [%s] Expected tasks to run in parallel, got none\n", pszCalculation);
+            return false;
+        }
+
+        serial = program;
+        serial.tasks.clear();
+
+        r = execute(&program, NULL);
+        expected = execute(&serial, NULL);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Execute failed for [%s] with error: %s\n", pszCalculation, e.what());
+        return false;
+    }
+
+    result = toString(r, radix, (long)getPrecision());
+    expectedResult = toString(expected, radix, (long)getPrecision());
+
+    if (result.compare(expectedResult) == 0) {
+        printf("**** Success :) - [%s] Expected the same as in turn, got %d tasks and '%.20s...'\n", pszCalculation, (int)program.tasks.size(), result.c_str());
+        return true;
+    }
+
+    printf("**** Failed :( - [%s] Expected '%.20s...', got '%.20s...'\n", pszCalculation, expectedResult.c_str(), result.c_str());
+
+    return false;
+}
+
+/*
+** An operator with a small integer operand is given a kernel of its
+** own, it must come to the same result as the generic operator...
+*/
+static bool testKernel(const char * pszCalculation, const char * pszX) {
+    program_t       program;
+    program_t       generic;
+    bindings_t      bindings;
+    value_t         r;
+    value_t         expected;
+    string          result;
+    string          expectedResult;
+    bool            hasKernel = false;
+
+    try {
+        compile(&program, pszCalculation, DECIMAL);
+
+        generic = program;
+
+        for (size_t i = 0;i < program.kernels.size();i++) {
+            hasKernel = hasKernel || program.kernels[i].type != KERNEL_GENERIC;
+            generic.kernels[i].type = KERNEL_GENERIC;
+        }
+
+        if (!hasKernel) {
+            printf("**** Failed :( - [%s] Expected a kernel, got none\n", pszCalculation);
+            return false;
+        }
+
+        bindings["x"] = parseValue(pszX, DECIMAL);
+
+        r = execute(&program, &bindings);
+        expected = execute(&generic, &bindings);
+    }
+    catch (calc_error & e) {
+        printf("**** Failed :( - Execute failed for [%s] with error: %s\n", pszCalculation, e.what());
+        return false;
+    }
+
+    result = toString(r, DECIMAL, (long)getPrecision());
+    expectedResult = toString(expected, DECIMAL, (long)getPrecision());
+
+    if (result.compare(expectedResult) == 0) {
+        printf("**** Success :) - [%s, x = %s] Expected '%s', got '%s'\n", pszCalculation, pszX, expectedResult.c_str(), result.c_str());
+        return true;
+    }
+
+    printf("**** Failed :( - [%s, x = %s] Expected '%s', got '%s'\n", pszCalculation, pszX, expectedResult.c_str(), result.c_str());
+
+    return false;
+}
+
 int test(void) {
     int             numTestsFailed = 0;
     int             numTestsPassed = 0;
@@ -108,11 +961,21 @@ int test(void) {
     testEvaluate("fact(12) + 13", mode, "479001613.0") ? numTestsPassed++ : numTestsFailed++;
     totalTests++;
 
+    setPrecision(2U);
+    mode = DECIMAL;
+    testEvaluate("binom(52, 5) - fact(300) / fact(298) + gamma(0.5) ^ 2", mode, "2509263.14") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
     setPrecision(0U);
     mode = HEXADECIMAL;
     testEvaluate("(F100 < 3) + (AA > 1)", mode, "0000000000078855") ? numTestsPassed++ : numTestsFailed++;
     totalTests++;
 
+    setPrecision(0U);
+    mode = HEXADECIMAL;
+    testEvaluate("((1 < 50) - 1) & (F0 < 48)", mode, "F0000000000000000000") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
     setPrecision(0U);
     mode = BINARY;
     testEvaluate("10101010 | 1010101", mode, "11111111") ? numTestsPassed++ : numTestsFailed++;
@@ -128,6 +991,283 @@ int test(void) {
     testEvaluate("asin(sin(90)) + acos(cos(90))", mode, "180.00") ? numTestsPassed++ : numTestsFailed++;
     totalTests++;
 
+    setPrecision(2U);
+    mode = 36;
+    testEvaluate("ZZ * Z / 10", mode, "YZ.10") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    mode = DECIMAL;
+    testEvaluate("3 ^ 40 / 3 ^ 39 + 9223372036854775807 - 2", mode, "9223372036854775808.00") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    setExact(true);
+    mode = DECIMAL;
+    testEvaluate("((1 / 3) * 3 - 1) * 10 ^ 400 + 0.1 + 0.2", mode, "0.30") ? numTestsPassed++ : numTestsFailed++;
+    setExact(false);
+    totalTests++;
+
+    /*
+    ** binom( is a function, not the bin command...
+    */
+    testServer({ "setp 2", "binom(5, 2)", "2 + 2", "bin", "101 + 1" }, { "ok", "= 10.00", "= 4.00", "ok", "= 110" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    testServer({ "setp 1000000", "setp 10000" }, { "! Calc error: Precision must be between 0 and 10000", "ok" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Each connection has its own precision, mode and memory...
+    */
+    testServer({ "setp 3", "2 + 3", "memst rate", "rate * 2", "setp 1", "rate / 3" }, { "ok", "= 5.000", "ok", "= 10.000", "ok", "= 1.7" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    testServer({ "rate * 2" }, { "! " }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** A tagged calculation is answered with its tag, frames with a header
+    ** and a line for each of their calculations, in order...
+    */
+    testServer(
+            { "setp 2", "#a 1 + 1", "batch 3", "2 * 3", "y + 1", "4 - 5", "vector 2 x * y + 1", "x=2 y=3", "x=5, y=1", "#b 2 ^ 10" },
+            { "ok", "#a = 2.00", "batch 3", "= 6.00", "! ", "= -1.00", "vector 2", "= 7.00", "= 6.00", "#b = 1024.00" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** One-shot calculations print just the result, the exit status says
+    ** whether it worked...
+    */
+    testOneShot("-e \"2 ^ 64\" -p 3", "18446744073709551616.000\n", 0) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    testOneShot("-e \"FF + 1\" --hex", "0000000000000100\n", 0) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    testOneShot("-e \"1 +\"", "", 1) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    testOneShot("-e 1 -p -5", "", 2) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** pi is rounded to the digits displayed, so 'more' must work it out
+    ** again rather than keep 2 * 3.14...
+    */
+    setPrecision(2U);
+    mode = DECIMAL;
+    testRefine("pi * 2", mode, 20L, "6.28318530717958647692") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    mode = DECIMAL;
+    testRefine("fact(30) + 1 / 3", mode, 30L, "265252859812191058636308480000000.333333333333333333333333333333") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Up to 15 digits with Gauss-Kronrod, above with tanh-sinh...
+    */
+    setPrecision(2U);
+    testIntegrate("x ^ 2", "x", "0", "3", "9.00") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(40U);
+    testIntegrate("4 / (1 + x ^ 2)", "x", "0", "1", "3.141592653589793238462643383279502884197") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Near a guess with Halley's method, between two points with Brent's...
+    */
+    setPrecision(2U);
+    testSolve("x ^ 2 - 2", "x", "1", NULL, "1.41") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    testSolve("cos(x)", "x", "0", "180", "90.00") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    testDiff("x ^ 3", "x", "2", 1, "12.00") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Angles are in degrees, so this is pi / 180...
+    */
+    setPrecision(10U);
+    testDiff("sin(x)", "x", "0", 1, "0.0174532925") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    testDiff("ln(x)", "x", "2", 2, "-0.25") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    testGradient("x ^ 2 * y", { "x", "y" }, { "3", "2" }, { "12.00", "9.00" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(0U);
+    mode = HEXADECIMAL;
+    testEvaluate("sum(i, 1, 10000, i)", mode, "0000000080008000") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    mode = DECIMAL;
+    testEvaluate("prod(i, 1, 25, i) - fact(25)", mode, "0.00") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** pi ^ 2 / 6, with Richardson's method...
+    */
+    setPrecision(10U);
+    mode = DECIMAL;
+    testEvaluate("sum(i, 1, inf, 1 / i ^ 2)", mode, "1.6449340668") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** An alternating series, with Levin's u transform...
+    */
+    setPrecision(10U);
+    mode = DECIMAL;
+    testEvaluate("4 * sum(k, 0, inf, (-1) ^ k / (2 * k + 1))", mode, "3.1415926536") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Running statistics, worked out as each value is added. The variance
+    ** is of a sample...
+    */
+    setPrecision(4U);
+    testAccumulators(
+            { "2", "4", "4", "4", "5", "5", "7", "9" },
+            { "40.0000", "5.0000", "4.5714", "2.1381", "2.0000", "9.0000" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Welford's method keeps the variance when the values are close
+    ** together and far from zero...
+    */
+    setPrecision(2U);
+    testAccumulators(
+            { "10000000000000001", "10000000000000002", "10000000000000003" },
+            { "30000000000000006.00", "10000000000000002.00", "1.00", "1.00", "10000000000000001.00", "10000000000000003.00" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Percentiles are interpolated between the values either side...
+    */
+    setPrecision(2U);
+    testOrderStatistics(
+            { "5", "9", "4", "2", "7", "4", "5", "4" },
+            { "4.50", "4.00", "7.60", "4.00" }, 3,
+            { 1, 0, 3, 2, 0, 1, 1 }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    testSketch(1000000) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Statistics put together from parts (Chan et al.) are the same as
+    ** if every value had been added to one, the variance of 1 to n is
+    ** n(n + 1) / 12...
+    */
+    setPrecision(4U);
+    testLoader(200000, { "200000.0000", "20000100000.0000", "100000.5000", "3333350000.0000", "100000.5000" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(4U);
+    testMerge(1000, 300, { "1000.0000", "500500.0000", "500.5000", "83416.6667", "500.5000" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Enough pairs for a chunk per thread, the covariance of (x, 2x + 1)
+    ** is twice the variance of x...
+    */
+    setPrecision(4U);
+    testBivariate("0", 200000, false, { "6666700000.0000", "1.0000", "2.0000", "1.0000" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(4U);
+    testBivariate("0", 200000, true, { "6666700000.0000", "1.0000", "2.0000", "1.0000" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Too far from zero for doubles, only the precise path has the digits...
+    */
+    setPrecision(4U);
+    testBivariate("100000000000000000000", 4, true, { "3.3333", "1.0000", "2.0000", "1.0000" }) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** The window filling up, then sliding along the stream...
+    */
+    testRolling(3, 0.5, 10) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    testRolling(50, 0.1, 20000) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Registers keep the whole value, not the digits shown when it was
+    ** stored...
+    */
+    setPrecision(2U);
+    testMemory("1 / 3", "third", 30, "third * 3", "1.000000000000000000000000000000") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(2U);
+    testMemory("sqrt(2)", "7", 20, "mem(7) ^ 2", "2.00000000000000000000") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** 1000! has 2568 digits, more than any fixed buffer would hold...
+    */
+    setPrecision(0U);
+    testAppend("fact(1000)", DECIMAL, false, 4 + 2568, "x = 402387260077093773543702433923003985") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Digits are grouped after the sign...
+    */
+    setPrecision(2U);
+    testAppend("-1234567.5", DECIMAL, true, 17, "x = -1,234,567.50") ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Long enough to be streamed, over more than one chunk...
+    */
+    setPrecision(150000U);
+    testDigits("-1 / 7", DECIMAL) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    setPrecision(3U);
+    testDigits("fact(30000)", DECIMAL) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** 100000 is hex here, so this is 3 ^ 2^20...
+    */
+    setPrecision(0U);
+    testDigits("3 ^ 100000", HEXADECIMAL) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** At 3000 digits each function and power is worth a thread of its own...
+    */
+    setPrecision(3000U);
+    testTasks("2 ^ 0.5 + sin(30.5) * gamma(20.5) - ln(7) : 3", DECIMAL) ? numTestsPassed++ : numTestsFailed++;
+    totalTests++;
+
+    /*
+    ** Each kernel, with x a real and x a small integer...
+    */
+    for (const char * pszCalculation : { "x * x", "x ^ 2", "x ^ 5", "3 ^ x", "x + 12", "x - 12", "12 - x", "x * 3", "x * 8", "x / 7", "x / 8", "7 / x", "x : 3" }) {
+        for (const char * pszX : { "1.2345", "-7" }) {
+            setPrecision(20U);
+            testKernel(pszCalculation, pszX) ? numTestsPassed++ : numTestsFailed++;
+            totalTests++;
+        }
+    }
+
     printf("\nTest: %d tests failed, %d tests passed out of %d total\n\n", numTestsFailed, numTestsPassed, totalTests);
 
     return numTestsFailed;
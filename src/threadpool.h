@@ -0,0 +1,194 @@
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <exception>
+
+using namespace std;
+
+#ifndef __INCL_THREADPOOL
+#define __INCL_THREADPOOL
+
+/*
+** A fixed set of worker threads taking jobs from a shared queue. Jobs
+** still queued when the pool is destroyed are run before the workers exit...
+*/
+class ThreadPool {
+    private:
+        /*
+        ** The items of a runEach(), taken in turn by whichever threads
+        ** get to them first...
+        */
+        typedef struct {
+            function<void(size_t)>  job;
+            size_t                  numItems;
+            atomic<size_t>          next;
+            mutex                   lock;
+            condition_variable      isFinished;
+            size_t                  numDone;
+            exception_ptr           error;
+        }
+        group_t;
+
+        vector<thread>              _workers;
+        queue<function<void()>>     _jobs;
+        mutex                       _lock;
+        condition_variable          _jobAvailable;
+        bool                        _isStopping = false;
+
+        inline static thread_local ThreadPool * _current = nullptr;
+
+        static void _runItems(group_t * g) {
+            size_t i;
+
+            while ((i = g->next++) < g->numItems) {
+                exception_ptr error;
+
+                try {
+                    g->job(i);
+                }
+                catch (...) {
+                    error = current_exception();
+                }
+
+                lock_guard<mutex> lock(g->lock);
+
+                if (error && !g->error) {
+                    g->error = error;
+                }
+
+                if (++g->numDone == g->numItems) {
+                    g->isFinished.notify_all();
+                }
+            }
+        }
+
+        void _run() {
+            _current = this;
+
+            while (true) {
+                function<void()> job;
+
+                {
+                    unique_lock<mutex> lock(_lock);
+
+                    _jobAvailable.wait(lock, [this] { return _isStopping || !_jobs.empty(); });
+
+                    if (_jobs.empty()) {
+                        return;
+                    }
+
+                    job = std::move(_jobs.front());
+                    _jobs.pop();
+                }
+
+                job();
+            }
+        }
+
+    public:
+        ThreadPool(int numThreads) {
+            if (numThreads < 1) {
+                numThreads = 1;
+            }
+
+            for (int i = 0;i < numThreads;i++) {
+                _workers.emplace_back(&ThreadPool::_run, this);
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                lock_guard<mutex> lock(_lock);
+                _isStopping = true;
+            }
+
+            _jobAvailable.notify_all();
+
+            for (thread & t : _workers) {
+                t.join();
+            }
+        }
+
+        void submit(function<void()> job) {
+            {
+                lock_guard<mutex> lock(_lock);
+                _jobs.push(std::move(job));
+            }
+
+            _jobAvailable.notify_one();
+        }
+
+        int size() {
+            return (int)_workers.size();
+        }
+
+        static int getDefaultSize() {
+            int n = (int)thread::hardware_concurrency();
+
+            return (n > 0 ? n : 1);
+        }
+
+        /*
+        ** The pool shared by every calculation, one thread per core...
+        */
+        static ThreadPool & getShared() {
+            static ThreadPool pool(getDefaultSize());
+
+            return pool;
+        }
+
+        /*
+        ** Whether the calling thread is one of this pool's workers...
+        */
+        bool isWorker() {
+            return (_current == this);
+        }
+
+        /*
+        ** Run job(i) for each i from 0 to n - 1 and return once they have
+        ** all finished, throwing the first error if any failed. The calling
+        ** thread takes items along with the workers and only waits for the
+        ** items that have been started, so it never waits on a job stuck in
+        ** the queue. On one of the pool's own workers the items are run in
+        ** turn, so a worker never waits for the others...
+        */
+        void runEach(size_t n, const function<void(size_t)> & job) {
+            if (n < 2 || _workers.size() < 2 || isWorker()) {
+                for (size_t i = 0;i < n;i++) {
+                    job(i);
+                }
+
+                return;
+            }
+
+            shared_ptr<group_t> g = make_shared<group_t>();
+
+            g->job = job;
+            g->numItems = n;
+            g->next = 0;
+            g->numDone = 0;
+
+            for (size_t i = 0;i < n - 1 && i < _workers.size();i++) {
+                submit([g] {
+                    _runItems(g.get());
+                });
+            }
+
+            _runItems(g.get());
+
+            unique_lock<mutex> lock(g->lock);
+
+            g->isFinished.wait(lock, [&] { return (g->numDone == n); });
+
+            if (g->error) {
+                rethrow_exception(g->error);
+            }
+        }
+};
+
+#endif
@@ -12,7 +12,7 @@ using namespace std;
 
 static bool isdelim(char ch) {
     int                     i;
-    static const char *     pszDelimiters = " \t\n\r+-*/^:%&|~<>()[]{}";
+    static const char *     pszDelimiters = " \t\n\r+-*/^:%&|~<>()[]{},";
 
     for (i = 0;i < (int)strlen(pszDelimiters);i++) {
         if (ch == pszDelimiters[i]) {
@@ -81,7 +81,7 @@ static int _findNextTokenPos(tokenizer_t * t) {
                                         prevChar == ']' || 
                                         prevChar == '}');
 
-                        bool isPreviousCharDigit = isdigit(prevChar);
+                        bool isPreviousCharDigit = (isalnum(prevChar) || prevChar == '.');
 
                         if (!isPreviousCharBrace && !isPreviousCharDigit) {
                             isNegativeOperand = true;
@@ -152,12 +152,12 @@ bool tzrHasMoreTokens(tokenizer_t * t) {
     return false;
 }
 
-string & tzrNextToken(tokenizer_t * t) {
+string tzrNextToken(tokenizer_t * t) {
     int                 tokenLength;
     int                 i;
     int                 j = 0;
     char *              pszToken;
-    static string       token;
+    string              token;
 
     tokenLength = (t->endIndex - t->startIndex);
 
@@ -20,6 +20,6 @@ tokenizer_t;
 void            tzrInit(tokenizer_t * t, const char * pszExpression, int base);
 void            tzrFinish(tokenizer_t * t);
 bool            tzrHasMoreTokens(tokenizer_t * t);
-string &        tzrNextToken(tokenizer_t * t);
+string          tzrNextToken(tokenizer_t * t);
 
 #endif
@@ -1,4 +1,5 @@
 #include <string>
+#include <vector>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -62,6 +63,10 @@ class Utils {
             return false;
         }
 
+        static bool isSeparator(char token) {
+            return (token == ',');
+        }
+
         static bool isDigit(char token) {
             if (strchr(pszDigits, (int)token) != NULL) {
                 return true;
@@ -100,12 +105,62 @@ class Utils {
             return true;
         }
 
+        /*
+        ** A token is a number in the base if every character is one of
+        ** its digits, letters are case sensitive above base 36...
+        */
+        static bool isDigits(string token, int radix) {
+            static const char * pszBaseDigits = 
+                    "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+            uint32_t start = (token[0] == '-' ? 1 : 0);
+
+            if (start == (uint32_t)token.length()) {
+                return false;
+            }
+
+            for (uint32_t i = start;i < (uint32_t)token.length();i++) {
+                char ch = (radix <= 36 ? (char)toupper(token[i]) : token[i]);
+
+                if (ch == '.') {
+                    continue;
+                }
+
+                const char * p = strchr(pszBaseDigits, (int)ch);
+
+                if (p == NULL || (int)(p - pszBaseDigits) >= radix) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /*
+        ** Function and constant names win over numbers, except a single
+        ** letter that is a digit of the base, e.g. c is 12 in hex but the
+        ** speed of light in decimal...
+        */
+        static bool isOperand(string token, int radix) {
+            if (isFunction(token) || isConstant(token)) {
+                return (token.length() == 1 && isDigits(token, radix));
+            }
+            else if (radix <= 16) {
+                return isOperand(token);
+            }
+
+            return isDigits(token, radix);
+        }
+
         static bool isConstant(string token) {
             Utils::lowercase(token);
 
             if (token.compare("pi") == 0) {
                 return true;
             }
+            else if (token.compare("e") == 0) {
+                return true;
+            }
             else if (token.compare("eu") == 0) {
                 return true;
             }
@@ -179,10 +234,162 @@ class Utils {
             else if (token.compare("mem") == 0) {
                 return true;
             }
+            else if (token.compare("gamma") == 0) {
+                return true;
+            }
+            else if (token.compare("lngamma") == 0) {
+                return true;
+            }
+            else if (token.compare("binom") == 0) {
+                return true;
+            }
+            else if (token.compare("popcount") == 0) {
+                return true;
+            }
+            else if (token.compare("clz") == 0) {
+                return true;
+            }
+            else if (token.compare("ctz") == 0) {
+                return true;
+            }
+            else if (token.compare("rol") == 0) {
+                return true;
+            }
+            else if (token.compare("ror") == 0) {
+                return true;
+            }
+            else if (token.compare("bswap") == 0) {
+                return true;
+            }
 
             return false;
         }
 
+        /*
+        ** A name for a value supplied when the calculation is run, it
+        ** must not clash with a constant, a function or a valid number...
+        */
+        static bool isVariable(string token) {
+            if (token.empty() || !(isalpha(token[0]) || token[0] == '_')) {
+                return false;
+            }
+
+            for (uint32_t i = 1;i < (uint32_t)token.length();i++) {
+                if (!(isalnum(token[i]) || token[i] == '_')) {
+                    return false;
+                }
+            }
+
+            if (Utils::isConstant(token) || Utils::isFunction(token)) {
+                return false;
+            }
+
+            return true;
+        }
+
+        static string & trim(string & s) {
+            size_t first = 0;
+            size_t last = s.length();
+
+            while (first < last && isspace(s[first])) {
+                first++;
+            }
+
+            while (last > first && isspace(s[last - 1])) {
+                last--;
+            }
+
+            s = s.substr(first, last - first);
+
+            return s;
+        }
+
+        /*
+        ** Whether the line is the named command, on its own or followed by
+        ** a number or a space and its arguments, so 'bin' and 'base 36'
+        ** are commands but 'binom(5, 2)' and 'basis * 2' are not...
+        */
+        static bool isCommand(const char * pszCommand, const char * pszName) {
+            size_t          nameLength = strlen(pszName);
+            char            next;
+
+            if (strncmp(pszCommand, pszName, nameLength) != 0) {
+                return false;
+            }
+
+            next = pszCommand[nameLength];
+
+            return (next == 0 || isspace(next) || isdigit(next));
+        }
+
+        /*
+        ** Split a command written as a call, e.g. integrate(x ^ 2, x, 0, 1),
+        ** into its arguments, commas inside brackets are part of an
+        ** argument. False if it is not a call to the named command...
+        */
+        static bool splitCall(const char * pszCommand, const char * pszName, vector<string> & args) {
+            const char *    pszEnd;
+
+            if (!splitCall(pszCommand, pszName, args, &pszEnd)) {
+                return false;
+            }
+
+            for (;isspace(*pszEnd);pszEnd++);
+
+            return (*pszEnd == 0);
+        }
+
+        /*
+        ** The same for a call at the start of a calculation that need not
+        ** be all of it, the end is set to just after the closing bracket...
+        */
+        static bool splitCall(const char * pszCommand, const char * pszName, vector<string> & args, const char ** ppszEnd) {
+            const char *    p = pszCommand;
+            size_t          nameLength = strlen(pszName);
+            int             depth = 0;
+            string          arg;
+
+            args.clear();
+
+            if (strncmp(p, pszName, nameLength) != 0) {
+                return false;
+            }
+
+            for (p += nameLength;isspace(*p);p++);
+
+            if (*p++ != '(') {
+                return false;
+            }
+
+            for (;*p;p++) {
+                if (isLeftBrace(*p)) {
+                    depth++;
+                }
+                else if (isRightBrace(*p)) {
+                    if (depth-- == 0) {
+                        break;
+                    }
+                }
+                else if (*p == ',' && depth == 0) {
+                    args.push_back(trim(arg));
+                    arg.clear();
+                    continue;
+                }
+
+                arg.append(1, *p);
+            }
+
+            if (*p != ')') {
+                return false;
+            }
+
+            args.push_back(trim(arg));
+
+            *ppszEnd = p + 1;
+
+            return true;
+        }
+
         static char * getBase2String(uint32_t value) {
             char        szBinaryString[BASE2_OUTPUT_LEN + 1];
             char        szOutputString[BASE2_OUTPUT_LEN + 1];
@@ -0,0 +1,249 @@
+#include <string>
+
+#include <gmp.h>
+#include <mpfr.h>
+
+#include "logger.h"
+#include "calc_error.h"
+#include "system.h"
+
+using namespace std;
+
+#ifndef __INCL_WORD
+#define __INCL_WORD
+
+/*
+** Fixed width integer arithmetic on native words, for when a word size
+** has been chosen in the integer modes. Everything wraps around at the
+** word size as it would in C, and nothing here touches GMP or MPFR...
+*/
+class Word {
+    private:
+        static int _bits() {
+            return (getWordSize() > 0 ? getWordSize() : MAX_WORD_SIZE);
+        }
+
+        static word_t _mask() {
+            return (_bits() >= MAX_WORD_SIZE ? ~(word_t)0 : (((word_t)1 << _bits()) - 1));
+        }
+
+        static bool _isNegative(word_t w) {
+            return (getWordSigned() && (sword_t)w < 0);
+        }
+
+        /*
+        ** A shift count, negative counts shift the other way...
+        */
+        static sword_t _count(word_t w) {
+            return (_isNegative(w) ? (sword_t)w : (sword_t)(w & _mask()));
+        }
+
+        static word_t _shiftLeft(word_t w, sword_t n) {
+            if (n < 0) {
+                return _shiftRight(w, -n);
+            }
+
+            return (n >= _bits() ? 0 : w << (int)n);
+        }
+
+        static word_t _shiftRight(word_t w, sword_t n) {
+            if (n < 0) {
+                return _shiftLeft(w, -n);
+            }
+
+            if (getWordSigned()) {
+                return (word_t)((sword_t)w >> (int)(n >= MAX_WORD_SIZE ? MAX_WORD_SIZE - 1 : n));
+            }
+
+            return (n >= MAX_WORD_SIZE ? 0 : (w & _mask()) >> (int)n);
+        }
+
+        static word_t _rotate(word_t w, sword_t n) {
+            int bits = _bits();
+
+            w &= _mask();
+            n %= bits;
+
+            if (n < 0) {
+                n += bits;
+            }
+
+            if (n == 0) {
+                return w;
+            }
+
+            return (w << (int)n) | (w >> (bits - (int)n));
+        }
+
+        static int _popcount(word_t w) {
+            w &= _mask();
+
+            return __builtin_popcountll((uint64_t)w) + __builtin_popcountll((uint64_t)(w >> 64));
+        }
+
+        static int _ctz(word_t w) {
+            w &= _mask();
+
+            if (w == 0) {
+                return _bits();
+            }
+
+            return ((uint64_t)w != 0 ? __builtin_ctzll((uint64_t)w) : 64 + __builtin_ctzll((uint64_t)(w >> 64)));
+        }
+
+        static int _clz(word_t w) {
+            w &= _mask();
+
+            if (w == 0) {
+                return _bits();
+            }
+
+            int lz = ((uint64_t)(w >> 64) != 0 ? __builtin_clzll((uint64_t)(w >> 64)) : 64 + __builtin_clzll((uint64_t)w));
+
+            return lz - (MAX_WORD_SIZE - _bits());
+        }
+
+        /*
+        ** Reverse the whole bytes of the word...
+        */
+        static word_t _byteSwap(word_t w) {
+            int     numBytes = _bits() / 8;
+            word_t  r = 0;
+
+            if (_bits() % 8) {
+                throw calc_error("bswap needs a word size that is a whole number of bytes");
+            }
+
+            for (int i = 0;i < numBytes;i++) {
+                r = (r << 8) | ((w >> (i * 8)) & 0xFF);
+            }
+
+            return r;
+        }
+
+    public:
+        static bool isFunction(const string & f) {
+            return (
+                f.compare("popcount") == 0 || 
+                f.compare("clz") == 0 || 
+                f.compare("ctz") == 0 || 
+                f.compare("rol") == 0 || 
+                f.compare("ror") == 0 || 
+                f.compare("bswap") == 0);
+        }
+
+        static int getArity(const string & f) {
+            return ((f.compare("rol") == 0 || f.compare("ror") == 0) ? 2 : 1);
+        }
+
+        /*
+        ** All the operators except roots...
+        */
+        static value_t evaluate(const string & op, const value_t & operand1, const value_t & operand2) {
+            word_t      a = toWord(operand1)->w;
+            word_t      b = toWord(operand2)->w;
+            word_t      r = 0;
+
+            switch (op[0]) {
+                case '+':
+                    r = a + b;
+                    break;
+
+                case '-':
+                    r = a - b;
+                    break;
+
+                case '*':
+                    r = a * b;
+                    break;
+
+                case '/':
+                case '%':
+                    if ((b & _mask()) == 0) {
+                        throw calc_error("Integer division by zero");
+                    }
+
+                    if (getWordSigned()) {
+                        /*
+                        ** The most negative number divided by -1 wraps...
+                        */
+                        if ((sword_t)b == -1) {
+                            r = (op[0] == '/' ? -a : 0);
+                        }
+                        else {
+                            r = (word_t)(op[0] == '/' ? (sword_t)a / (sword_t)b : (sword_t)a % (sword_t)b);
+                        }
+                    }
+                    else {
+                        r = (op[0] == '/' ? a / b : a % b);
+                    }
+                    break;
+
+                case '^':
+                    if (_isNegative(b)) {
+                        throw calc_error("Negative powers are not whole numbers");
+                    }
+
+                    r = 1;
+
+                    for (word_t e = b & _mask();e > 0;e >>= 1) {
+                        if (e & 1) {
+                            r *= a;
+                        }
+
+                        a *= a;
+                    }
+                    break;
+
+                case '&':
+                    r = a & b;
+                    break;
+
+                case '|':
+                    r = a | b;
+                    break;
+
+                case '~':
+                    r = a ^ b;
+                    break;
+
+                case '<':
+                    r = _shiftLeft(a, _count(b));
+                    break;
+
+                case '>':
+                    r = _shiftRight(a, _count(b));
+                    break;
+            }
+
+            return newWord(r);
+        }
+
+        static value_t evaluateFunction(const string & f, const value_t & operand1, const value_t & operand2) {
+            word_t      a = toWord(operand1)->w;
+            word_t      r = 0;
+
+            if (f.compare("popcount") == 0) {
+                r = (word_t)_popcount(a);
+            }
+            else if (f.compare("clz") == 0) {
+                r = (word_t)_clz(a);
+            }
+            else if (f.compare("ctz") == 0) {
+                r = (word_t)_ctz(a);
+            }
+            else if (f.compare("bswap") == 0) {
+                r = _byteSwap(a);
+            }
+            else if (f.compare("rol") == 0) {
+                r = _rotate(a, _count(toWord(operand2)->w));
+            }
+            else if (f.compare("ror") == 0) {
+                r = _rotate(a, -_count(toWord(operand2)->w));
+            }
+
+            return newWord(r);
+        }
+};
+
+#endif